@@ -7,93 +7,177 @@ CMD_SRCS += \
 ../tm4c123gh6pm.cmd 
 
 C_SRCS += \
+../adaptive.c \
+../bench.c \
 ../clock.c \
 ../commands.c \
+../config.c \
+../dispatch.c \
 ../eeprom.c \
+../format.c \
 ../gpio.c \
+../grid.c \
+../health.c \
 ../i2c0.c \
 ../i2c0_lcd.c \
+../journal.c \
 ../main.c \
+../minimap.c \
 ../nvic.c \
+../profile.c \
 ../strings.c \
+../surface.c \
 ../timer.c \
 ../tm4c123gh6pm_startup_ccs.c \
+../tone.c \
 ../uart0.c \
-../wait.c 
+../wait.c \
+../walk.c \
+../window.c 
 
 C_DEPS += \
+./adaptive.d \
+./bench.d \
 ./clock.d \
 ./commands.d \
+./config.d \
+./dispatch.d \
 ./eeprom.d \
+./format.d \
 ./gpio.d \
+./grid.d \
+./health.d \
 ./i2c0.d \
 ./i2c0_lcd.d \
+./journal.d \
 ./main.d \
+./minimap.d \
 ./nvic.d \
+./profile.d \
 ./strings.d \
+./surface.d \
 ./timer.d \
 ./tm4c123gh6pm_startup_ccs.d \
+./tone.d \
 ./uart0.d \
-./wait.d 
+./wait.d \
+./walk.d \
+./window.d 
 
 OBJS += \
+./adaptive.obj \
+./bench.obj \
 ./clock.obj \
 ./commands.obj \
+./config.obj \
+./dispatch.obj \
 ./eeprom.obj \
+./format.obj \
 ./gpio.obj \
+./grid.obj \
+./health.obj \
 ./i2c0.obj \
 ./i2c0_lcd.obj \
+./journal.obj \
 ./main.obj \
+./minimap.obj \
 ./nvic.obj \
+./profile.obj \
 ./strings.obj \
+./surface.obj \
 ./timer.obj \
 ./tm4c123gh6pm_startup_ccs.obj \
+./tone.obj \
 ./uart0.obj \
-./wait.obj 
+./wait.obj \
+./walk.obj \
+./window.obj 
 
 OBJS__QUOTED += \
+"adaptive.obj" \
+"bench.obj" \
 "clock.obj" \
 "commands.obj" \
+"config.obj" \
+"dispatch.obj" \
 "eeprom.obj" \
+"format.obj" \
 "gpio.obj" \
+"grid.obj" \
+"health.obj" \
 "i2c0.obj" \
 "i2c0_lcd.obj" \
+"journal.obj" \
 "main.obj" \
+"minimap.obj" \
 "nvic.obj" \
+"profile.obj" \
 "strings.obj" \
+"surface.obj" \
 "timer.obj" \
 "tm4c123gh6pm_startup_ccs.obj" \
+"tone.obj" \
 "uart0.obj" \
-"wait.obj" 
+"wait.obj" \
+"walk.obj" \
+"window.obj" 
 
 C_DEPS__QUOTED += \
+"adaptive.d" \
+"bench.d" \
 "clock.d" \
 "commands.d" \
+"config.d" \
+"dispatch.d" \
 "eeprom.d" \
+"format.d" \
 "gpio.d" \
+"grid.d" \
+"health.d" \
 "i2c0.d" \
 "i2c0_lcd.d" \
+"journal.d" \
 "main.d" \
+"minimap.d" \
 "nvic.d" \
+"profile.d" \
 "strings.d" \
+"surface.d" \
 "timer.d" \
 "tm4c123gh6pm_startup_ccs.d" \
+"tone.d" \
 "uart0.d" \
-"wait.d" 
+"wait.d" \
+"walk.d" \
+"window.d" 
 
 C_SRCS__QUOTED += \
+"../adaptive.c" \
+"../bench.c" \
 "../clock.c" \
 "../commands.c" \
+"../config.c" \
+"../dispatch.c" \
 "../eeprom.c" \
+"../format.c" \
 "../gpio.c" \
+"../grid.c" \
+"../health.c" \
 "../i2c0.c" \
 "../i2c0_lcd.c" \
+"../journal.c" \
 "../main.c" \
+"../minimap.c" \
 "../nvic.c" \
+"../profile.c" \
 "../strings.c" \
+"../surface.c" \
 "../timer.c" \
 "../tm4c123gh6pm_startup_ccs.c" \
+"../tone.c" \
 "../uart0.c" \
-"../wait.c" 
+"../wait.c" \
+"../walk.c" \
+"../window.c" 
 
 
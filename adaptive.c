@@ -0,0 +1,117 @@
+/**
+*      @file adaptive.c
+*      @author Prithvi Bhat
+*      @brief Averaging depth that follows the measured pen speed and capture noise
+*               * Each complete stroke updates, per sensor, a running estimate of how far the capture moves
+*                 per stroke (speed) and how much it scatters around that movement (noise)
+*               * Noise asks for a deeper average, N captures cut it by sqrt(N), until about
+*                 ADAPTIVE_NOISE_TICKS is left: quiet captures need few strokes, noisy ones many
+*               * Speed asks for a shallower one, the average of N strokes trails a moving pen by
+*                 (N - 1) / 2 strokes, which is held within ADAPTIVE_LAG_TICKS. Speed within the noise
+*                 of its own estimate is not counted, so a noisy resting pen still gets a deep average
+*               * The smaller of the two wins within the configured bounds. The depth drops at once when
+*                 the pen starts moving and grows back one stroke at a time, so a resting pen settles
+*                 into the precise average without the fix jumping
+*               * Integer arithmetic only, the same captures always give the same depths
+**/
+
+#include "adaptive.h"
+
+#define ESTIMATE_FRACTION   4                   // Estimates in 1/16 tick
+#define ESTIMATE_SMOOTHING  8                   // Strokes the estimates average over, about
+#define SPREAD_LIMIT        0xFFFF              // Keeps the squared noise within 32 bits
+#define NOISE_SQUARED       ((ADAPTIVE_NOISE_TICKS << ESTIMATE_FRACTION) * (ADAPTIVE_NOISE_TICKS << ESTIMATE_FRACTION))
+
+/**
+*      @brief Running estimates of one sensor
+**/
+typedef struct
+{
+    uint32_t last;                              // Previous capture
+    int32_t speed;                              // Capture change per stroke, 1/16 tick
+    int32_t spread;                             // Mean deviation of the change from the speed, 1/16 tick
+} adaptive_channel_t;
+
+// Global Variables
+static adaptive_channel_t g_channel[ADAPTIVE_CHANNELS];
+static uint8_t g_min_depth = 1, g_max_depth = 1, g_depth = 1;
+static bool g_enabled = false, g_primed = false;
+
+/**
+*      @brief Function to set the depth bounds and restart the estimates
+*      @param min_depth shallowest average, at least 1
+*      @param max_depth deepest average, adaptive averaging is off unless it exceeds min_depth
+**/
+void adaptive_configure(uint8_t min_depth, uint8_t max_depth)
+{
+    g_min_depth = (min_depth == 0) ? 1 : min_depth;
+    g_max_depth = max_depth;
+    g_enabled = (g_max_depth > g_min_depth);
+    g_depth = g_min_depth;
+    g_primed = false;
+}
+
+/**
+*      @brief Function to report whether the depth is adapted
+**/
+bool adaptive_enabled(void)
+{
+    return g_enabled;
+}
+
+/**
+*      @brief Function to feed the captures of a complete stroke and get the depth to average over
+*      @param capture ADAPTIVE_CHANNELS timer captures, sensor A first
+*      @return uint8_t averaging depth within the configured bounds
+**/
+uint8_t adaptive_update(const uint32_t *capture)
+{
+    uint32_t fastest = 0, noisiest = 0, by_noise, by_speed, target;
+    uint8_t i;
+
+    for (i = 0; i < ADAPTIVE_CHANNELS; i++)
+    {
+        adaptive_channel_t *channel = &g_channel[i];
+        int32_t change = (int32_t)(capture[i] - channel->last) << ESTIMATE_FRACTION;
+        int32_t deviation;
+        uint32_t speed;
+
+        channel->last = capture[i];
+        if (!g_primed)                                                          // Nothing to compare with yet
+        {
+            channel->speed = 0;
+            channel->spread = 0;
+            continue;
+        }
+
+        channel->speed += (change - channel->speed) / ESTIMATE_SMOOTHING;
+        deviation = (change > channel->speed) ? change - channel->speed : channel->speed - change;
+        channel->spread += (deviation - channel->spread) / ESTIMATE_SMOOTHING;
+        if (channel->spread > SPREAD_LIMIT)     channel->spread = SPREAD_LIMIT;
+
+        speed = (channel->speed < 0) ? -channel->speed : channel->speed;
+        speed = (speed > (uint32_t)channel->spread / 2) ? speed - channel->spread / 2 : 0;     // Noise is not movement
+        if (speed > fastest)                            fastest = speed;
+        if ((uint32_t)channel->spread > noisiest)       noisiest = channel->spread;
+    }
+
+    if (!g_primed || !g_enabled)
+    {
+        g_primed = true;
+        return g_depth;
+    }
+
+    // The mean deviation is about 4/5 of the standard deviation, and a change between two strokes
+    // scatters sqrt(2) times as much as one capture: capture variance = spread^2 * 25 / 32
+    by_noise = 1 + ((noisiest * noisiest) / NOISE_SQUARED) * 25 / 32;
+    by_speed = (fastest == 0) ? g_max_depth : 1 + ((2 * ADAPTIVE_LAG_TICKS) << ESTIMATE_FRACTION) / fastest;
+
+    target = (by_noise < by_speed) ? by_noise : by_speed;
+    if (target < g_min_depth)   target = g_min_depth;
+    if (target > g_max_depth)   target = g_max_depth;
+
+    if (target < g_depth)           g_depth = target;                           // Follow a moving pen at once
+    else if (target > g_depth)      g_depth++;                                  // Settle gradually
+
+    return g_depth;
+}
@@ -0,0 +1,21 @@
+/**
+*      @file adaptive.h
+*      @author Prithvi Bhat
+*      @brief Averaging depth that follows the measured pen speed and capture noise
+**/
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define ADAPTIVE_CHANNELS       3               // Ultrasound sensors A, B and C
+#define ADAPTIVE_NOISE_TICKS    6               // Capture noise left after averaging, about 0.05 mm
+#define ADAPTIVE_LAG_TICKS      58              // Lag of the average behind a moving pen, about 0.5 mm
+
+// Function prototypes
+void adaptive_configure(uint8_t min_depth, uint8_t max_depth);
+bool adaptive_enabled(void);
+uint8_t adaptive_update(const uint32_t *capture);
+
+#endif
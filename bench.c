@@ -0,0 +1,393 @@
+/**
+*      @file bench.c
+*      @author Prithvi Bhat
+*      @brief Microbenchmark harness for the firmware hot kernels
+*               * format_* cases run next to their snprintf equivalents for comparison
+*               * solve_position runs next to solve_position_divide, the same fix with the geometry read from
+*                 the configuration and divided out on every call
+*               * config_boot runs next to config_boot_words, the same load with the block reads done word
+*                 by word as before they were streamed. Both reload the running configuration, which is
+*                 saved before the cases and put back after them. boot_to_armed_words is an estimate of the
+*                 boot before, derived from the measured boot_to_armed with the difference between the two
+*                 swapped in
+*               * Each case is warmed up, then timed over BENCH_REPETITIONS repetitions
+*               * Median and median absolute deviation (MAD) per iteration are reported as CSV:
+*                   kernel,iterations,repetitions,median_ticks,mad_ticks,bytes_per_tick
+*               * On the target a tick is one DWT cycle at 40 MHz and results are printed over UART
+*               * On the host (BENCH_HOST) the timer and output are provided by host/bench_host.c
+*               * Only built into the firmware with --define=BENCH
+**/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+#include "commands.h"
+#include "strings.h"
+#include "eeprom.h"
+#include "eeprom_memory_map.h"
+#include "format.h"
+#include "config.h"
+#include "profile.h"
+
+#if defined(BENCH) || defined(BENCH_HOST)
+
+#ifndef BENCH_HOST
+#include "tm4c123gh6pm.h"
+#include "uart0.h"
+
+#define DWT_CTRL_R              (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT_R            (*((volatile uint32_t *)0xE0001004))
+#define DWT_CTRL_CYCCNTENA      0x00000001
+#define DEMCR_TRCENA            0x01000000
+#endif
+
+#define CONVERSION_CONSTANT     0.008575    // mm per timer tick, matches commands.c
+#define BENCH_NOISE_TICKS       24          // Peak to peak noise added to synthetic strokes
+#define BENCH_COMMAND           "sensor A 120 80"
+#define BENCH_SCRIPT_LINE       "fix -12 7, average 10.5 beep 0x2 -3 +4 coord"
+#define BENCH_EEPROM_WORDS      (JOURNAL_WORDS + PROFILE_COUNT * EEPROM_BLOCK_WORDS)    // Journal and profiles
+
+extern bool g_eeprom_stream;
+extern uint32_t g_distance_A, g_distance_B, g_distance_C;
+
+// Global Variables
+static capture_window_t g_bench_window_A, g_bench_window_B, g_bench_window_C;
+static string_data_t g_bench_command;
+static char g_bench_string[32];
+static string_data_t g_bench_script;
+static uint32_t g_bench_samples[BENCH_REPETITIONS];
+static volatile int32_t g_bench_sink;       // Keeps results alive so kernels are not optimised away
+static uint32_t g_bench_eeprom[BENCH_EEPROM_WORDS];
+static uint32_t g_bench_boot_ticks = 0;     // Reset to the main loop, recorded by bench_boot_armed()
+static config_state_t g_bench_config;       // Running configuration, put back after the boot cases reload it
+
+#ifndef BENCH_HOST
+/**
+*      @brief Function to enable the DWT cycle counter
+**/
+void bench_init(void)
+{
+    NVIC_DBG_INT_R |= DEMCR_TRCENA;             // Enable trace so DWT is clocked
+    DWT_CYCCNT_R = 0;
+    DWT_CTRL_R |= DWT_CTRL_CYCCNTENA;           // Start cycle counter
+}
+
+/**
+*      @brief Function to read the DWT cycle counter
+**/
+uint32_t bench_ticks(void)
+{
+    return DWT_CYCCNT_R;
+}
+
+/**
+*      @brief Function to print benchmark output over UART
+**/
+void bench_puts(const char *string)
+{
+    putsUart0((char *)string);
+}
+#endif
+
+/**
+*      @brief Function to slide MAX_FIFO_SIZE strokes of a pen at x, y plus deterministic noise through the windows
+*               Sensor geometry follows calculate_coordinates: A at (AX, AY), B at (BX, BY), C at (CX, CY)
+**/
+static void bench_fill_strokes(double x, double y)
+{
+    uint32_t seed = 12345;
+    uint8_t i;
+
+    window_reset(&g_bench_window_A, config_get(TC_AVG));
+    window_reset(&g_bench_window_B, config_get(TC_AVG));
+    window_reset(&g_bench_window_C, config_get(TC_AVG));
+
+    double ax = x - (int32_t)config_get(CRD_AX), ay = y - (int32_t)config_get(CRD_AY);
+    double bx = x - (int32_t)config_get(CRD_BX), by = y - (int32_t)config_get(CRD_BY);
+    double cx = x - (int32_t)config_get(CRD_CX), cy = y - (int32_t)config_get(CRD_CY);
+
+    for (i = 0; i < MAX_FIFO_SIZE; i++)
+    {
+        seed = seed * 1664525 + 1013904223;                                     // Numerical Recipes LCG
+        int32_t noise = (int32_t)(seed >> 16) % BENCH_NOISE_TICKS - BENCH_NOISE_TICKS / 2;
+
+        window_push(&g_bench_window_A, (uint32_t)(sqrt(ax * ax + ay * ay) / CONVERSION_CONSTANT) + noise);
+        window_push(&g_bench_window_B, (uint32_t)(sqrt(bx * bx + by * by) / CONVERSION_CONSTANT) - noise);
+        window_push(&g_bench_window_C, (uint32_t)(sqrt(cx * cx + cy * cy) / CONVERSION_CONSTANT) + noise / 2);
+    }
+}
+
+// Kernels, one iteration each
+static void bench_calculate_distance(void)
+{
+    calculate_distance(&g_bench_window_A, &g_bench_window_B, &g_bench_window_C, true);
+}
+
+static void bench_calculate_variance(void)
+{
+    calculate_variance(&g_bench_window_A, &g_bench_window_B, &g_bench_window_C);
+}
+
+static void bench_window_push(void)
+{
+    window_push(&g_bench_window_A, window_sample(&g_bench_window_A, WINDOW_SIZE - 1));    // Recirculate the oldest capture
+    g_bench_sink = g_bench_window_A.sum;
+}
+
+static void bench_calculate_coordinates(void)
+{
+    calculate_coordinates(&g_bench_window_A, &g_bench_window_B, &g_bench_window_C);
+}
+
+static void bench_solve_position(void)
+{
+    float x, y;
+
+    solve_position(g_distance_A, g_distance_B, g_distance_C, &x, &y);
+    g_bench_sink = (int32_t)(x + y);
+}
+
+static void bench_solve_position_divide(void)
+{
+    int32_t D1 = (int32_t)(config_get(CRD_BY) - config_get(CRD_AY));
+    int32_t D2 = (int32_t)(config_get(CRD_CX) - config_get(CRD_BX));
+    double a = g_distance_A, b = g_distance_B, c = g_distance_C;
+
+    double y = ((double)D1 * D1 + b * b - a * a) / (2 * D1) - (int32_t)config_get(FIX_Y);
+    double x = ((double)D2 * D2 + b * b - c * c) / (2 * D2) - (int32_t)config_get(FIX_X);
+    g_bench_sink = (int32_t)(x + y);
+}
+
+static void bench_format_int(void)
+{
+    format_buffer_begin(g_bench_string, sizeof(g_bench_string));
+    format_int(format_buffer_put, -987654);
+    g_bench_sink = g_bench_string[1];
+}
+
+static void bench_snprintf_int(void)
+{
+    snprintf(g_bench_string, sizeof(g_bench_string), "%ld", -987654L);
+    g_bench_sink = g_bench_string[1];
+}
+
+static void bench_format_fixed(void)
+{
+    format_buffer_begin(g_bench_string, sizeof(g_bench_string));
+    format_fixed(format_buffer_put, 1234568, 3);
+    g_bench_sink = g_bench_string[0];
+}
+
+static void bench_snprintf_float(void)
+{
+    snprintf(g_bench_string, sizeof(g_bench_string), "%.3f", 1234.5678f);
+    g_bench_sink = g_bench_string[0];
+}
+
+static void bench_itoa(void)
+{
+    g_bench_sink = itoa(g_bench_string, -987654)[1];
+}
+
+static void bench_string_parse(void)
+{
+    memcpy(g_bench_script.input_string, BENCH_SCRIPT_LINE, sizeof(BENCH_SCRIPT_LINE));  // Parsing overwrites delimiters
+    string_parse(&g_bench_script);
+    g_bench_sink = g_bench_script.count;
+}
+
+static void bench_getFieldInteger(void)
+{
+    g_bench_sink = getFieldInteger(&g_bench_command, 2);
+}
+
+static void bench_isCommand(void)
+{
+    g_bench_sink = isCommand(&g_bench_command, "sensor", 4);
+}
+
+static void bench_eeprom_read_words(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < BENCH_EEPROM_WORDS; i++)    g_bench_eeprom[i] = readEeprom(JOURNAL_BASE + i);
+    g_bench_sink = g_bench_eeprom[0];
+}
+
+static void bench_eeprom_read_block(void)
+{
+    readEepromBlock(JOURNAL_BASE, g_bench_eeprom, BENCH_EEPROM_WORDS);
+    g_bench_sink = g_bench_eeprom[0];
+}
+
+static void bench_config_boot(void)
+{
+    config_init();
+    profile_init();
+    g_bench_sink = config_get(TC_AVG);
+}
+
+static void bench_config_boot_words(void)
+{
+    g_eeprom_stream = false;                                                    // Baseline, one word per access
+    bench_config_boot();
+    g_eeprom_stream = true;
+}
+
+static const bench_case_t g_bench_cases[] =
+{
+    { "calculate_distance",     bench_calculate_distance,       4,  0                               },
+    { "calculate_variance",     bench_calculate_variance,       4,  0                               },
+    { "calculate_coordinates",  bench_calculate_coordinates,    1,  0                               },
+    { "solve_position",         bench_solve_position,           16, 0                               },
+    { "solve_position_divide",  bench_solve_position_divide,    16, 0                               },
+    { "window_push",            bench_window_push,              16, 0                               },
+    { "format_int",             bench_format_int,               16, 0                               },
+    { "snprintf_int",           bench_snprintf_int,             16, 0                               },
+    { "format_fixed",           bench_format_fixed,             16, 0                               },
+    { "snprintf_float",         bench_snprintf_float,           16, 0                               },
+    { "itoa",                   bench_itoa,                     16, 0                               },
+    { "string_parse",           bench_string_parse,             16, sizeof(BENCH_SCRIPT_LINE) - 1   },
+    { "getFieldInteger",        bench_getFieldInteger,          16, 0                               },
+    { "isCommand",              bench_isCommand,                16, 0                               },
+    { "eeprom_read_words",      bench_eeprom_read_words,        4,  BENCH_EEPROM_WORDS * 4          },
+    { "eeprom_read_block",      bench_eeprom_read_block,        4,  BENCH_EEPROM_WORDS * 4          },
+    { "config_boot",            bench_config_boot,              1,  0                               },
+    { "config_boot_words",      bench_config_boot_words,        1,  0                               },
+};
+
+/**
+*      @brief Function to sort samples in place (insertion sort, BENCH_REPETITIONS is small)
+**/
+static void bench_sort(uint32_t *samples, uint8_t size)
+{
+    uint8_t i, j;
+
+    for (i = 1; i < size; i++)
+    {
+        uint32_t value = samples[i];
+        for (j = i; j > 0 && samples[j - 1] > value; j--)   samples[j] = samples[j - 1];
+        samples[j] = value;
+    }
+}
+
+/**
+*      @brief Function to run one case and print its CSV row
+*               Ticks are reported per iteration with two decimals, throughput with three
+*      @param bench_case case to run
+*      @return uint32_t median ticks per iteration in hundredths
+**/
+uint32_t bench_run(const bench_case_t *bench_case)
+{
+    uint32_t iterations = bench_case->iterations * BENCH_SCALE;
+    uint32_t i, r, start, median, mad, throughput = 0;
+    char string[112];
+
+    for (r = 0; r < BENCH_WARMUP; r++)
+    {
+        for (i = 0; i < iterations; i++)    bench_case->kernel();
+    }
+
+    for (r = 0; r < BENCH_REPETITIONS; r++)
+    {
+        start = bench_ticks();
+        for (i = 0; i < iterations; i++)    bench_case->kernel();
+        g_bench_samples[r] = bench_ticks() - start;
+    }
+
+    bench_sort(g_bench_samples, BENCH_REPETITIONS);
+    median = g_bench_samples[BENCH_REPETITIONS / 2];
+
+    for (r = 0; r < BENCH_REPETITIONS; r++)                                     // Absolute deviations from the median
+    {
+        g_bench_samples[r] = (g_bench_samples[r] > median) ? g_bench_samples[r] - median : median - g_bench_samples[r];
+    }
+    bench_sort(g_bench_samples, BENCH_REPETITIONS);
+    mad = g_bench_samples[BENCH_REPETITIONS / 2];
+
+    if (bench_case->bytes && median)                                            // Bytes per tick, in thousandths
+    {
+        throughput = (uint32_t)(((uint64_t)bench_case->bytes * iterations * 1000) / median);
+    }
+
+    median = (uint32_t)(((uint64_t)median * 100) / iterations);
+    mad = (uint32_t)(((uint64_t)mad * 100) / iterations);
+
+    format_buffer_begin(string, sizeof(string));
+    format_string(format_buffer_put, bench_case->name);
+    format_buffer_put(',');
+    format_uint(format_buffer_put, iterations);
+    format_buffer_put(',');
+    format_uint(format_buffer_put, BENCH_REPETITIONS);
+    format_buffer_put(',');
+    format_fixed(format_buffer_put, (int32_t)median, 2);
+    format_buffer_put(',');
+    format_fixed(format_buffer_put, (int32_t)mad, 2);
+    format_buffer_put(',');
+    if (bench_case->bytes)  format_fixed(format_buffer_put, (int32_t)throughput, 3);
+    format_string(format_buffer_put, "\r\n");
+
+    bench_puts(string);
+    return median;
+}
+
+/**
+*      @brief Function to print a single boot measurement, no spread
+*      @param name first CSV column
+*      @param ticks cycles
+**/
+static void bench_boot_row(const char *name, uint32_t ticks)
+{
+    char string[48];
+
+    format_buffer_begin(string, sizeof(string));
+    format_string(format_buffer_put, name);
+    format_string(format_buffer_put, ",1,1,");
+    format_uint(format_buffer_put, ticks);
+    format_string(format_buffer_put, ".00,0.00,\r\n");
+    bench_puts(string);
+}
+
+/**
+*      @brief Function to prepare inputs and run every case
+**/
+void bench_run_all(void)
+{
+    uint32_t boot = 0, boot_words = 0;
+    uint8_t i;
+
+    bench_init();
+    bench_fill_strokes(150, 100);
+
+    strcpy(g_bench_command.input_string, BENCH_COMMAND);
+    string_parse(&g_bench_command);
+
+    bench_puts("kernel,iterations,repetitions,median_ticks,mad_ticks,bytes_per_tick\r\n");
+    config_save_state(&g_bench_config);                                         // Keeps profile use and held words
+
+    for (i = 0; i < sizeof(g_bench_cases) / sizeof(g_bench_cases[0]); i++)
+    {
+        uint32_t median = bench_run(&g_bench_cases[i]);
+
+        if (g_bench_cases[i].kernel == bench_config_boot)           boot = median;
+        if (g_bench_cases[i].kernel == bench_config_boot_words)     boot_words = median;
+    }
+    config_restore_state(&g_bench_config);                                      // Solver, surface and grid caches match it again
+
+    if (g_bench_boot_ticks)                                                     // Target only, estimated boot before, measured after
+    {
+        bench_boot_row("boot_to_armed_words", g_bench_boot_ticks + boot_words / 100 - boot / 100);
+        bench_boot_row("boot_to_armed", g_bench_boot_ticks);
+    }
+}
+
+/**
+*      @brief Function to record the cycles from reset to the main loop, call with the counter started by bench_init()
+**/
+void bench_boot_armed(void)
+{
+    g_bench_boot_ticks = bench_ticks();
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+*      @file bench.h
+*      @author Prithvi Bhat
+*      @brief Microbenchmark harness for the firmware hot kernels
+*               The same cases run on the host (BENCH_HOST) and on the target (DWT cycle counter)
+**/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define BENCH_WARMUP        4           // Untimed repetitions before measuring
+#define BENCH_REPETITIONS   31          // Timed repetitions, the median and MAD are taken over these
+
+#ifdef BENCH_HOST
+#define BENCH_SCALE         1000        // Host runs more iterations per repetition to rise above timer noise
+#else
+#define BENCH_SCALE         1
+#endif
+
+typedef void (*bench_kernel_t)(void);
+
+/**
+*      @brief One benchmark case
+**/
+typedef struct
+{
+    const char *name;                   // Kernel name, first CSV column
+    bench_kernel_t kernel;              // Function executing one iteration
+    uint32_t iterations;                // Iterations per repetition (multiplied by BENCH_SCALE)
+    uint32_t bytes;                     // Bytes consumed per iteration for throughput kernels, 0 otherwise
+} bench_case_t;
+
+// Function prototypes
+void bench_init(void);
+uint32_t bench_ticks(void);
+void bench_puts(const char *string);
+uint32_t bench_run(const bench_case_t *bench_case);
+void bench_run_all(void);
+void bench_boot_armed(void);
+
+#endif
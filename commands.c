@@ -5,175 +5,99 @@
 *      @date 2022-12-04
 **/
 
-#include "eeprom.h"
-#include "eeprom_memory_map.h"
+#include "config.h"
 #include "strings.h"
 #include "commands.h"
 #include "timer.h"
 #include "tm4c123gh6pm.h"
-#include <stdio.h>
 #include "wait.h"
 #include "i2c0_lcd.h"
-#include <stdlib.h>
+#include "format.h"
+#include "uart0.h"
+#include "minimap.h"
+#include "tone.h"
+#include "surface.h"
+#include "grid.h"
+#include "health.h"
 #include <math.h>
 
 #define CONVERSION_CONSTANT 0.008575        // ((1 / (40e6)) * 1000 * 343) to convert time register value to mm
-#define ASSERT(value)       if (value <= 1 || value > MAX_AVERAGES)   value = 1;
+#define SOS_SCALE_UNITY     1000000         // SOS_SCALE of exactly 343 m/s
+#define VARIANCE_DECIMALS   3               // Variance is printed in thousandths of mm^2
+#define QUALITY_DECIMALS    2               // Residual and GDOP are printed in hundredths
+#define FRAME_SYNC_1        0xA5            // Binary fix frame, see send_fix_frame()
+#define FRAME_SYNC_2        0x5A
+#define FRAME_FIX           0x01
+#define FRAME_FIX_LENGTH    18
+#define FRAME_FLAG_VALID    0x01
+#define FRAME_FLAG_REDUCED  0x02            // Fix from two ranges
+#define FRAME_FLAG_DOWN     2               // Bits 2 to 4, sensors A to C down
+
+// Macro to round a floating point value to fixed point with the given number of decimals
+#define TO_FIXED(value, decimals)   ((int32_t)((value) * g_fixed_scale[decimals] + (((value) < 0) ? -0.5 : 0.5)))
 
 // Global Variables
 double g_average_A, g_average_B, g_average_C;
 uint32_t g_distance_A, g_distance_B, g_distance_C;
 bool g_values_acceptable = false;
+static const double g_fixed_scale[] = { 1, 10, 100, 1000 };
 
 /**
-*      @brief Macro to load PWM values into appropriate register
+*      @brief Constants derived from the configuration, recomputed only when it changes
 **/
-#define LOAD_PWM(load, sleep)               \
-    ({                                      \
-        PWM1_0_LOAD_R = load;               \
-        PWM1_0_CMPB_R = PWM1_0_LOAD_R / 2;  \
-        waitMicrosecond(sleep);             \
-    })
-
-/**
-*      @brief reverses a string 'str' of length 'len'
-*      @param str string to reverse
-*      @param len length of string
-*      @ref https://tutorialspoint.dev/language/c/convert-floating-point-number-string
-**/
-void reverse(char *str, int len)
+typedef struct
 {
-    int i = 0, j = len - 1, temp;
-    while (i < j)
-    {
-        temp = str[i];
-        str[i] = str[j];
-        str[j] = temp;
-        i++;
-        j--;
-    }
-}
+    int32_t D1;                             // Sensor A to B spacing along y in mm
+    int32_t D2;                             // Sensor B to C spacing along x in mm
+    double conversion;                      // Timer ticks to mm at the configured speed of sound
+    int32_t latency[3];                     // Receive chain delay of sensors A, B and C in timer ticks
+    float x_offset;                         // D2 / 2 less the x fix offset in mm
+    float y_offset;                         // D1 / 2 less the y fix offset in mm
+    float x_scale;                          // 1 / (2 * D2)
+    float y_scale;                          // 1 / (2 * D1)
+} solver_constants_t;
 
 /**
-*      @brief Converts an integer x to string
-*      @param number to be converted
-*      @param str string to store value in
-*      @param digits number of digits required in output
-*      @return int number of digits converted
-*      @ref https://tutorialspoint.dev/language/c/convert-floating-point-number-string
+*      @brief Quality vector reported with every fix
 **/
-int intToStr(int number, char str[], int digits)
+typedef struct
 {
-    int i = 0;
-
-    while (number)
-    {
-        str[i++] = (number % 10) + '0';
-        number = number / 10;
-    }
-    while (i < digits)   str[i++] = '0';                        // Add 0s at the beginning if number of digits exceeds the length of integer
-
-    reverse(str, i);
-    str[i] = '\0';
-
-    return i;
-}
+    float residual;                         // Measured minus predicted range to sensor B in mm
+    float gdop;                             // Geometric dilution of precision at the fix, 0 if degenerate
+    double variance[3];                     // Capture variance of sensors A, B and C in mm^2
+    uint8_t samples[3];                     // Captures averaged per sensor
+    uint8_t down;                           // Sensor left out of a two range fix, HEALTH_NONE for a full fix
+} fix_quality_t;
+
+static solver_constants_t g_solver = { 200, 300, CONVERSION_CONSTANT, { 0, 0, 0 }, 150.0f, 100.0f, 1 / 600.0f, 1 / 400.0f };
+static int32_t g_latency_sum[3];            // Latency calibration, capture minus expected capture per position
+static uint8_t g_latency_positions = 0;
+static fix_quality_t g_quality;             // Quality of the last fix, worked out with it from the windows
+static float g_reference_x = -1, g_reference_y = -1;   // Last fix in the solver frame, picks the side of a two range fix
+static bool g_reference = false;
+static bool g_binary_output = false;        // Fixes sent as binary frames instead of text
 
 /**
-*      @brief Function to convert floating point number to string
-*      @param number to be converted
-*      @param destination string
-*      @param float_length
-*      @ref https://tutorialspoint.dev/language/c/convert-floating-point-number-string
+*      @brief Function to convert a timer capture to a distance, the sensor's receive chain delay taken off
+*      @param ticks timer capture or average of captures
+*      @param sensor 0 for A
+*      @return double distance in mm, 0 for a capture shorter than the delay
 **/
-void ftoa(float number, char *destination, int float_length)
+static double ticks_to_mm(double ticks, uint8_t sensor)
 {
-    int whole_number = (int)number;                             // Extract integer part
-
-    float fractional_number = number - (float)whole_number;     // Extract floating part
-
-    int i = intToStr(whole_number, destination, 0);             // Convert integer part to string
-
-    if (float_length != 0)                                      // Check for display option after point
-    {
-        destination[i] = '.';                                   // Add decimal to string
-
-        fractional_number = fractional_number * pow(10, float_length);
-        intToStr((int)fractional_number, destination + i + 1, float_length);
-    }
+    double mm = (ticks - g_solver.latency[sensor]) * g_solver.conversion;
+    return (mm > 0) ? mm : 0;
 }
 
 /**
-*      @brief Function to beep
+*      @brief Function to beep, the tone is played by the sequencer and this returns at once
 *      @param beep_type
 **/
 void beep_now(beep_t beep_type)
 {
-    uint32_t i = 1, count = 1;
-    switch (beep_type)
-    {
-        case BEEP_IR_INT:
-        {
-            count = readEeprom(CONT_IR);
-            for (i = 1; i <= count; i++)
-            {
-                LOAD_PWM(readEeprom(LOAD_IR), readEeprom(PER1_IR));
-                LOAD_PWM(0, readEeprom(PER2_IR));
-            }
-            break;
-        }
-
-        case BEEP_US_A_INT:
-        {
-            count = readEeprom(CONT_A);
-            for (i = 1; i <= count; i++)
-            {
-                LOAD_PWM(readEeprom(LOAD_A), readEeprom(PER1_A));
-                LOAD_PWM(0, readEeprom(PER2_A));
-            }
-            break;
-        }
-
-        case BEEP_US_B_INT:
-        {
-            count = readEeprom(CONT_B);
-            for (i = 1; i <= count; i++)
-            {
-                LOAD_PWM(readEeprom(LOAD_B), readEeprom(PER1_B));
-                LOAD_PWM(0, readEeprom(PER2_B));
-            }
-            break;
-        }
-
-        case BEEP_US_C_INT:
-        {
-            count = readEeprom(CONT_C);
-            for (i = 1; i <= count; i++)
-            {
-                LOAD_PWM(readEeprom(LOAD_C), readEeprom(PER1_C));
-                LOAD_PWM(0, readEeprom(PER2_C));
-            }
-            break;
-        }
-
-        case BEEP_ERROR:
-        {
-            count = readEeprom(CONT_ERR);
-
-            for (i = 1; i <= count; i++)
-            {
-                LOAD_PWM(readEeprom(LOAD_ERR), readEeprom(PER1_ERR));
-                LOAD_PWM(0, readEeprom(PER2_ERR));
-            }
-            break;
-        }
-
-        case BEEP_START:
-            LOAD_PWM(0, 100000);
-    }
+    tone_request(beep_type);
 }
 
-
 /**
 *      @brief Function to update Sensor Coordinates as input by user
 *      @param sensor One of three possibilities A, B or C
@@ -187,24 +111,24 @@ void update_sensor_coordinates(char *sensor, uint32_t x, uint32_t y)
         case 'A':
         case 'a':
         {
-            writeEeprom(CRD_AX, x);                 // Write S1 x coordinate at address 0x00
-            writeEeprom(CRD_AY, y);                 // Write S1 y coordinate at address 0x32
+            config_set(CRD_AX, x);                   // Sensor A x coordinate
+            config_set(CRD_AY, y);                   // Sensor A y coordinate
             break;
         }
 
         case 'B':
         case 'b':
         {
-            writeEeprom(CRD_BX, x);                 // Write S2 x coordinates at address 0x64
-            writeEeprom(CRD_BY, y);                 // Write S2 y coordinates at address 0x96
+            config_set(CRD_BX, x);                   // Sensor B x coordinate
+            config_set(CRD_BY, y);                   // Sensor B y coordinate
             break;
         }
 
         case 'C':
         case 'c':
         {
-            writeEeprom(CRD_CX, x);                 // Write S3 x coordinates at address 0x128
-            writeEeprom(CRD_CY, y);                 // Write S3 y coordinates at address 0x160
+            config_set(CRD_CX, x);                   // Sensor C x coordinate
+            config_set(CRD_CY, y);                   // Sensor C y coordinate
             break;
         }
 
@@ -215,52 +139,40 @@ void update_sensor_coordinates(char *sensor, uint32_t x, uint32_t y)
         }
     }
 
+    config_flush();                                 // Both coordinates are written in one commit
+    update_solver_constants();
     putsUart0("Sensor coordinates updated in EEPROM\r\n");
 }
 
 /**
  *      @brief Function to calculate average readings and distance of the source of signal from each sensor
- *      @param g_timer_A_FIFO Array holding the value of timer values
- *      @param g_timer_B_FIFO Array holding the value of timer values
- *      @param g_timer_C_FIFO Array holding the value of timer values
+ *               The windows keep running sums, so this costs the same whatever the averaging depth
+ *      @param window_A Sliding window of sensor A captures
+ *      @param window_B Sliding window of sensor B captures
+ *      @param window_C Sliding window of sensor C captures
  *      @param print boolean value that determines if distance must be printed or not
  **/
-void calculate_distance(uint32_t *g_timer_A_FIFO, uint32_t *g_timer_B_FIFO, uint32_t *g_timer_C_FIFO, bool print)
+void calculate_distance(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C, bool print)
 {
-    char string[100];
-
-    uint32_t value_count = readEeprom(TC_AVG);
-    ASSERT(value_count);                                                    // Failsafe to avoid divide by zero error
-
-    uint8_t i;
-
     g_average_A = g_average_B = g_average_C = 0;
 
-    for (i = 0; i < value_count; i++)
-    {
-        g_average_A = g_average_A + g_timer_A_FIFO[i];
-        g_average_B = g_average_B + g_timer_B_FIFO[i];
-        g_average_C = g_average_C + g_timer_C_FIFO[i];
-    }
-
-    g_average_A = g_average_A / (double)value_count;                        // Find average
-    g_average_B = g_average_B / (double)value_count;                        // Find average
-    g_average_C = g_average_C / (double)value_count;                        // Find average
+    if (window_A->filled != 0)  g_average_A = window_A->sum / (double)window_A->filled;    // Find average
+    if (window_B->filled != 0)  g_average_B = window_B->sum / (double)window_B->filled;    // Find average
+    if (window_C->filled != 0)  g_average_C = window_C->sum / (double)window_C->filled;    // Find average
 
-    g_distance_A = (g_average_A * CONVERSION_CONSTANT);
-    g_distance_B = (g_average_B * CONVERSION_CONSTANT);
-    g_distance_C = (g_average_C * CONVERSION_CONSTANT);
+    g_distance_A = ticks_to_mm(g_average_A, 0);
+    g_distance_B = ticks_to_mm(g_average_B, 1);
+    g_distance_C = ticks_to_mm(g_average_C, 2);
 
     if (print)
     {
-        sprintf(string, "Distance from Sensor A: %dmm\r\n", g_distance_A);      // Convert to string
-        putsUart0(string);                                                      // Print
-
-        sprintf(string, "Distance from Sensor B: %dmm\r\n", g_distance_B);      // Convert to string
-        putsUart0(string);                                                      // Print
-
-        sprintf(string, "Distance from Sensor C: %dmm\r\n\r\n", g_distance_C);  // Convert to string
-        putsUart0(string);                                                      // Print
+        format_string(putcUart0, "Distance from Sensor A: ");                   // Print
+        format_uint(putcUart0, g_distance_A);
+        format_string(putcUart0, "mm\r\nDistance from Sensor B: ");
+        format_uint(putcUart0, g_distance_B);
+        format_string(putcUart0, "mm\r\nDistance from Sensor C: ");
+        format_uint(putcUart0, g_distance_C);
+        format_string(putcUart0, "mm\r\n\r\n");
     }
 }
 
@@ -269,157 +181,515 @@ void calculate_distance(uint32_t *g_timer_A_FIFO, uint32_t *g_timer_B_FIFO, uint
 *      @param beep_type enum type of beep
 *      @param load load value for PWM
 *      @param per1 on time of PWM
-*      @param per2 off time of PWM
-*      @param count number of beeps to play in tone
+*      @param per2 off time of PWM in ms, 0 for the tone's default
+*      @param count number of beeps to play in tone, 0 for the tone's default
 **/
-void write_beep(beep_t beep_type, uint32_t load, uint32_t per1)
+void write_beep(beep_t beep_type, uint32_t load, uint32_t per1, uint32_t per2, uint32_t count)
 {
+    uint32_t default_per2, default_count;
+    uint8_t base;
+
     switch (beep_type)
     {
         case BEEP_IR_INT:
         {
-            writeEeprom(LOAD_IR, (load * 10000));
-            writeEeprom(PER1_IR, (per1 * 100000));
-            writeEeprom(PER2_IR, 10000);
-            writeEeprom(CONT_IR, 2);
-
+            base = LOAD_IR;
+            default_per2 = 10000;
+            default_count = 2;
             break;
         }
 
         case BEEP_US_A_INT:
-        {
-            writeEeprom(LOAD_A, (load * 10000));
-            writeEeprom(PER1_A, (per1 * 100000));
-            writeEeprom(PER2_A, 50000);
-            writeEeprom(CONT_A, 3);
-
-            break;
-        }
-
         case BEEP_US_B_INT:
+        case BEEP_US_C_INT:
         {
-            writeEeprom(LOAD_B, (load * 10000));
-            writeEeprom(PER1_B, (per1 * 100000));
-            writeEeprom(PER2_B, 50000);
-            writeEeprom(CONT_B, 3);
-
+            base = (beep_type == BEEP_US_A_INT) ? LOAD_A : (beep_type == BEEP_US_B_INT) ? LOAD_B : LOAD_C;
+            default_per2 = 50000;
+            default_count = 3;
             break;
         }
 
-        case BEEP_US_C_INT:
+        case BEEP_ERROR:
         {
-            writeEeprom(LOAD_C, (load * 10000));
-            writeEeprom(PER1_C, (per1 * 100000));
-            writeEeprom(PER2_C, 50000);
-            writeEeprom(CONT_C, 3);
-
+            base = LOAD_ERR;
+            default_per2 = 100000;
+            default_count = 4;
             break;
         }
 
-        case BEEP_ERROR:
+        default:
         {
-            writeEeprom(LOAD_ERR, (load * 10000));
-            writeEeprom(PER1_ERR, (per1 * 100000));
-            writeEeprom(PER2_ERR, 100000);
-            writeEeprom(CONT_ERR, 4);
-
-            break;
+            return;
         }
     }
+
+    // LOAD, PER1, PER2 and CONT of a tone are consecutive configuration words
+    config_set(base, (load * 10000));
+    config_set(base + 1, (per1 * 100000));
+    config_set(base + 2, (per2 != 0) ? (per2 * 1000) : default_per2);
+    config_set(base + 3, (count != 0) ? count : default_count);
+
+    config_flush();
 }
 
 /**
-*      @brief Function to calculate the variance of a reading
+*      @brief Function to work out the distances, variances and sample counts of the windows, and whether
+*               they give a fix, without printing anything
 *               Variance is calculated as follows
 *                   (((mean - individual_reading) ^ 2) / number_of_readings)
-*      @param g_timer_A_FIFO Array holding the value of timer values
-*      @param g_timer_B_FIFO Array holding the value of timer values
-*      @param g_timer_C_FIFO Array holding the value of timer values
+*      @param window_A Sliding window of sensor A captures
+*      @param window_B Sliding window of sensor B captures
+*      @param window_C Sliding window of sensor C captures
 **/
-void calculate_variance(uint32_t *g_timer_A_FIFO, uint32_t *g_timer_B_FIFO, uint32_t *g_timer_C_FIFO)
+static void measure_windows(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C)
 {
-    if (g_distance_A == 0 || g_distance_C == 0 || g_distance_C == 0)
-    {
-        calculate_distance(g_timer_A_FIFO, g_timer_B_FIFO, g_timer_C_FIFO, false);  // Get Average if not already available
-    }
-
-    uint32_t value_count = readEeprom(TC_AVG);                                      // Read value from EEPROM
-    ASSERT(value_count);                                                            // Failsafe to avoid divide by zero error
+    calculate_distance(window_A, window_B, window_C, false);                        // Mean of the same window
 
     double variance_A = 0, variance_B = 0, variance_C = 0, numerator_A = 0, numerator_B = 0, numerator_C = 0;
     uint8_t i;
-    char string[100];
     double bobA, bobB, bobC;
 
-    for (i = 0; i < value_count; i++)
+    for (i = 0; i < window_A->filled; i++)
     {
-        bobA = ((g_timer_A_FIFO[i] * CONVERSION_CONSTANT) - g_distance_A);
+        bobA = (ticks_to_mm(window_sample(window_A, i), 0) - g_distance_A);
         numerator_A = (numerator_A + (bobA * bobA));
-
-        bobB = ((g_timer_B_FIFO[i] * CONVERSION_CONSTANT) - g_distance_B);
+    }
+    for (i = 0; i < window_B->filled; i++)
+    {
+        bobB = (ticks_to_mm(window_sample(window_B, i), 1) - g_distance_B);
         numerator_B = (numerator_B + (bobB * bobB));
-
-        bobC = ((g_timer_C_FIFO[i] * CONVERSION_CONSTANT) - g_distance_C);
+    }
+    for (i = 0; i < window_C->filled; i++)
+    {
+        bobC = (ticks_to_mm(window_sample(window_C, i), 2) - g_distance_C);
         numerator_C = (numerator_C + (bobC * bobC));
     }
 
-    variance_A = numerator_A / value_count;
-    variance_B = numerator_B / value_count;
-    variance_C = numerator_C / value_count;
+    if (window_A->filled != 0)  variance_A = numerator_A / window_A->filled;
+    if (window_B->filled != 0)  variance_B = numerator_B / window_B->filled;
+    if (window_C->filled != 0)  variance_C = numerator_C / window_C->filled;
+
+    g_quality.variance[0] = variance_A;
+    g_quality.variance[1] = variance_B;
+    g_quality.variance[2] = variance_C;
+    g_quality.samples[0] = window_A->filled;
+    g_quality.samples[1] = window_B->filled;
+    g_quality.samples[2] = window_C->filled;
+
+    g_quality.down = health_down_channel();
 
-    if (variance_A <= 10 && variance_B <= 10 && variance_C <= 10)                   // Ensure variance conforms to acceptable range
+    g_values_acceptable = (health_down_count() <= 1);                               // Ensure variance conforms to acceptable range,
+    if (health_up(0) && (window_A->filled == 0 || variance_A > 10))     g_values_acceptable = false;   // sensors that are down
+    if (health_up(1) && (window_B->filled == 0 || variance_B > 10))     g_values_acceptable = false;   // are left out
+    if (health_up(2) && (window_C->filled == 0 || variance_C > 10))     g_values_acceptable = false;
+}
+
+/**
+*      @brief Function to calculate and print the variance of the readings
+*      @param window_A Sliding window of sensor A captures
+*      @param window_B Sliding window of sensor B captures
+*      @param window_C Sliding window of sensor C captures
+**/
+void calculate_variance(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C)
+{
+    measure_windows(window_A, window_B, window_C);
+
+    format_string(putcUart0, "Variance of Sensor A readings = ");                   // Print in thousandths of mm^2
+    format_fixed(putcUart0, TO_FIXED(g_quality.variance[0], VARIANCE_DECIMALS), VARIANCE_DECIMALS);
+    format_string(putcUart0, "\r\nVariance of Sensor B readings = ");
+    format_fixed(putcUart0, TO_FIXED(g_quality.variance[1], VARIANCE_DECIMALS), VARIANCE_DECIMALS);
+    format_string(putcUart0, "\r\nVariance of Sensor C readings = ");
+    format_fixed(putcUart0, TO_FIXED(g_quality.variance[2], VARIANCE_DECIMALS), VARIANCE_DECIMALS);
+    format_string(putcUart0, "\r\n\r\n");
+}
+
+/**
+*      @brief Function to locate the pen from two ranges while the third sensor is down
+*               The circles around the two sensors in use cross at two points, mirrored in the line through
+*               the sensors. The one on the side of the last fix is taken, before the first fix the side of
+*               the sensor that is down, which for A or C is the writing area. With B down both points can be
+*               on the writing area and a pen crossing the line from A to C is mirrored. Ranges too short to
+*               meet give the point on the line between them
+*      @param down sensor that is down, 0 for A
+*      @param x, y set to the pen position in mm, fix offsets included
+**/
+static void solve_two_ranges(uint8_t down, float *x, float *y)
+{
+    const float sensor_x[3] = { 0, 0, (float)g_solver.D2 };                        // Solver frame, B at the origin
+    const float sensor_y[3] = { (float)g_solver.D1, 0, 0 };
+    const float range[3] = { (float)g_distance_A, (float)g_distance_B, (float)g_distance_C };
+    uint8_t p = (down == 0) ? 1 : 0, q = (down == 2) ? 1 : 2;                      // Sensors in use
+    float ex = sensor_x[q] - sensor_x[p], ey = sensor_y[q] - sensor_y[p];
+    float spacing = sqrtf(ex * ex + ey * ey), along, across, side;
+    float reference_x = g_reference ? g_reference_x : sensor_x[down];
+    float reference_y = g_reference ? g_reference_y : sensor_y[down];
+
+    ex /= spacing;
+    ey /= spacing;
+    along = (range[p] * range[p] - range[q] * range[q] + spacing * spacing) / (2 * spacing);
+    across = range[p] * range[p] - along * along;
+    across = (across > 0) ? sqrtf(across) : 0;
+
+    side = ex * (reference_y - sensor_y[p]) - ey * (reference_x - sensor_x[p]);   // Half plane of the reference
+    if (side < 0)   across = -across;
+
+    *x = sensor_x[p] + along * ex - across * ey + g_solver.x_offset - g_solver.D2 * 0.5f;
+    *y = sensor_y[p] + along * ey + across * ex + g_solver.y_offset - g_solver.D1 * 0.5f;
+}
+
+/**
+*      @brief Function to work out the quality of a fix
+*               The three ranges overdetermine the two coordinates: x comes from B and C, y from A and B, and
+*               the range to B predicted from the fix is compared with the measured one. GDOP is worked out
+*               from the directions of the sensors as seen from the fix, sqrt(trace((H^T H)^-1)) for the
+*               unit vector rows of H, sensors the pen is sitting on left out. A two range fix has no
+*               residual and its GDOP comes from the two sensors in use
+*      @param x, y fix in mm, fix offsets included
+**/
+static void assess_fix(float x, float y)
+{
+    float sensor_x[3] = { 0, 0, (float)g_solver.D2 };                              // Solver frame, B at the origin
+    float sensor_y[3] = { (float)g_solver.D1, 0, 0 };
+    float xx = 0, yy = 0, xy = 0, determinant, range;
+    uint8_t i, rows = 0;
+
+    x += g_solver.D2 * 0.5f - g_solver.x_offset;                                   // Back into the solver frame
+    y += g_solver.D1 * 0.5f - g_solver.y_offset;
+
+    g_quality.residual = (g_quality.down == HEALTH_NONE) ? (float)g_distance_B - sqrtf(x * x + y * y) : 0;
+    g_reference_x = x;
+    g_reference_y = y;
+    g_reference = true;
+
+    for (i = 0; i < 3; i++)
     {
-        g_values_acceptable = true;
+        float dx = x - sensor_x[i], dy = y - sensor_y[i];
+
+        range = sqrtf(dx * dx + dy * dy);
+        if (range < 1 || i == g_quality.down)   continue;                           // No direction to a sensor under the pen
+        dx /= range;
+        dy /= range;
+        xx += dx * dx;
+        yy += dy * dy;
+        xy += dx * dy;
+        rows++;
     }
 
-    sprintf(string, "Variance of Sensor A readings = %f\r\n", variance_A);          // Convert to string
-    putsUart0(string);                                                              // Print
+    determinant = xx * yy - xy * xy;
+    g_quality.gdop = (determinant > 1e-6f) ? sqrtf(rows / determinant) : 0;
+}
 
-    sprintf(string, "Variance of Sensor B readings = %f\r\n", variance_B);          // Convert to string
-    putsUart0(string);                                                              // Print
+/**
+*      @brief Function to print the quality of a fix, or only the capture statistics for a rejected one
+*      @param valid true if a fix was found
+**/
+static void print_fix_quality(bool valid)
+{
+    uint8_t i;
 
-    sprintf(string, "Variance of Sensor C readings = %f\r\n\r\n", variance_C);      // Convert to string
-    putsUart0(string);                                                              // Print
+    format_string(putcUart0, "quality: ");
+    if (valid)
+    {
+        if (g_quality.down == HEALTH_NONE)
+        {
+            format_string(putcUart0, "residual ");
+            format_fixed(putcUart0, TO_FIXED(g_quality.residual, QUALITY_DECIMALS), QUALITY_DECIMALS);
+            format_string(putcUart0, "mm, GDOP ");
+        }
+        else
+        {
+            format_string(putcUart0, "reduced, sensor ");
+            putcUart0('A' + g_quality.down);
+            format_string(putcUart0, " down, GDOP ");
+        }
+        if (g_quality.gdop > 0)     format_fixed(putcUart0, TO_FIXED(g_quality.gdop, QUALITY_DECIMALS), QUALITY_DECIMALS);
+        else                        format_string(putcUart0, "-");
+        format_string(putcUart0, ", ");
+    }
+    format_string(putcUart0, "variance");
+    for (i = 0; i < 3; i++)
+    {
+        format_string(putcUart0, " ");
+        format_fixed(putcUart0, TO_FIXED(g_quality.variance[i], VARIANCE_DECIMALS), VARIANCE_DECIMALS);
+    }
+    format_string(putcUart0, "mm^2, samples");
+    for (i = 0; i < 3; i++)
+    {
+        format_string(putcUart0, " ");
+        format_uint(putcUart0, g_quality.samples[i]);
+    }
+    format_string(putcUart0, "\r\n\r\n");
 }
 
 /**
-*      @brief Function to calculate x, y coordinates
+*      @brief Function to clamp a scaled value into a frame field
 **/
-void calculate_coordinates(void)
+static uint16_t frame_field(double value, double scale, int32_t low, int32_t high)
 {
-    char string[100];
-    char stringx[50];
-    char stringy[50];
-    if (g_values_acceptable)
+    double scaled = value * scale + ((value < 0) ? -0.5 : 0.5);
+
+    if (scaled < low)   return (uint16_t)low;
+    if (scaled > high)  return (uint16_t)high;
+    return (uint16_t)(int32_t)scaled;
+}
+
+/**
+*      @brief Function to send a fix and its quality as a binary frame
+*               A5 5A, type 01, length 18, payload, Fletcher-16 of type, length and payload (sum1, then sum2).
+*               Payload, little endian: x mm, y mm, residual 0.01 mm (int16), GDOP 0.01 (uint16, 0 if
+*               degenerate), variance A, B, C 0.001 mm^2 (uint16, saturated), samples A, B, C (uint8), flags
+*               (bit 0 set for a valid fix, position, residual and GDOP are 0 otherwise, bit 1 for a fix from
+*               two ranges, bits 2 to 4 for sensors A to C down)
+*      @param valid true if a fix was found
+*      @param x_mm, y_mm fix rounded to whole mm, or whole surface units once mapped
+**/
+static void send_fix_frame(bool valid, int32_t x_mm, int32_t y_mm)
+{
+    uint8_t frame[FRAME_FIX_LENGTH + 2], sum1 = 0, sum2 = 0, i;
+    uint16_t field[7];
+
+    field[0] = frame_field(valid ? x_mm : 0, 1, INT16_MIN, INT16_MAX);
+    field[1] = frame_field(valid ? y_mm : 0, 1, INT16_MIN, INT16_MAX);
+    field[2] = frame_field(valid ? g_quality.residual : 0, 100, INT16_MIN, INT16_MAX);
+    field[3] = frame_field(valid ? g_quality.gdop : 0, 100, 0, UINT16_MAX);
+    for (i = 0; i < 3; i++)     field[4 + i] = frame_field(g_quality.variance[i], 1000, 0, UINT16_MAX);
+
+    frame[0] = FRAME_FIX;
+    frame[1] = FRAME_FIX_LENGTH;
+    for (i = 0; i < 7; i++)
     {
-        double x = 0, y = 0;
+        frame[2 + 2 * i] = field[i] & 0xFF;
+        frame[3 + 2 * i] = field[i] >> 8;
+    }
+    for (i = 0; i < 3; i++)     frame[16 + i] = g_quality.samples[i];
+    frame[19] = valid ? FRAME_FLAG_VALID : 0;
+    if (valid && g_quality.down != HEALTH_NONE)     frame[19] |= FRAME_FLAG_REDUCED;
+    for (i = 0; i < 3; i++)
+    {
+        if (!health_up(i))  frame[19] |= 1 << (FRAME_FLAG_DOWN + i);
+    }
 
-        int32_t D1 = (readEeprom(CRD_BY) - readEeprom(CRD_AY));
-        int32_t D2 = (readEeprom(CRD_CX) - readEeprom(CRD_BX));
+    putcUart0(FRAME_SYNC_1);
+    putcUart0(FRAME_SYNC_2);
+    for (i = 0; i < sizeof(frame); i++)
+    {
+        sum1 = (sum1 + frame[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+        putcUart0(frame[i]);
+    }
+    putcUart0(sum1);
+    putcUart0(sum2);
+}
+
+/**
+*      @brief Function to choose how fixes are reported on the terminal
+*      @param binary true for binary frames, false for text
+**/
+void set_fix_output(bool binary)
+{
+    g_binary_output = binary;
+}
 
-        if (D1 <= 0 || D1 >= 200)    D1 = 200;
-        if (D2 <= 0 || D2 >= 300)    D2 = 300;
+/**
+*      @brief Function to work out a fix and its quality from the sliding windows as they are now
+*      @param window_A, window_B, window_C sliding windows of captures
+*      @param x, y set to the fix in mm, fix offsets and grid correction included, before the surface mapping
+*      @return bool false if the captures do not give a fix
+**/
+static bool locate_fix(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                       float *x, float *y)
+{
+    measure_windows(window_A, window_B, window_C);                                  // Variances and samples of this fix
+    if (!g_values_acceptable)
+    {
+        g_quality.residual = 0;
+        g_quality.gdop = 0;
+        return false;
+    }
 
-        y = (((D1 * D1) + (g_distance_B * g_distance_B) - (g_distance_A * g_distance_A)) / (2 * D1));
-        x = (((D2 * D2) + (g_distance_B * g_distance_B) - (g_distance_C * g_distance_C)) / (2 * D2));
+    if (g_quality.down == HEALTH_NONE)  solve_position(g_distance_A, g_distance_B, g_distance_C, x, y);
+    else                                solve_two_ranges(g_quality.down, x, y);
+    assess_fix(*x, *y);
 
-        x = x - (double)readEeprom(FIX_X);
-        y = y - (double)readEeprom(FIX_Y);
+    grid_apply(x, y);                                                               // Position dependent bias
+    return true;
+}
 
-        ftoa(x, stringx, 0);                                                        // Convert floating number to string
-        ftoa(y, stringy, 0);                                                        // Convert floating number to string
-        sprintf(string, "x,y: %0.0fmm, %0.0fmm\r\n\r\n", x, y);
+/**
+*      @brief Function to show a fix on the LCD
+*      @param x_mm, y_mm fix rounded to whole mm, or whole surface units once mapped
+**/
+static void display_fix(int32_t x_mm, int32_t y_mm)
+{
+    char stringx[12];
+    char stringy[12];
+
+    format_buffer_begin(stringx, sizeof(stringx));                                  // Convert to string
+    format_int(format_buffer_put, x_mm);
+    format_buffer_begin(stringy, sizeof(stringy));                                  // Convert to string
+    format_int(format_buffer_put, y_mm);
+
+    putsLcd(0, 0, stringx);                                                         // Display on LCD screen
+    putsLcd(1, 0, stringy);                                                         // Display on LCD screen
+}
+
+/**
+*      @brief Function to follow the pen, call after every stroke that slid the windows on
+*               Each stroke gives a fresh averaged fix: the LCD and the pen trail are updated, and in binary
+*               output mode the fix is streamed as a frame. Text fixes are only printed on request by coord
+*      @param window_A, window_B, window_C sliding windows of captures
+*      @param x_mm, y_mm set to the fix rounded to whole units, surface mapping applied
+*      @return bool false if the stroke gave no fix, x_mm and y_mm are left alone then
+**/
+bool track_stroke(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                  int32_t *x_mm, int32_t *y_mm)
+{
+    float x, y;
+
+    if (!locate_fix(window_A, window_B, window_C, &x, &y))
+    {
+        minimap_add_miss();
+        if (g_binary_output)    send_fix_frame(false, 0, 0);
+        return false;
+    }
+
+    minimap_add_fix(TO_FIXED(x, 0), TO_FIXED(y, 0), timer_ms());                    // Trail in the sensor frame
+    surface_apply(&x, &y);                                                          // Last stage, surface units
+
+    *x_mm = TO_FIXED(x, 0);                                                         // Round to whole units
+    *y_mm = TO_FIXED(y, 0);
+    display_fix(*x_mm, *y_mm);
+
+    if (g_binary_output)    send_fix_frame(true, *x_mm, *y_mm);
+    return true;
+}
+
+/**
+*      @brief Function to calculate x, y coordinates from the sliding windows and report them with their quality
+*      @param window_A, window_B, window_C sliding windows of captures
+**/
+void calculate_coordinates(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C)
+{
+    float x, y;
+
+    if (locate_fix(window_A, window_B, window_C, &x, &y))
+    {
+        surface_apply(&x, &y);                                                      // Last stage, surface units
+
+        int32_t x_mm = TO_FIXED(x, 0);                                              // Round to whole units
+        int32_t y_mm = TO_FIXED(y, 0);
+
+        display_fix(x_mm, y_mm);
+
+        if (g_binary_output)
+        {
+            send_fix_frame(true, x_mm, y_mm);
+            return;
+        }
 
-        putsLcd(0, 0, stringx);                                                     // Display on LCD screen
-        putsLcd(1, 0, stringy);                                                     // Display on LCD screen
-        putsUart0(string);                                                          // Display on Terminal
+        format_string(putcUart0, "x,y: ");                                          // Display on Terminal
+        format_int(putcUart0, x_mm);
+        format_string(putcUart0, "mm, ");
+        format_int(putcUart0, y_mm);
+        format_string(putcUart0, "mm\r\n");
+        print_fix_quality(true);
     }
     else
     {
-        putsUart0("Variance out of bounds\r\n\r\n");
+        if (g_binary_output)
+        {
+            send_fix_frame(false, 0, 0);
+            return;
+        }
+
+        putsUart0((health_down_count() > 1) ? "Too few sensors to track\r\n" : "Variance out of bounds\r\n");
+        print_fix_quality(false);
     }
 }
 
+/**
+*      @brief Function to locate the pen from its distances to the sensors
+*               x = (D2^2 + B^2 - C^2) / 2D2 and y = (D1^2 + B^2 - A^2) / 2D1, fix offsets taken off.
+*               Every term that depends only on the geometry is kept in g_solver, leaving a few single
+*               precision multiply-adds per fix, which the FPU does in a cycle or two, and no division
+*      @param distance_A, distance_B, distance_C distance from each sensor in mm
+*      @param x, y set to the pen position in mm
+**/
+void solve_position(uint32_t distance_A, uint32_t distance_B, uint32_t distance_C, float *x, float *y)
+{
+    float a = (float)distance_A, b = (float)distance_B, c = (float)distance_C;
+    float b2 = b * b;
+
+    *x = g_solver.x_offset + (b2 - c * c) * g_solver.x_scale;
+    *y = g_solver.y_offset + (b2 - a * a) * g_solver.y_scale;
+}
+
+/**
+*      @brief Function to locate a pen held still from the averaged strokes, without reporting the fix
+*      @param x, y set to the fix in mm, fix offsets and grid correction included, before the surface mapping
+*      @return bool false if a sensor has no strokes yet
+**/
+bool calculate_position(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                        float *x, float *y)
+{
+    if (window_A->filled == 0 || window_B->filled == 0 || window_C->filled == 0)    return false;
+
+    calculate_distance(window_A, window_B, window_C, false);
+    solve_position(g_distance_A, g_distance_B, g_distance_C, x, y);
+    grid_apply(x, y);
+    return true;
+}
+
+/**
+*      @brief Function to work out the captures a pen at a known position should produce, latencies included
+*      @param x, y pen position in mm, in the frame of the sensor coordinates
+*      @param ticks set to the expected timer capture of sensors A, B and C
+**/
+void calculate_expected_ticks(int32_t x, int32_t y, uint32_t *ticks)
+{
+    static const uint8_t sensor_x[] = { CRD_AX, CRD_BX, CRD_CX };
+    static const uint8_t sensor_y[] = { CRD_AY, CRD_BY, CRD_CY };
+    uint8_t i;
+
+    for (i = 0; i < 3; i++)
+    {
+        double dx = x - (int32_t)config_get(sensor_x[i]);
+        double dy = y - (int32_t)config_get(sensor_y[i]);
+        ticks[i] = (uint32_t)(sqrt(dx * dx + dy * dy) / g_solver.conversion + g_solver.latency[i] + 0.5);
+    }
+}
+
+/**
+*      @brief Function to recompute the solver constants from the configuration
+*               Call after the sensor coordinates, the fix offsets, the speed of sound scale, the latencies or the
+*               active profile change
+**/
+void update_solver_constants(void)
+{
+    int32_t D1 = (config_get(CRD_BY) - config_get(CRD_AY));
+    int32_t D2 = (config_get(CRD_CX) - config_get(CRD_BX));
+    uint32_t scale = config_get(SOS_SCALE);
+
+    if (D1 <= 0 || D1 >= 200)    D1 = 200;
+    if (D2 <= 0 || D2 >= 300)    D2 = 300;
+    if (scale == 0 || scale > 2 * SOS_SCALE_UNITY)  scale = SOS_SCALE_UNITY;   // Ignore implausible scales
+
+    g_solver.D1 = D1;
+    g_solver.D2 = D2;
+    g_solver.conversion = CONVERSION_CONSTANT * scale / SOS_SCALE_UNITY;
+    g_solver.latency[0] = (int32_t)config_get(LAT_A);
+    g_solver.latency[1] = (int32_t)config_get(LAT_B);
+    g_solver.latency[2] = (int32_t)config_get(LAT_C);
+    g_solver.x_offset = D2 / 2.0f - (float)(int32_t)config_get(FIX_X);            // Offsets are signed
+    g_solver.y_offset = D1 / 2.0f - (float)(int32_t)config_get(FIX_Y);
+    g_solver.x_scale = 1.0f / (2 * D2);
+    g_solver.y_scale = 1.0f / (2 * D1);
+    surface_load();
+
+    minimap_set_area(D2, D1);                                                       // x runs along B to C, y along A to B
+    grid_load(D2, D1);
+}
+
 /**
 *      @brief Function to update drift from true x, y values in the EEPROM
 *      @param x_fix drift from true coordinate
@@ -427,8 +697,75 @@ void calculate_coordinates(void)
 **/
 void update_fix(int32_t x_fix, int32_t y_fix)
 {
-    writeEeprom(FIX_X, x_fix);
-    writeEeprom(FIX_Y, y_fix);
+    config_set(FIX_X, (uint32_t)x_fix);
+    config_set(FIX_Y, (uint32_t)y_fix);
+    config_flush();
+    update_solver_constants();
+}
+
+/**
+*      @brief Function to add a known pen position to the latency calibration
+*               Each position contributes the difference between the averaged captures and the captures
+*               expected there, so the estimate needs no particular position and improves with each one
+*      @param x, y pen position in mm, in the frame of the sensor coordinates
+*      @return bool false if a window holds no captures yet
+**/
+bool calibrate_latency_add(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                           int32_t x, int32_t y)
+{
+    const capture_window_t *window[3] = { window_A, window_B, window_C };
+    uint32_t expected[3];
+    uint8_t i;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (window[i]->filled == 0)     return false;
+    }
+
+    calculate_expected_ticks(x, y, expected);
+    for (i = 0; i < 3; i++)
+    {
+        g_latency_sum[i] += TO_FIXED(window[i]->sum / (double)window[i]->filled - expected[i], 0);
+    }
+    g_latency_positions++;
+    return true;
+}
+
+/**
+*      @brief Function to store the latencies from the positions collected and start a new calibration
+*      @return bool false if no position was collected
+**/
+bool calibrate_latency_save(void)
+{
+    static const uint8_t latency[] = { LAT_A, LAT_B, LAT_C };
+    uint8_t i;
+
+    if (g_latency_positions == 0)   return false;
+
+    for (i = 0; i < 3; i++)                                                         // Remaining error on top of the current value
+    {
+        config_set(latency[i], (uint32_t)(g_solver.latency[i] + g_latency_sum[i] / g_latency_positions));
+        g_latency_sum[i] = 0;
+    }
+    g_latency_positions = 0;
+
+    config_flush();
+    update_solver_constants();
+    return true;
+}
 
-    waitMicrosecond(1000000);
+/**
+*      @brief Function to print the latencies and the calibration progress
+**/
+void print_latency(void)
+{
+    format_string(putcUart0, "Latency A ");
+    format_int(putcUart0, g_solver.latency[0]);
+    format_string(putcUart0, ", B ");
+    format_int(putcUart0, g_solver.latency[1]);
+    format_string(putcUart0, ", C ");
+    format_int(putcUart0, g_solver.latency[2]);
+    format_string(putcUart0, " ticks, ");
+    format_uint(putcUart0, g_latency_positions);
+    format_string(putcUart0, " calibration positions collected\r\n\r\n");
 }
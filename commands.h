@@ -10,12 +10,13 @@
 
 #include "inttypes.h"
 #include "gpio.h"
+#include "window.h"
 
 #define LED_B           PORTF,2
 #define LED_R           PORTF,1
 #define LED_G           PORTF,3
 
-#define MAX_AVERAGES    10
+#define MAX_AVERAGES    WINDOW_SIZE
 #define MAX_FIFO_SIZE   20
 
 /**
@@ -88,11 +89,23 @@ typedef enum
 } beep_t;
 
 void update_sensor_coordinates(char *sensor, uint32_t x, uint32_t y);
-void calculate_distance(uint32_t *g_timer_A_FIFO, uint32_t *g_timer_B_FIFO, uint32_t *g_timer_C_FIFO, bool print);
-void calculate_variance(uint32_t *g_timer_A_FIFO, uint32_t *g_timer_B_FIFO, uint32_t *g_timer_C_FIFO);
-void write_beep(beep_t beep_type, uint32_t load, uint32_t per1);
+void calculate_distance(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C, bool print);
+void calculate_variance(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C);
+void write_beep(beep_t beep_type, uint32_t load, uint32_t per1, uint32_t per2, uint32_t count);
 void beep_now(beep_t beep_type);
-void calculate_coordinates(void);
+void calculate_coordinates(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C);
+bool track_stroke(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                  int32_t *x_mm, int32_t *y_mm);
+void set_fix_output(bool binary);
+bool calculate_position(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                        float *x, float *y);
+void solve_position(uint32_t distance_A, uint32_t distance_B, uint32_t distance_C, float *x, float *y);
 void update_fix(int32_t x_fix, int32_t y_fix);
+void update_solver_constants(void);
+void calculate_expected_ticks(int32_t x, int32_t y, uint32_t *ticks);
+bool calibrate_latency_add(const capture_window_t *window_A, const capture_window_t *window_B, const capture_window_t *window_C,
+                           int32_t x, int32_t y);
+bool calibrate_latency_save(void);
+void print_latency(void);
 
 #endif
@@ -0,0 +1,595 @@
+/**
+*      @file config.c
+*      @author Prithvi Bhat
+*      @brief RAM shadow of the EEPROM configuration with transactional bulk upload
+*               * The configuration is stored as a header (magic, version, length, CRC) followed by the payload,
+*                 see eeprom_memory_map.h
+*               * All configuration reads are served from the RAM shadow
+*               * config_set() only marks words dirty, config_flush() writes the dirty words and the CRC
+*                 through the staging area so the stored image is never left half written
+*               * Older layouts are migrated in place at boot
+*               * Frequently rewritten words (fix offsets, averaging depth) are kept in the wear leveled journal
+*                 instead, the stored image keeps whatever they held before and the journal overrides it at boot
+*               * A complete configuration can be uploaded as a CRC protected text blob:
+*                   config load <words> <crc32>
+*                   config data <word> ... (up to CONFIG_LINE_WORDS words per line)
+*                 The blob is committed atomically through the staging area once the last word arrives. A
+*                 shorter blob dumped by older firmware is upgraded like an older layout at boot
+*               * "config dump" prints the current configuration in the same format, ready to paste
+*               * config_hold() changes a live word in RAM only, e.g. for a profile switch, until it is
+*                 stored by config_keep() or set again by config_set()
+**/
+
+#include "config.h"
+#include "eeprom.h"
+#include "format.h"
+#include "uart0.h"
+#include "journal.h"
+
+#define STAGE_PENDING   0xC0A1D00D          // Staged image is complete and being applied
+#define STAGE_IDLE      0x00000000          // Nothing to replay
+#define ERASED          0xFFFFFFFF          // Value of a word that has never been written
+#define V1_NONE         0xFF                // Payload word without a version 1 counterpart
+#define BOOT_WORDS      ((V1_WORDS > CONFIG_IMAGE_WORDS) ? V1_WORDS : CONFIG_IMAGE_WORDS)
+
+#define PAYLOAD         (g_image + CONFIG_HEADER_WORDS)
+#define DIRTY_WORDS     ((CONFIG_IMAGE_WORDS + 31) / 32)
+#define MARK_DIRTY(i)   (g_dirty[(i) >> 5] |= 1u << ((i) & 31))
+#define IS_DIRTY(i)     (g_dirty[(i) >> 5] & (1u << ((i) & 31)))
+#define HELD_WORDS      ((CONFIG_WORDS + 31) / 32)
+#define MARK_HELD(i)    (g_held[(i) >> 5] |= 1u << ((i) & 31))
+#define CLEAR_HELD(i)   (g_held[(i) >> 5] &= ~(1u << ((i) & 31)))
+#define IS_HELD(i)      (g_held[(i) >> 5] & (1u << ((i) & 31)))
+
+// Global Variables
+static uint32_t g_image[CONFIG_IMAGE_WORDS];    // RAM shadow of the stored image, header followed by payload
+static uint32_t g_live[CONFIG_WORDS];           // Values in use, the payload with the journaled words applied
+static uint32_t g_dirty[DIRTY_WORDS];           // Image words that differ from the EEPROM
+static uint32_t g_held[HELD_WORDS];             // Live words changed in RAM only, see config_hold()
+static config_status_t g_status = CONFIG_OK;
+
+static uint32_t g_load_image[CONFIG_WORDS];     // Blob being received by "config data"
+static uint16_t g_load_length = 0;              // Words announced by "config load"
+static uint16_t g_load_received = 0;            // Words received so far
+static uint32_t g_load_crc = 0;                 // CRC announced by "config load"
+static bool g_load_active = false;
+
+// Payload words kept in the journal, indexed by journal key
+static const uint8_t g_journaled[] = { FIX_X, FIX_Y, TC_AVG };
+
+// Values used when the EEPROM is blank or corrupt, and for payload words an older layout did not have
+static const uint32_t g_defaults[CONFIG_WORDS] =
+{
+    0, 0, 0, 0, 0, 0,                           // Sensor coordinates
+    0, 0,                                       // Fix values
+    1,                                          // Averages
+    10000, 100000, 50000, 3,                    // Sensor A beep
+    10000, 100000, 50000, 3,                    // Sensor B beep
+    10000, 100000, 50000, 3,                    // Sensor C beep
+    10000, 100000, 100000, 4,                   // Error beep
+    10000, 100000, 100000, 4,                   // Reset beep
+    10000, 100000, 10000, 2,                    // IR beep
+    1000000,                                    // Speed of sound scale
+    PROFILE_NONE,                               // Active profile
+    0, 0,                                       // Adaptive averaging bounds, off
+    0, 1000,                                    // Walk correction off, 25 us width step
+    0, 0, 0, 0, 0, 0, 0, 0,                     // Sensor A walk offsets
+    0, 0, 0, 0, 0, 0, 0, 0,                     // Sensor B walk offsets
+    0, 0, 0, 0, 0, 0, 0, 0,                     // Sensor C walk offsets
+    0, 0, 0,                                    // Receive chain latencies
+    0x3F800000, 0, 0, 0, 0x3F800000, 0, 0, 0,   // Surface homography, the identity
+    0, 0,                                       // Correction grid off, none stored
+};
+
+// EEPROM word holding each payload word in layout version 1, V1_NONE if it did not exist yet
+static const uint8_t g_v1_offset[CONFIG_WORDS] =
+{
+    0, 1, 2, 3, 4, 5,                           // Sensor coordinates
+    6, 7,                                       // Fix values
+    21,                                         // Averages
+    22, 23, 24, 25,                             // Sensor A beep
+    26, 27, 28, 29,                             // Sensor B beep
+    30, 31, 32, 33,                             // Sensor C beep
+    34, 35, 36, 37,                             // Error beep
+    38, 39, 40, 41,                             // Reset beep
+    42, 43, 44, 45,                             // IR beep
+    V1_NONE,                                    // Speed of sound scale
+    V1_NONE,                                    // Active profile
+    V1_NONE, V1_NONE,                           // Adaptive averaging bounds
+    V1_NONE, V1_NONE,                           // Walk correction mode and width step
+    V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE,
+    V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE,
+    V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE,
+    V1_NONE, V1_NONE, V1_NONE,                  // Receive chain latencies
+    V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE, V1_NONE,
+    V1_NONE, V1_NONE,                           // Correction grid mode and CRC
+};
+
+/**
+*      @brief Function to copy staged words that differ into the live configuration
+*      @param length number of staged words
+**/
+static void config_apply_stage(uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        uint32_t value = readEeprom(STAGE_DATA + i);
+        if (readEeprom(i) != value)     writeEeprom(i, value);
+    }
+}
+
+/**
+*      @brief Function to find the journal key of a payload word
+*      @param offset payload offset
+*      @return uint8_t journal key, JOURNAL_KEYS if the word is not journaled
+**/
+static uint8_t config_journal_key(uint16_t offset)
+{
+    uint8_t key;
+
+    for (key = 0; key < sizeof(g_journaled); key++)
+    {
+        if (g_journaled[key] == offset)     return key;
+    }
+    return JOURNAL_KEYS;
+}
+
+/**
+*      @brief Function to fill the RAM image with a fresh header and default payload
+*               Every word is marked dirty so the next flush writes the complete image
+**/
+static void config_load_defaults(void)
+{
+    uint16_t i;
+
+    g_image[HDR_MAGIC] = CONFIG_MAGIC;
+    g_image[HDR_VERSION] = CONFIG_VERSION;
+    g_image[HDR_LENGTH] = CONFIG_WORDS;
+
+    for (i = 0; i < CONFIG_WORDS; i++)          PAYLOAD[i] = g_defaults[i];
+    for (i = 0; i < CONFIG_IMAGE_WORDS; i++)    MARK_DIRTY(i);
+}
+
+/**
+*      @brief Function to check for layout version 1, i.e. any of its words has been written
+*      @param stored first BOOT_WORDS words of the EEPROM
+*      @return bool true if a version 1 configuration is present
+**/
+static bool config_is_v1(const uint32_t *stored)
+{
+    uint16_t i;
+
+    for (i = 0; i < V1_WORDS; i++)
+    {
+        if (stored[i] != ERASED)    return true;
+    }
+    return false;
+}
+
+/**
+*      @brief Function to check for a versioned header whose magic word alone was damaged
+*               Version 1 never wrote a header, migrating such an image would read header, CRC and packed
+*               payload words as version 1 fields
+*      @param stored first BOOT_WORDS words of the EEPROM
+*      @return bool true if the version and length are those of a layout this firmware writes
+**/
+static bool config_has_header(const uint32_t *stored)
+{
+    return stored[HDR_VERSION] >= 2 && stored[HDR_VERSION] <= CONFIG_VERSION && stored[HDR_LENGTH] <= CONFIG_WORDS;
+}
+
+/**
+*      @brief Function to upgrade a version 1 configuration, words it never wrote keep their defaults
+*      @param stored first BOOT_WORDS words of the EEPROM
+**/
+static void config_migrate_v1(const uint32_t *stored)
+{
+    uint16_t i;
+
+    config_load_defaults();
+    for (i = 0; i < CONFIG_WORDS; i++)
+    {
+        uint32_t value = (g_v1_offset[i] == V1_NONE) ? ERASED : stored[g_v1_offset[i]];
+        if (value != ERASED)    PAYLOAD[i] = value;
+    }
+}
+
+/**
+*      @brief Function to read a versioned image into the RAM shadow
+*      @param stored first BOOT_WORDS words of the EEPROM
+*      @return config_status_t CONFIG_OK, CONFIG_MIGRATED if fields were added since it was written,
+*              or CONFIG_CORRUPT
+**/
+static config_status_t config_read_image(const uint32_t *stored)
+{
+    uint32_t version = stored[HDR_VERSION], length = stored[HDR_LENGTH];
+    uint16_t i;
+
+    if (version > CONFIG_VERSION || length > CONFIG_WORDS)  return CONFIG_CORRUPT;     // Written by newer firmware or damaged
+
+    config_load_defaults();
+    for (i = 0; i < length; i++)    PAYLOAD[i] = stored[CONFIG_HEADER_WORDS + i];
+
+    if (config_crc32(PAYLOAD, (uint16_t)length) != stored[HDR_CRC])   return CONFIG_CORRUPT;
+
+    if (version == CONFIG_VERSION && length == CONFIG_WORDS)
+    {
+        g_image[HDR_CRC] = stored[HDR_CRC];
+        for (i = 0; i < DIRTY_WORDS; i++)   g_dirty[i] = 0;                 // RAM matches the EEPROM
+        return CONFIG_OK;
+    }
+
+    return CONFIG_MIGRATED;                                                 // Shorter payload, new fields keep their defaults
+}
+
+/**
+*      @brief Function to finish any interrupted commit and load the RAM shadow
+*               Older layouts are upgraded in place, a blank or corrupt EEPROM leaves the defaults in RAM
+*               until the configuration is next changed
+**/
+void config_init(void)
+{
+    uint32_t stored[BOOT_WORDS];
+    uint16_t i;
+
+    if (readEeprom(STAGE_MARKER) == STAGE_PENDING)                          // Power was lost while applying a commit
+    {
+        uint32_t length = readEeprom(STAGE_LENGTH);
+        if (length > STAGE_CAPACITY)    length = STAGE_CAPACITY;
+
+        config_apply_stage((uint16_t)length);                               // Replay it to completion
+        writeEeprom(STAGE_MARKER, STAGE_IDLE);
+    }
+
+    readEepromBlock(0, stored, BOOT_WORDS);                                 // Every layout in one streamed read
+
+    if (stored[HDR_MAGIC] == CONFIG_MAGIC)
+    {
+        g_status = config_read_image(stored);
+    }
+    else if (config_has_header(stored))
+    {
+        g_status = CONFIG_CORRUPT;                                          // Versioned image, not version 1
+    }
+    else if (config_is_v1(stored))
+    {
+        config_migrate_v1(stored);
+        g_status = CONFIG_MIGRATED;
+    }
+    else
+    {
+        g_status = CONFIG_BLANK;
+    }
+
+    switch (g_status)
+    {
+        case CONFIG_MIGRATED:   config_flush();         break;              // Store the upgraded image
+        case CONFIG_CORRUPT:
+        case CONFIG_BLANK:      config_load_defaults(); break;
+        default:                                        break;
+    }
+
+    journal_init();
+    for (i = 0; i < CONFIG_WORDS; i++)
+    {
+        uint32_t value;
+        uint8_t key = config_journal_key(i);
+
+        g_live[i] = (key < JOURNAL_KEYS && journal_read(key, &value)) ? value : PAYLOAD[i];
+    }
+}
+
+/**
+*      @brief Function to report what config_init found in the EEPROM
+*      @return config_status_t
+**/
+config_status_t config_status(void)
+{
+    return g_status;
+}
+
+/**
+*      @brief Function to read a configuration word from the RAM shadow
+*      @param offset payload offset from eeprom_memory_map.h
+*      @return uint32_t value
+**/
+uint32_t config_get(uint16_t offset)
+{
+    return (offset < CONFIG_WORDS) ? g_live[offset] : 0;
+}
+
+/**
+*      @brief Function to update a configuration word in the RAM shadow, nothing is written until config_flush()
+*               Journaled words are appended to the journal straight away
+*      @param offset payload offset from eeprom_memory_map.h
+*      @param value new value
+**/
+void config_set(uint16_t offset, uint32_t value)
+{
+    uint8_t key;
+
+    if (offset >= CONFIG_WORDS || (g_live[offset] == value && !IS_HELD(offset)))     return;
+
+    g_live[offset] = value;
+    CLEAR_HELD(offset);
+
+    key = config_journal_key(offset);
+    if (key < JOURNAL_KEYS)
+    {
+        journal_write(key, value);
+        return;
+    }
+
+    PAYLOAD[offset] = value;
+    MARK_DIRTY(CONFIG_HEADER_WORDS + offset);
+}
+
+/**
+*      @brief Function to change a configuration word in RAM only, nothing is written
+*      @param offset payload offset from eeprom_memory_map.h
+*      @param value value in use until the word is reverted, stored or the next reset
+**/
+void config_hold(uint16_t offset, uint32_t value)
+{
+    if (offset >= CONFIG_WORDS)     return;
+
+    g_live[offset] = value;
+    MARK_HELD(offset);
+}
+
+/**
+*      @brief Function to go back to the stored value of a word changed by config_hold()
+*      @param offset payload offset from eeprom_memory_map.h
+**/
+void config_revert(uint16_t offset)
+{
+    uint32_t value;
+    uint8_t key;
+
+    if (offset >= CONFIG_WORDS || !IS_HELD(offset))     return;
+
+    key = config_journal_key(offset);
+    g_live[offset] = (key < JOURNAL_KEYS && journal_read(key, &value)) ? value : PAYLOAD[offset];
+    CLEAR_HELD(offset);
+}
+
+/**
+*      @brief Function to store every word changed by config_hold()
+*      @return uint16_t number of live words written
+**/
+uint16_t config_keep(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < CONFIG_WORDS; i++)
+    {
+        if (IS_HELD(i))     config_set(i, g_live[i]);
+    }
+    return config_flush();
+}
+
+/**
+*      @brief Function to write the dirty words atomically
+*               1. The CRC is updated and the staging area brought in line with the RAM image
+*               2. The staging marker is set, from here on a reset replays the staged image
+*               3. Dirty words are written to the live image
+*               4. The staging marker is cleared
+*      @return uint16_t number of live words written
+**/
+uint16_t config_flush(void)
+{
+    uint32_t crc = config_crc32(PAYLOAD, CONFIG_WORDS), staged[CONFIG_IMAGE_WORDS];
+    uint16_t i, run, written = 0;
+    bool dirty = false;
+
+    if (g_image[HDR_CRC] != crc)
+    {
+        g_image[HDR_CRC] = crc;
+        MARK_DIRTY(HDR_CRC);
+    }
+
+    for (i = 0; i < DIRTY_WORDS; i++)   dirty |= (g_dirty[i] != 0);
+    if (!dirty)     return 0;
+
+    readEepromBlock(STAGE_DATA, staged, CONFIG_IMAGE_WORDS);
+    for (i = 0; i < CONFIG_IMAGE_WORDS; i++)                                // Stage
+    {
+        if (staged[i] != g_image[i])    writeEeprom(STAGE_DATA + i, g_image[i]);
+    }
+    if (readEeprom(STAGE_LENGTH) != CONFIG_IMAGE_WORDS)  writeEeprom(STAGE_LENGTH, CONFIG_IMAGE_WORDS);
+
+    writeEeprom(STAGE_MARKER, STAGE_PENDING);                               // Commit point
+
+    for (i = 0; i < CONFIG_IMAGE_WORDS; i += run)                           // Apply, consecutive dirty words in one stream
+    {
+        for (run = 0; i + run < CONFIG_IMAGE_WORDS && IS_DIRTY(i + run); run++);
+
+        if (run == 0)
+        {
+            run = 1;
+            continue;
+        }
+
+        writeEepromBlock(i, &g_image[i], run);
+        written += run;
+    }
+    for (i = 0; i < DIRTY_WORDS; i++)   g_dirty[i] = 0;
+
+    writeEeprom(STAGE_MARKER, STAGE_IDLE);
+    return written;
+}
+
+/**
+*      @brief Function to replace the configuration payload atomically
+*      @param image new payload words
+*      @param length number of words, at most CONFIG_WORDS
+*      @return uint16_t number of image words written, including the header
+**/
+uint16_t config_commit(const uint32_t *image, uint16_t length)
+{
+    uint16_t i;
+
+    if (length > CONFIG_WORDS)  length = CONFIG_WORDS;
+
+    for (i = 0; i < length; i++)    config_set(i, image[i]);
+    return config_flush();
+}
+
+/**
+*      @brief Function to calculate the CRC-32 (IEEE 802.3) of words taken as little endian bytes
+*      @param words data
+*      @param length number of words
+*      @return uint32_t CRC
+**/
+uint32_t config_crc32(const uint32_t *words, uint16_t length)
+{
+    static const uint32_t nibble_table[16] =
+    {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+    uint16_t i;
+    uint8_t byte;
+
+    for (i = 0; i < length; i++)
+    {
+        for (byte = 0; byte < 4; byte++)
+        {
+            crc ^= (words[i] >> (byte * 8)) & 0xFF;
+            crc = (crc >> 4) ^ nibble_table[crc & 0xF];
+            crc = (crc >> 4) ^ nibble_table[crc & 0xF];
+        }
+    }
+    return ~crc;
+}
+
+/**
+*      @brief Function to start receiving a configuration blob
+*      @param length number of words that will follow, at most CONFIG_WORDS, fewer for a dump taken
+*               from firmware with an older layout
+*      @param crc CRC-32 of the words
+**/
+void config_load_begin(uint32_t length, uint32_t crc)
+{
+    if (length == 0 || length > CONFIG_WORDS)
+    {
+        format_string(putcUart0, "ERROR! Configuration must be 1 to ");
+        format_uint(putcUart0, CONFIG_WORDS);
+        format_string(putcUart0, " words\r\n\r\n");
+        g_load_active = false;
+        return;
+    }
+
+    g_load_length = (uint16_t)length;
+    g_load_received = 0;
+    g_load_crc = crc;
+    g_load_active = true;
+}
+
+/**
+*      @brief Function to append words to the blob being received, commits once the blob is complete
+*      @param words values from one "config data" line
+*      @param count number of values
+**/
+void config_load_data(const int32_t *words, uint8_t count)
+{
+    uint16_t i;
+
+    if (!g_load_active)
+    {
+        format_string(putcUart0, "ERROR! No configuration load in progress\r\n\r\n");
+        return;
+    }
+
+    if (g_load_received + count > g_load_length)
+    {
+        format_string(putcUart0, "ERROR! Configuration longer than announced, load aborted\r\n\r\n");
+        g_load_active = false;
+        return;
+    }
+
+    for (i = 0; i < count; i++)     g_load_image[g_load_received++] = (uint32_t)words[i];
+
+    if (g_load_received < g_load_length)    return;                        // Wait for the rest
+
+    g_load_active = false;
+
+    if (config_crc32(g_load_image, g_load_length) != g_load_crc)
+    {
+        format_string(putcUart0, "ERROR! Configuration CRC mismatch, nothing written\r\n\r\n");
+        return;
+    }
+
+    for (i = g_load_length; i < CONFIG_WORDS; i++)  g_load_image[i] = g_defaults[i];   // Older layout, new fields keep
+                                                                                        // their defaults as at boot
+    format_string(putcUart0, "Configuration committed, ");
+    format_uint(putcUart0, config_commit(g_load_image, CONFIG_WORDS));
+    format_string(putcUart0, (g_load_length < CONFIG_WORDS) ? " words written, upgraded to the current layout\r\n\r\n"
+                                                            : " words written\r\n\r\n");
+}
+
+/**
+*      @brief Function to cancel a configuration load in progress
+**/
+void config_load_abort(void)
+{
+    g_load_active = false;
+    format_string(putcUart0, "Configuration load aborted\r\n\r\n");
+}
+
+/**
+*      @brief Function to print the current configuration as a "config load" script
+**/
+void config_dump(void)
+{
+    uint16_t i;
+
+    format_string(putcUart0, "config load ");
+    format_uint(putcUart0, CONFIG_WORDS);
+    putcUart0(' ');
+    format_hex(putcUart0, config_crc32(g_live, CONFIG_WORDS), 8);
+
+    for (i = 0; i < CONFIG_WORDS; i++)
+    {
+        if (i % CONFIG_LINE_WORDS == 0)     format_string(putcUart0, "\r\nconfig data");
+        putcUart0(' ');
+        format_hex(putcUart0, g_live[i], 8);
+    }
+    format_string(putcUart0, "\r\n\r\n");
+}
+
+#if defined(BENCH) || defined(BENCH_HOST)
+/**
+*      @brief Function to copy the RAM shadow, including words changed by config_hold() and not yet flushed
+*      @param state copy to fill
+**/
+void config_save_state(config_state_t *state)
+{
+    uint16_t i;
+
+    for (i = 0; i < CONFIG_IMAGE_WORDS; i++)    state->image[i] = g_image[i];
+    for (i = 0; i < CONFIG_WORDS; i++)          state->live[i] = g_live[i];
+    for (i = 0; i < DIRTY_WORDS; i++)           state->dirty[i] = g_dirty[i];
+    for (i = 0; i < HELD_WORDS; i++)            state->held[i] = g_held[i];
+    state->status = g_status;
+}
+
+/**
+*      @brief Function to put back a RAM shadow copied by config_save_state()
+*               The EEPROM and journal are not touched, the copy must be from the same boot
+*      @param state copy to restore
+**/
+void config_restore_state(const config_state_t *state)
+{
+    uint16_t i;
+
+    for (i = 0; i < CONFIG_IMAGE_WORDS; i++)    g_image[i] = state->image[i];
+    for (i = 0; i < CONFIG_WORDS; i++)          g_live[i] = state->live[i];
+    for (i = 0; i < DIRTY_WORDS; i++)           g_dirty[i] = state->dirty[i];
+    for (i = 0; i < HELD_WORDS; i++)            g_held[i] = state->held[i];
+    g_status = state->status;
+}
+#endif
@@ -0,0 +1,63 @@
+/**
+*      @file config.h
+*      @author Prithvi Bhat
+*      @brief Versioned RAM shadow of the EEPROM configuration with transactional bulk upload
+**/
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+#include "eeprom_memory_map.h"
+
+#define CONFIG_LINE_WORDS   6           // Words per "config data" line, keeps dumped lines within MAX_STRING_LENGTH
+#define PROFILE_NONE        0xFFFFFFFF  // PROFILE_ACTIVE before any profile has been selected
+
+/**
+*      @brief What config_init found in the EEPROM
+**/
+typedef enum
+{
+    CONFIG_OK,                          // Current layout, CRC valid
+    CONFIG_MIGRATED,                    // Older layout, upgraded in place
+    CONFIG_BLANK,                       // Never written, defaults in use
+    CONFIG_CORRUPT,                     // CRC or header invalid, defaults in use
+} config_status_t;
+
+#if defined(BENCH) || defined(BENCH_HOST)
+/**
+*      @brief Copy of the RAM shadow, lets the benchmarks run config_init() on a live system and put it back
+**/
+typedef struct
+{
+    uint32_t image[CONFIG_IMAGE_WORDS];
+    uint32_t live[CONFIG_WORDS];
+    uint32_t dirty[(CONFIG_IMAGE_WORDS + 31) / 32];
+    uint32_t held[(CONFIG_WORDS + 31) / 32];
+    config_status_t status;
+} config_state_t;
+#endif
+
+// Function prototypes
+void config_init(void);
+config_status_t config_status(void);
+uint32_t config_get(uint16_t offset);
+void config_set(uint16_t offset, uint32_t value);
+void config_hold(uint16_t offset, uint32_t value);
+void config_revert(uint16_t offset);
+uint16_t config_keep(void);
+uint16_t config_flush(void);
+uint16_t config_commit(const uint32_t *image, uint16_t length);
+uint32_t config_crc32(const uint32_t *words, uint16_t length);
+
+void config_load_begin(uint32_t length, uint32_t crc);
+void config_load_data(const int32_t *words, uint8_t count);
+void config_load_abort(void);
+void config_dump(void);
+
+#if defined(BENCH) || defined(BENCH_HOST)
+void config_save_state(config_state_t *state);
+void config_restore_state(const config_state_t *state);
+#endif
+
+#endif
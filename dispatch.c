@@ -0,0 +1,140 @@
+/**
+*      @file dispatch.c
+*      @author Prithvi Bhat
+*      @brief Table driven dispatcher for terminal commands
+*               * Commands are looked up by binary search over a registry sorted by name
+*               * Argument count and types are validated against the command's schema
+*               * Arguments are converted once into a command_args_t before the handler runs
+**/
+
+#include <string.h>
+#include "uart0.h"
+#include "dispatch.h"
+
+/**
+*      @brief Function to verify a registry is sorted by name, which the lookup relies on
+*      @param table command registry
+*      @param size number of entries
+*      @return true if sorted with no duplicate names
+**/
+bool dispatch_check(const command_t *table, uint8_t size)
+{
+    uint8_t i;
+
+    for (i = 1; i < size; i++)
+    {
+        if (strcmp(table[i - 1].name, table[i].name) >= 0)
+        {
+            putsUart0("ERROR! Command table out of order at \"");
+            putsUart0((char *)table[i].name);
+            putsUart0("\"\r\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+*      @brief Function to look up a command by name
+*      @param table command registry sorted by name
+*      @param size number of entries
+*      @param name command keyword
+*      @return const command_t* matching entry or NULL
+**/
+const command_t *dispatch_find(const command_t *table, uint8_t size, const char *name)
+{
+    int16_t low = 0, high = (int16_t)size - 1;
+
+    while (low <= high)
+    {
+        int16_t middle = (low + high) / 2;
+        int compare = strcmp(name, table[middle].name);
+
+        if (compare == 0)       return &table[middle];
+        else if (compare < 0)   high = middle - 1;
+        else                    low = middle + 1;
+    }
+    return NULL;
+}
+
+/**
+*      @brief Function to convert the fields of a parsed line according to a command's schema
+*      @param command registry entry
+*      @param user_data parsed user input
+*      @param args destination for converted arguments
+*      @return true if count and types match the schema
+**/
+static bool dispatch_convert(const command_t *command, string_data_t *user_data, command_args_t *args)
+{
+    uint8_t i;
+
+    args->count = user_data->count - 1;
+    if (args->count < command->min_args || args->count > command->max_args)     return false;
+
+    for (i = 0; i < args->count; i++)
+    {
+        uint8_t field = i + 1;
+
+        switch (command->arg_types[i])
+        {
+            case 'i':
+            {
+                if (user_data->type[field] != 'n')  return false;
+                args->integer[i] = getFieldInteger(user_data, field);
+                break;
+            }
+
+            case 'd':
+            {
+                if (user_data->type[field] != 'n' && user_data->type[field] != 'd')     return false;
+                args->integer[i] = getFieldDecimal(user_data, field);
+                break;
+            }
+
+            case 's':
+            {
+                if (user_data->type[field] != 'a')  return false;
+                args->string[i] = getFieldString(user_data, field);
+                break;
+            }
+
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+*      @brief Function to find, validate and execute the command held in a parsed line
+*      @param table command registry sorted by name
+*      @param size number of entries
+*      @param user_data parsed user input
+*      @return true if a handler was executed
+**/
+bool dispatch_command(const command_t *table, uint8_t size, string_data_t *user_data)
+{
+    const command_t *command;
+    command_args_t args;
+
+    if (user_data->count == 0)          return false;                          // Empty line
+
+    command = dispatch_find(table, size, getFieldString(user_data, 0));
+
+    if (command == NULL)
+    {
+        putsUart0("ERROR! Invalid command\r\n\r\n");
+        return false;
+    }
+
+    if (!dispatch_convert(command, user_data, &args))
+    {
+        putsUart0("ERROR! Usage: ");
+        putsUart0((char *)command->usage);
+        putsUart0("\r\n\r\n");
+        return false;
+    }
+
+    command->handler(&args);
+    return true;
+}
@@ -0,0 +1,46 @@
+/**
+*      @file dispatch.h
+*      @author Prithvi Bhat
+*      @brief Table driven dispatcher for terminal commands
+**/
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+#include "strings.h"
+
+#define MAX_ARGUMENTS       (MAX_FIELDS - 1)    // Command name occupies field 0
+
+/**
+*      @brief Arguments of one command, converted once according to the command's schema
+**/
+typedef struct
+{
+    uint8_t count;                              // Number of arguments supplied (command name excluded)
+    int32_t integer[MAX_ARGUMENTS];             // Value of argument n when schema type is 'i', fixed point for 'd'
+    char *string[MAX_ARGUMENTS];                // Value of argument n when schema type is 's'
+} command_args_t;
+
+typedef void (*command_handler_t)(const command_args_t *args);
+
+/**
+*      @brief One entry of a command registry
+*               Registries must be sorted by name, lookup is a binary search
+**/
+typedef struct
+{
+    const char *name;                           // Command keyword
+    uint8_t min_args;                           // Minimum number of arguments
+    uint8_t max_args;                           // Maximum number of arguments
+    const char *arg_types;                      // One character per argument: 'i' integer, 'd' decimal, 's' string
+    const char *usage;                          // Printed when arguments do not match the schema
+    command_handler_t handler;                  // Function executing the command
+} command_t;
+
+// Function prototypes
+bool dispatch_check(const command_t *table, uint8_t size);
+const command_t *dispatch_find(const command_t *table, uint8_t size, const char *name);
+bool dispatch_command(const command_t *table, uint8_t size, string_data_t *user_data);
+
+#endif
@@ -13,9 +13,16 @@
 //-----------------------------------------------------------------------------
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "tm4c123gh6pm.h"
 #include "eeprom.h"
 
+#ifdef BENCH
+// Cleared by bench.c to time the boot with the word by word reads the block
+// calls replaced
+bool g_eeprom_stream = true;
+#endif
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -41,3 +48,43 @@ uint32_t readEeprom(uint16_t add)
     EEPROM_EEOFFSET_R = add & 0xF;
     return EEPROM_EERDWR_R;
 }
+
+// Streams count words from add on through the auto-increment register.
+// EERDWRINC only advances the offset within a block, so the next block
+// is selected whenever the address crosses a 16-word boundary.
+void readEepromBlock(uint16_t add, uint32_t data[], uint16_t count)
+{
+    uint16_t i;
+#ifdef BENCH
+    if (!g_eeprom_stream)
+    {
+        for (i = 0; i < count; i++)
+            data[i] = readEeprom(add + i);
+        return;
+    }
+#endif
+    for (i = 0; i < count; i++, add++)
+    {
+        if (i == 0 || (add & 0xF) == 0)
+        {
+            EEPROM_EEBLOCK_R = add >> 4;
+            EEPROM_EEOFFSET_R = add & 0xF;
+        }
+        data[i] = EEPROM_EERDWRINC_R;
+    }
+}
+
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint16_t count)
+{
+    uint16_t i;
+    for (i = 0; i < count; i++, add++)
+    {
+        if (i == 0 || (add & 0xF) == 0)
+        {
+            EEPROM_EEBLOCK_R = add >> 4;
+            EEPROM_EEOFFSET_R = add & 0xF;
+        }
+        EEPROM_EERDWRINC_R = data[i];
+        while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+    }
+}
@@ -19,5 +19,7 @@
 void initEeprom(void);
 void writeEeprom(uint16_t add, uint32_t data);
 uint32_t readEeprom(uint16_t add);
+void readEepromBlock(uint16_t add, uint32_t data[], uint16_t count);
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint16_t count);
 
 #endif
@@ -2,69 +2,162 @@
 *      @file eeprom_memory_map.h
 *      @author Prithvi Bhat
 *      @brief Maps various EEPROM regions
+*               The EEPROM holds 512 32-bit words in 32 blocks of 16 words.
+*               Addresses are word addresses as taken by readEeprom()/writeEeprom().
+*
+*                   |-----------|------------------------------------------------|
+*                   | Words     | Region                                         |
+*                   |-----------|------------------------------------------------|
+*                   | 0 - 3     | Configuration header                           |
+*                   | 4 - 127   | Configuration payload (CONFIG_WORDS used)      |
+*                   | 128 - 255 | Staging area for atomic configuration commits  |
+*                   | 256 - 319 | Journal of frequently rewritten parameters     |
+*                   | 320 - 383 | Calibration profiles, one block each           |
+*                   | 384 - 511 | Spatial correction grid                        |
+*                   |-----------|------------------------------------------------|
+*
+*               Layout versions
+*                   1   No header, payload words at their original offsets 0 to 45
+*                   2   Header, payload packed from word 4
+*                   3   Adds SOS_SCALE and PROFILE_ACTIVE
+*                   4   Adds AVG_MIN and AVG_MAX
+*                   5   Adds the comparator walk correction
+*                   6   Adds LAT_A, LAT_B and LAT_C
+*                   7   Adds the surface homography SURF_H
+*                   8   Adds GRID_MODE and GRID_CRC
 *      @date 2022-11-18
 **/
 #ifndef EEPROM_MAP_H
 #define EEPROM_MAP_H
 
-#define BLOCK_SIZE  32
+#define EEPROM_WORDS        512
+#define EEPROM_BLOCK_WORDS  16
 
-// Coordinates
+// Configuration header, EEPROM words 0 to 3
+#define HDR_MAGIC           0   // CONFIG_MAGIC once a versioned layout has been written
+#define HDR_VERSION         1   // Layout version of the payload
+#define HDR_LENGTH          2   // Number of payload words stored
+#define HDR_CRC             3   // CRC-32 of the stored payload words
+#define CONFIG_HEADER_WORDS 4
+
+#define CONFIG_MAGIC        0x55504E43  // "UPNC"
+#define CONFIG_VERSION      8
+
+// Configuration payload, offsets from the first payload word as taken by config_get()/config_set()
+// Coordinates in mm
 // Sensor A
-#define CRD_AX      0   // 0x00
-#define CRD_AY      1   // 0x32
+#define CRD_AX      0
+#define CRD_AY      1
 
 // Sensor B
-#define CRD_BX      2   // 0x64
-#define CRD_BY      3   // 0x96
+#define CRD_BX      2
+#define CRD_BY      3
 
 // Sensor C
-#define CRD_CX      4   // 0x128
-#define CRD_CY      5   // 0x160
+#define CRD_CX      4
+#define CRD_CY      5
 
-// Fix Values
-// Sensor A
-#define FIX_X       6   // 0x192
-#define FIX_Y       7   // 0x224
+// Fix values in mm, signed
+#define FIX_X       6
+#define FIX_Y       7
 
 // Average /  Max samples
-#define TC_AVG      21  // 0x672
+#define TC_AVG      8
 
 // Beep Values
 // Sensor A
-#define LOAD_A      22  // 0x704
-#define PER1_A      23  // 0x736
-#define PER2_A      24  // 0x768
-#define CONT_A      25  // 0x800
+#define LOAD_A      9
+#define PER1_A      10
+#define PER2_A      11
+#define CONT_A      12
 
 // Sensor B
-#define LOAD_B      26  // 0x832
-#define PER1_B      27  // 0x864
-#define PER2_B      28  // 0x896
-#define CONT_B      29  // 0x928
+#define LOAD_B      13
+#define PER1_B      14
+#define PER2_B      15
+#define CONT_B      16
 
 // Sensor C
-#define LOAD_C      30  // 0x960
-#define PER1_C      31  // 0x992
-#define PER2_C      32  // 0x1024
-#define CONT_C      33  // 0x1056
+#define LOAD_C      17
+#define PER1_C      18
+#define PER2_C      19
+#define CONT_C      20
 
 // Watchdog timeout / Error
-#define LOAD_ERR    34  // 0x1088
-#define PER1_ERR    35  // 0x1120
-#define PER2_ERR    36  // 0x1152
-#define CONT_ERR    37  // 0x1184
+#define LOAD_ERR    21
+#define PER1_ERR    22
+#define PER2_ERR    23
+#define CONT_ERR    24
 
 // Reset
-#define LOAD_RST    38  // 0x1216
-#define PER1_RST    39  // 0x1248
-#define PER2_RST    40  // 0x1280
-#define CONT_RST    41  // 0x1312
+#define LOAD_RST    25
+#define PER1_RST    26
+#define PER2_RST    27
+#define CONT_RST    28
 
 // IR interrupt
-#define LOAD_IR     42  // 0x1344
-#define PER1_IR     43  // 0x1376
-#define PER2_IR     44  // 0x1408
-#define CONT_IR     45  // 0x1440
+#define LOAD_IR     29
+#define PER1_IR     30
+#define PER2_IR     31
+#define CONT_IR     32
+
+// Speed of sound relative to 343 m/s, in millionths
+#define SOS_SCALE   33
+
+// Calibration profile last selected, PROFILE_NONE if none
+#define PROFILE_ACTIVE  34
+
+// Bounds of the adaptive averaging depth, TC_AVG is used while AVG_MAX is not above AVG_MIN
+#define AVG_MIN     35
+#define AVG_MAX     36
+
+// Comparator walk correction, see walk.c
+#define WALK_MODE   37  // 1 to capture both pulse edges and correct arrivals by pulse width
+#define WALK_BIN    38  // Pulse width step of the tables in timer ticks
+#define WALK_A      39  // Signed arrival offsets in timer ticks, WALK_BINS per sensor
+#define WALK_B      47
+#define WALK_C      55
+
+// Fixed delay of each sensor's receive chain in timer ticks, signed
+#define LAT_A       63
+#define LAT_B       64
+#define LAT_C       65
+
+// Homography onto the writing surface, see surface.c
+#define SURF_H      66  // SURFACE_TERMS single precision bit patterns, row major h11 to h32
+
+// Spatial correction grid, see grid.c
+#define GRID_MODE   74  // 1 to correct fixes with the grid
+#define GRID_CRC    75  // CRC-32 of the grid words, 0 if no grid is stored
+
+// Configuration shadowed in RAM, payload offsets 0 to GRID_CRC
+#define CONFIG_WORDS        76
+#define CONFIG_IMAGE_WORDS  (CONFIG_HEADER_WORDS + CONFIG_WORDS)
+
+// Layout version 1 stored the payload without header, TC_AVG and the beep values started at word 21
+#define V1_WORDS            46
+
+// Staging area for atomic configuration commits (blocks 8 to 15)
+#define STAGE_MARKER        128 // Holds STAGE_PENDING while a staged image is being applied
+#define STAGE_LENGTH        129 // Number of staged words
+#define STAGE_DATA          144 // First staged word, block 9, mirrors EEPROM words from 0
+#define STAGE_CAPACITY      112 // Words available up to the end of block 15
+
+// Wear leveled journal (blocks 16 to 19), see journal.c
+#define JOURNAL_BASE            256
+#define JOURNAL_WORDS           64
+#define JOURNAL_SEGMENT_WORDS   EEPROM_BLOCK_WORDS
+
+// Calibration profiles (blocks 20 to 23), see profile.c
+#define PROFILE_BASE            320
+#define PROFILE_COUNT           4
+#define PROFILE_NAME            0   // 8 characters in 2 words
+#define PROFILE_DATA            2   // Profile fields in the order of profile.c
+#define PROFILE_CRC             12  // CRC-32 of words 0 to 11, an erased block fails it
+#define PROFILE_SURFACE         13  // surface_tag() of the mapping saved with the profile
+#define PROFILE_GRID            14  // GRID_CRC of the grid saved with the profile
+
+// Spatial correction grid (blocks 24 to 31), GRID_WORDS packed nodes, see grid.h
+#define GRID_BASE               384
 
 #endif
@@ -0,0 +1,146 @@
+/**
+*      @file format.c
+*      @author Prithvi Bhat
+*      @brief Allocation free number formatting written character by character to a sink
+*               * Digits are produced most significant first by dividing with powers of ten,
+*                 so no intermediate string or reversal is needed
+*               * Fixed point values carry their scale as a number of decimals, e.g. 12345 with
+*                 2 decimals prints as 123.45
+**/
+
+#include "format.h"
+
+static const uint32_t g_powers_of_ten[] =
+{
+    1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1
+};
+
+static char *g_format_buffer;                           // Destination of format_buffer_put
+static uint8_t g_format_buffer_free;                    // Characters left, one is kept for '\0'
+
+/**
+*      @brief Function to write a string to a sink
+*      @param put character sink
+*      @param string NULL terminated string
+**/
+void format_string(format_put_t put, const char *string)
+{
+    while (*string != '\0')     put(*string++);
+}
+
+/**
+*      @brief Function to write an unsigned integer with at least min_digits digits
+**/
+static void format_digits(format_put_t put, uint32_t value, uint8_t min_digits)
+{
+    uint8_t i = 0, first = sizeof(g_powers_of_ten) / sizeof(g_powers_of_ten[0]) - min_digits;
+
+    while (i < first && value < g_powers_of_ten[i])     i++;           // Skip leading zeros
+
+    for (; i < sizeof(g_powers_of_ten) / sizeof(g_powers_of_ten[0]); i++)
+    {
+        uint32_t digit = value / g_powers_of_ten[i];
+        value -= digit * g_powers_of_ten[i];
+        put('0' + digit);
+    }
+}
+
+/**
+*      @brief Function to write an unsigned decimal integer
+*      @param put character sink
+*      @param value to write
+**/
+void format_uint(format_put_t put, uint32_t value)
+{
+    format_digits(put, value, 1);
+}
+
+/**
+*      @brief Function to write a signed decimal integer
+*      @param put character sink
+*      @param value to write
+**/
+void format_int(format_put_t put, int32_t value)
+{
+    uint32_t magnitude = (uint32_t)value;
+
+    if (value < 0)
+    {
+        put('-');
+        magnitude = 0u - magnitude;                     // Well defined for INT32_MIN
+    }
+    format_digits(put, magnitude, 1);
+}
+
+/**
+*      @brief Function to write a signed fixed point value
+*      @param put character sink
+*      @param value scaled by 10^decimals, e.g. micrometres with 3 decimals prints millimetres
+*      @param decimals number of digits after the decimal point (0 to 9)
+**/
+void format_fixed(format_put_t put, int32_t value, uint8_t decimals)
+{
+    uint32_t magnitude = (uint32_t)value, scale, whole;
+
+    if (decimals == 0 || decimals > 9)
+    {
+        format_int(put, value);
+        return;
+    }
+
+    if (value < 0)
+    {
+        put('-');
+        magnitude = 0u - magnitude;
+    }
+
+    scale = g_powers_of_ten[sizeof(g_powers_of_ten) / sizeof(g_powers_of_ten[0]) - 1 - decimals];
+    whole = magnitude / scale;
+
+    format_digits(put, whole, 1);
+    put('.');
+    format_digits(put, magnitude - whole * scale, decimals);
+}
+
+/**
+*      @brief Function to write a hexadecimal value with 0x prefix
+*      @param put character sink
+*      @param value to write
+*      @param digits number of hex digits (1 to 8)
+**/
+void format_hex(format_put_t put, uint32_t value, uint8_t digits)
+{
+    int8_t shift;
+
+    put('0');
+    put('x');
+    for (shift = (int8_t)((digits - 1) * 4); shift >= 0; shift -= 4)
+    {
+        uint8_t nibble = (value >> shift) & 0xF;
+        put(nibble < 10 ? '0' + nibble : 'A' + nibble - 10);
+    }
+}
+
+/**
+*      @brief Function to direct format_buffer_put at a character array
+*      @param buffer destination, always left NULL terminated
+*      @param size size of buffer in bytes
+**/
+void format_buffer_begin(char *buffer, uint8_t size)
+{
+    g_format_buffer = buffer;
+    g_format_buffer_free = size - 1;
+    *g_format_buffer = '\0';
+}
+
+/**
+*      @brief Sink appending to the buffer given to format_buffer_begin, excess characters are dropped
+**/
+void format_buffer_put(char c)
+{
+    if (g_format_buffer_free == 0)  return;
+
+    *g_format_buffer++ = c;
+    *g_format_buffer = '\0';
+    g_format_buffer_free--;
+}
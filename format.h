@@ -0,0 +1,27 @@
+/**
+*      @file format.h
+*      @author Prithvi Bhat
+*      @brief Allocation free number formatting written character by character to a sink
+**/
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+/**
+*      @brief Character sink, e.g. putcUart0 to write straight into the UART transmit FIFO
+**/
+typedef void (*format_put_t)(char c);
+
+// Function prototypes
+void format_string(format_put_t put, const char *string);
+void format_uint(format_put_t put, uint32_t value);
+void format_int(format_put_t put, int32_t value);
+void format_fixed(format_put_t put, int32_t value, uint8_t decimals);
+void format_hex(format_put_t put, uint32_t value, uint8_t digits);
+
+void format_buffer_begin(char *buffer, uint8_t size);
+void format_buffer_put(char c);
+
+#endif
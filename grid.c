@@ -0,0 +1,208 @@
+/**
+*      @file grid.c
+*      @author Prithvi Bhat
+*      @brief Spatial correction grid applied to every fix
+*               * Multipath and the beam patterns of the transducers leave a smooth, position dependent bias
+*                 after the geometry is calibrated. GRID_SIZE x GRID_SIZE nodes spread evenly over the writing
+*                 area, 0 to D2 along x and 0 to D1 along y after the fix offsets, each hold the x and y
+*                 correction there as a signed byte in 1/8 mm
+*               * A fix is corrected by the bilinear interpolation of the four nodes around it, in fixed
+*                 point: the position in 1/256 of a cell comes from one multiply by a step worked out when
+*                 the area changes, and the weights are whole numbers
+*               * The nodes fill EEPROM blocks 24 to 31 and are cached in RAM. GRID_CRC in the configuration
+*                 holds their CRC, an erased or half written grid does not match it and is not used
+*               * The grid is built on the host from recorded taps, see host/grid_builder.c, and uploaded
+*                 with "grid load <crc32>" followed by "grid data" lines, committed once complete
+**/
+
+#include "grid.h"
+#include "config.h"
+#include "eeprom.h"
+#include "format.h"
+#include "uart0.h"
+
+#define CELL_SHIFT          8                   // Positions in 1/256 cell
+#define CELL_ONE            (1 << CELL_SHIFT)
+#define POSITION_FRACTION   4                   // Fixes taken in 1/16 mm
+#define STEP_SHIFT          16                  // Cells per mm in 1/65536
+#define POSITION_LIMIT      (((GRID_SIZE - 1) << CELL_SHIFT) - 1)
+
+// Global Variables
+static uint32_t g_words[GRID_WORDS];            // Packed nodes, a copy of EEPROM words GRID_BASE on
+static int32_t g_step_x = 0, g_step_y = 0;      // Cells per mm in 1/65536
+static float g_width = 0, g_height = 0;
+static bool g_valid = false;                    // g_words match GRID_CRC
+static bool g_upload_active = false;
+static uint8_t g_upload_received = 0;
+static uint32_t g_upload_crc = 0;
+
+/**
+*      @brief Function to read the grid and fit it to the writing area, call after the configuration changes
+*      @param width_mm, height_mm extent of the writing area along x and y
+**/
+void grid_load(int32_t width_mm, int32_t height_mm)
+{
+    readEepromBlock(GRID_BASE, g_words, GRID_WORDS);
+    g_valid = (config_get(GRID_CRC) != 0 && config_crc32(g_words, GRID_WORDS) == config_get(GRID_CRC));
+
+    g_width = (float)width_mm;
+    g_height = (float)height_mm;
+    g_step_x = ((GRID_SIZE - 1) << STEP_SHIFT) / width_mm;
+    g_step_y = ((GRID_SIZE - 1) << STEP_SHIFT) / height_mm;
+}
+
+/**
+*      @brief Function to find a coordinate's cell position
+*      @param value coordinate in mm
+*      @param extent side of the writing area in mm, coordinates beyond it use the edge cells
+*      @param step cells per mm in 1/65536
+*      @return int32_t position in 1/256 cell from the first node
+**/
+static int32_t cell_position(float value, float extent, int32_t step)
+{
+    int32_t position;
+
+    if (value <= 0)     return 0;
+    if (value > extent) value = extent;
+
+    position = ((int32_t)(value * (1 << POSITION_FRACTION)) * step) >> (STEP_SHIFT + POSITION_FRACTION - CELL_SHIFT);
+    return (position > POSITION_LIMIT) ? POSITION_LIMIT : position;
+}
+
+/**
+*      @brief Function to correct a fix
+*      @param x, y fix in mm, fix offsets included, corrected in place
+**/
+void grid_apply(float *x, float *y)
+{
+    int32_t px, py, fx, fy, dx, dy;
+    uint16_t n;
+
+    if (!g_valid || config_get(GRID_MODE) == 0)     return;
+
+    px = cell_position(*x, g_width, g_step_x);
+    py = cell_position(*y, g_height, g_step_y);
+    fx = px & (CELL_ONE - 1);
+    fy = py & (CELL_ONE - 1);
+    n = (py >> CELL_SHIFT) * GRID_SIZE + (px >> CELL_SHIFT);                            // Node below and left of the fix
+
+    dx = (GRID_NODE_X(g_words, n) * (CELL_ONE - fx) + GRID_NODE_X(g_words, n + 1) * fx) * (CELL_ONE - fy) +
+         (GRID_NODE_X(g_words, n + GRID_SIZE) * (CELL_ONE - fx) + GRID_NODE_X(g_words, n + GRID_SIZE + 1) * fx) * fy;
+    dy = (GRID_NODE_Y(g_words, n) * (CELL_ONE - fx) + GRID_NODE_Y(g_words, n + 1) * fx) * (CELL_ONE - fy) +
+         (GRID_NODE_Y(g_words, n + GRID_SIZE) * (CELL_ONE - fx) + GRID_NODE_Y(g_words, n + GRID_SIZE + 1) * fx) * fy;
+
+    *x += dx * (1.0f / (1 << (2 * CELL_SHIFT + GRID_FRACTION)));
+    *y += dy * (1.0f / (1 << (2 * CELL_SHIFT + GRID_FRACTION)));
+}
+
+/**
+*      @brief Function to turn the correction on or off, the grid itself is kept
+**/
+void grid_enable(bool enable)
+{
+    config_set(GRID_MODE, enable);
+    config_flush();
+}
+
+/**
+*      @brief Function to start receiving a grid
+*      @param crc CRC-32 of the GRID_WORDS words that will follow
+**/
+void grid_upload_begin(uint32_t crc)
+{
+    g_upload_crc = crc;
+    g_upload_received = 0;
+    g_upload_active = true;
+    g_valid = false;                                                                    // g_words is overwritten from here on
+}
+
+/**
+*      @brief Function to append words to the grid being received, commits once the grid is complete
+*      @param words values from one "grid data" line
+*      @param count number of values
+**/
+void grid_upload_data(const int32_t *words, uint8_t count)
+{
+    uint8_t i;
+
+    if (!g_upload_active)
+    {
+        format_string(putcUart0, "ERROR! No grid load in progress\r\n\r\n");
+        return;
+    }
+
+    if (g_upload_received + count > GRID_WORDS)
+    {
+        format_string(putcUart0, "ERROR! Grid longer than ");
+        format_uint(putcUart0, GRID_WORDS);
+        format_string(putcUart0, " words, load aborted\r\n\r\n");
+        g_upload_active = false;
+        grid_load((int32_t)g_width, (int32_t)g_height);                                 // Back to the stored grid
+        return;
+    }
+
+    for (i = 0; i < count; i++)     g_words[g_upload_received++] = (uint32_t)words[i];
+
+    if (g_upload_received < GRID_WORDS)     return;                                     // Wait for the rest
+
+    g_upload_active = false;
+
+    if (g_upload_crc == 0 || config_crc32(g_words, GRID_WORDS) != g_upload_crc)
+    {
+        format_string(putcUart0, "ERROR! Grid CRC mismatch, nothing written\r\n\r\n");
+        grid_load((int32_t)g_width, (int32_t)g_height);
+        return;
+    }
+
+    config_set(GRID_CRC, 0);                                                            // Invalid while the nodes change
+    config_flush();
+    writeEepromBlock(GRID_BASE, g_words, GRID_WORDS);
+    config_set(GRID_CRC, g_upload_crc);
+    config_set(GRID_MODE, 1);
+    config_flush();
+    g_valid = true;
+
+    format_string(putcUart0, "Grid committed, correction on\r\n\r\n");
+}
+
+/**
+*      @brief Function to print the state of the grid and its largest correction
+**/
+void grid_print(void)
+{
+    int32_t largest = 0, value;
+    uint16_t n;
+
+    if (g_upload_active)
+    {
+        format_string(putcUart0, "Grid load in progress, ");
+        format_uint(putcUart0, g_upload_received);
+        format_string(putcUart0, " words received\r\n\r\n");
+        return;
+    }
+    if (!g_valid)
+    {
+        format_string(putcUart0, "No correction grid stored\r\n\r\n");
+        return;
+    }
+
+    for (n = 0; n < GRID_NODES; n++)
+    {
+        value = GRID_NODE_X(g_words, n);
+        if (value < 0)          value = -value;
+        if (value > largest)    largest = value;
+        value = GRID_NODE_Y(g_words, n);
+        if (value < 0)          value = -value;
+        if (value > largest)    largest = value;
+    }
+
+    format_string(putcUart0, (config_get(GRID_MODE) != 0) ? "Correction grid on, " : "Correction grid off, ");
+    format_uint(putcUart0, GRID_SIZE);
+    format_string(putcUart0, "x");
+    format_uint(putcUart0, GRID_SIZE);
+    format_string(putcUart0, " nodes, CRC ");
+    format_hex(putcUart0, config_get(GRID_CRC), 8);
+    format_string(putcUart0, ", largest correction ");
+    format_fixed(putcUart0, largest * 1000 >> GRID_FRACTION, 3);
+    format_string(putcUart0, "mm\r\n\r\n");
+}
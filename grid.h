@@ -0,0 +1,33 @@
+/**
+*      @file grid.h
+*      @author Prithvi Bhat
+*      @brief Spatial correction grid applied to every fix
+**/
+#ifndef GRID_H
+#define GRID_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define GRID_SIZE           16                  // Nodes along each side of the writing area
+#define GRID_NODES          (GRID_SIZE * GRID_SIZE)
+#define GRID_FRACTION       3                   // Corrections in 1/8 mm
+#define GRID_WORDS          (GRID_NODES / 2)    // Two nodes per EEPROM word, see eeprom_memory_map.h
+
+// Node n, row n / GRID_SIZE along y and column n % GRID_SIZE along x, is held by word n / 2:
+// x then y correction of the even node in the low half word, the odd node in the high half word
+#define GRID_PACK(even_x, even_y, odd_x, odd_y)                                             \
+    ((uint32_t)(uint8_t)(even_x) | ((uint32_t)(uint8_t)(even_y) << 8) |                   \
+     ((uint32_t)(uint8_t)(odd_x) << 16) | ((uint32_t)(uint8_t)(odd_y) << 24))
+#define GRID_NODE_X(words, n)   ((int8_t)((words)[(n) >> 1] >> (((n) & 1) * 16)))
+#define GRID_NODE_Y(words, n)   ((int8_t)((words)[(n) >> 1] >> (((n) & 1) * 16 + 8)))
+
+// Function prototypes
+void grid_load(int32_t width_mm, int32_t height_mm);
+void grid_apply(float *x, float *y);
+void grid_enable(bool enable);
+void grid_upload_begin(uint32_t crc);
+void grid_upload_data(const int32_t *words, uint8_t count);
+void grid_print(void);
+
+#endif
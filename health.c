@@ -0,0 +1,214 @@
+/**
+*      @file health.c
+*      @author Prithvi Bhat
+*      @brief Health of the ultrasound channels, for tracking on two ranges while one sensor is out
+*               * Every stroke started by the IR pulse counts, per sensor, whether the sensor heard it and
+*                 whether its capture was an outlier: a change of more than HEALTH_JUMP_TICKS since its
+*                 last capture while neither other sensor changed by half as much. A moving or lifted pen
+*                 changes every range, a bad transducer or comparator changes only its own
+*               * A channel goes down after HEALTH_MISS_LIMIT missed strokes in a row, or once its running
+*                 outlier rate passes HEALTH_OUTLIER_LIMIT. It comes back after HEALTH_RECOVER_STROKES good
+*                 strokes in a row with the rate below HEALTH_RECOVER_RATE
+*               * With one channel down the solver works from the other two ranges, see commands.c
+*               * Integer arithmetic only, called from the watchdog ISR
+**/
+
+#include "health.h"
+#include "format.h"
+#include "uart0.h"
+
+#define RATE_SMOOTHING      16                  // Strokes the outlier rate averages over, about
+#define RATE_ONE            256                 // Outlier rate of every capture
+
+/**
+*      @brief Running state of one sensor
+**/
+typedef struct
+{
+    uint32_t last;                              // Previous capture
+    uint16_t rate;                              // Outlier rate in 1/256 of the captures heard
+    uint8_t misses;                             // Strokes missed in a row
+    uint8_t good;                               // Good strokes in a row
+    bool primed;                                // last holds a capture
+    bool down;                                  // Zero, up, until the health says otherwise
+} health_channel_t;
+
+// Global Variables
+static health_channel_t g_channel[HEALTH_CHANNELS];
+static volatile bool g_changed = false;
+
+/**
+*      @brief Function to mark every channel healthy and forget the history
+**/
+void health_reset(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)
+    {
+        g_channel[i].rate = 0;
+        g_channel[i].misses = 0;
+        g_channel[i].good = 0;
+        g_channel[i].primed = false;
+        g_channel[i].down = false;
+    }
+    g_changed = false;
+}
+
+/**
+*      @brief Function to work out how far a capture moved since the previous one
+**/
+static uint32_t jump(const health_channel_t *channel, uint32_t capture)
+{
+    if (!channel->primed)   return 0;
+    return (capture > channel->last) ? capture - channel->last : channel->last - capture;
+}
+
+/**
+*      @brief Function to feed one stroke started by the IR pulse
+*      @param heard HEALTH_CHANNELS flags, true if the sensor captured the pulse
+*      @param capture HEALTH_CHANNELS timer captures, only read for the sensors that heard the pulse
+*      @return uint8_t bit i set if channel i came back with this stroke, its history is stale
+**/
+uint8_t health_update(const bool *heard, const uint32_t *capture)
+{
+    uint32_t moved[HEALTH_CHANNELS];
+    uint8_t i, recovered = 0;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)   moved[i] = heard[i] ? jump(&g_channel[i], capture[i]) : 0;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)
+    {
+        health_channel_t *channel = &g_channel[i];
+        uint32_t others = 0, j;
+        bool outlier;
+
+        if (!heard[i])
+        {
+            channel->good = 0;
+            if (channel->misses < UINT8_MAX)    channel->misses++;
+            if (!channel->down && channel->misses >= HEALTH_MISS_LIMIT)
+            {
+                channel->down = true;
+                g_changed = true;
+            }
+            continue;
+        }
+
+        for (j = 0; j < HEALTH_CHANNELS; j++)
+        {
+            if (j != i && heard[j] && moved[j] > others)    others = moved[j];
+        }
+        outlier = (moved[i] > HEALTH_JUMP_TICKS && others < HEALTH_JUMP_TICKS / 2);
+
+        channel->rate += ((outlier ? RATE_ONE : 0) - (int32_t)channel->rate) / RATE_SMOOTHING;
+        channel->last = capture[i];
+        channel->primed = true;
+        channel->misses = 0;
+        channel->good = outlier ? 0 : ((channel->good < UINT8_MAX) ? channel->good + 1 : UINT8_MAX);
+
+        if (!channel->down && channel->rate > HEALTH_OUTLIER_LIMIT)
+        {
+            channel->down = true;
+            g_changed = true;
+        }
+        else if (channel->down && channel->good >= HEALTH_RECOVER_STROKES && channel->rate < HEALTH_RECOVER_RATE)
+        {
+            channel->down = false;
+            g_changed = true;
+            recovered |= 1 << i;
+        }
+    }
+
+    return recovered;
+}
+
+/**
+*      @brief Function to report whether a channel is healthy
+**/
+bool health_up(uint8_t channel)
+{
+    return (channel < HEALTH_CHANNELS) ? !g_channel[channel].down : false;
+}
+
+/**
+*      @brief Function to count the channels that are down
+**/
+uint8_t health_down_count(void)
+{
+    uint8_t i, down = 0;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)
+    {
+        if (g_channel[i].down)   down++;
+    }
+    return down;
+}
+
+/**
+*      @brief Function to find the channel that is down
+*      @return uint8_t the lowest channel down, HEALTH_NONE if all are healthy
+**/
+uint8_t health_down_channel(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)
+    {
+        if (g_channel[i].down)   return i;
+    }
+    return HEALTH_NONE;
+}
+
+/**
+*      @brief Function to find out, once, that a channel went down or came back
+*      @return bool true if the health changed since the last call
+**/
+bool health_changed(void)
+{
+    bool changed = g_changed;
+
+    g_changed = false;
+    return changed;
+}
+
+/**
+*      @brief Function to print the health of every channel
+**/
+void health_print(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < HEALTH_CHANNELS; i++)
+    {
+        format_string(putcUart0, "Sensor ");
+        putcUart0('A' + i);
+        format_string(putcUart0, g_channel[i].down ? " down" : " up");
+        format_string(putcUart0, ", missed ");
+        format_uint(putcUart0, g_channel[i].misses);
+        format_string(putcUart0, " in a row, outliers ");
+        format_uint(putcUart0, (g_channel[i].rate * 100 + RATE_ONE / 2) / RATE_ONE);
+        format_string(putcUart0, "%\r\n");
+    }
+
+    switch (health_down_count())
+    {
+        case 0:
+        {
+            format_string(putcUart0, "Tracking on three ranges\r\n\r\n");
+            break;
+        }
+
+        case 1:
+        {
+            format_string(putcUart0, "Tracking on two ranges, reduced quality\r\n\r\n");
+            break;
+        }
+
+        default:
+        {
+            format_string(putcUart0, "Too few sensors to track\r\n\r\n");
+            break;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+/**
+*      @file health.h
+*      @author Prithvi Bhat
+*      @brief Health of the ultrasound channels, for tracking on two ranges while one sensor is out
+**/
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define HEALTH_CHANNELS         3               // Ultrasound sensors A, B and C
+#define HEALTH_NONE             0xFF            // No channel down
+#define HEALTH_MISS_LIMIT       4               // Missed strokes in a row that take a channel down
+#define HEALTH_OUTLIER_LIMIT    128             // Outlier rate in 1/256 that takes a channel down
+#define HEALTH_RECOVER_STROKES  8               // Good strokes in a row that bring a channel back
+#define HEALTH_RECOVER_RATE     64              // Outlier rate in 1/256 a channel must be below to come back
+#define HEALTH_JUMP_TICKS       4665            // Capture change counted as an outlier, about 40 mm
+
+// Function prototypes
+uint8_t health_update(const bool *heard, const uint32_t *capture);
+bool health_up(uint8_t channel);
+uint8_t health_down_count(void);
+uint8_t health_down_channel(void);
+bool health_changed(void);
+void health_reset(void);
+void health_print(void);
+
+#endif
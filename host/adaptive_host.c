@@ -0,0 +1,120 @@
+/**
+*      @file adaptive_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the adaptive averaging depth
+*               Synthetic strokes, the same geometry and noise generator as the benchmark, are fed through
+*               adaptive.c while the pen rests, moves and stops again, checking the depth it settles on,
+*               how fast it follows, that it stays within its bounds and that it is repeatable
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o adaptive_host host/adaptive_host.c adaptive.c -lm
+*             Usage:    ./adaptive_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "adaptive.h"
+#include "eeprom_host.h"
+
+#define CONVERSION_CONSTANT     0.008575    // mm per timer tick, matches commands.c
+#define TRACE_STROKES           200
+#define QUIET_TICKS             2           // Peak to peak capture noise
+#define NOISY_TICKS             120
+
+// Sensor positions in mm, as set by the benchmark
+static const double g_sensor_x[ADAPTIVE_CHANNELS] = { 0, 0, 300 };
+static const double g_sensor_y[ADAPTIVE_CHANNELS] = { 0, 200, 200 };
+
+// Global Variables
+static uint32_t g_seed = 12345;
+static double g_pen_x = 150, g_pen_y = 100;
+static uint8_t g_min = 255, g_max = 0;
+
+/**
+*      @brief Function to feed one stroke of the pen at its current position
+*      @param noise peak to peak capture noise in ticks
+*      @return uint8_t depth picked by the controller
+**/
+static uint8_t stroke(uint32_t noise)
+{
+    uint32_t capture[ADAPTIVE_CHANNELS];
+    uint8_t i, depth;
+
+    for (i = 0; i < ADAPTIVE_CHANNELS; i++)
+    {
+        double dx = g_pen_x - g_sensor_x[i], dy = g_pen_y - g_sensor_y[i];
+        int32_t jitter = 0;
+
+        g_seed = g_seed * 1664525 + 1013904223;                                 // Numerical Recipes LCG
+        if (noise != 0)     jitter = (int32_t)((g_seed >> 16) % noise) - (int32_t)noise / 2;
+        capture[i] = (uint32_t)(sqrt(dx * dx + dy * dy) / CONVERSION_CONSTANT) + jitter;
+    }
+
+    depth = adaptive_update(capture);
+    if (depth < g_min)  g_min = depth;
+    if (depth > g_max)  g_max = depth;
+    return depth;
+}
+
+/**
+*      @brief Function to play a fixed script of rest, writing and rest, recording the depth of every stroke
+**/
+static void script(uint8_t *trace)
+{
+    uint16_t i, n = 0;
+
+    g_seed = 12345;
+    g_pen_x = 150;
+    g_pen_y = 100;
+    adaptive_configure(2, 10);
+
+    for (i = 0; i < 60; i++)    trace[n++] = stroke(NOISY_TICKS);
+    for (i = 0; i < 40; i++, g_pen_x += 3)      trace[n++] = stroke(NOISY_TICKS);
+    for (i = 0; i < 100; i++)   trace[n++] = stroke(NOISY_TICKS);
+}
+
+int main(void)
+{
+    uint8_t first[TRACE_STROKES], second[TRACE_STROKES], depth = 0;
+    uint16_t i, follow;
+    bool pass = true, rising = true;
+
+    // A resting pen with quiet captures needs only the shallowest average
+    adaptive_configure(2, 10);
+    for (i = 0; i < 60; i++)    depth = stroke(QUIET_TICKS);
+    pass &= check("quiet resting pen uses the minimum", depth == 2);
+
+    // Noisy captures ask for the deepest one
+    adaptive_configure(2, 10);
+    for (i = 0; i < 60; i++)    depth = stroke(NOISY_TICKS);
+    pass &= check("noisy resting pen uses the maximum", depth == 10);
+
+    // Writing at 5 mm per stroke cuts the depth within a few strokes
+    for (follow = 0; follow < 20 && depth != 2; follow++, g_pen_x -= 5)     depth = stroke(NOISY_TICKS);
+    pass &= check("moving pen drops to the minimum", depth == 2 && follow <= 5);
+
+    // Once the pen stops the depth climbs back a stroke at a time
+    for (i = 0; i < 60; i++)
+    {
+        uint8_t next = stroke(NOISY_TICKS);
+        rising &= (next == depth || next == depth + 1);
+        depth = next;
+    }
+    pass &= check("depth grows back one stroke at a time", rising && depth == 10);
+    pass &= check("depth stays within its bounds", g_min >= 2 && g_max <= 10);
+
+    // Equal bounds turn the controller off
+    adaptive_configure(4, 4);
+    for (i = 0; i < 20; i++, g_pen_x += 5)  depth = stroke(NOISY_TICKS);
+    pass &= check("equal bounds keep a fixed depth", !adaptive_enabled() && depth == 4);
+
+    // The same strokes always give the same depths
+    script(first);
+    script(second);
+    for (i = 0; i < TRACE_STROKES && first[i] == second[i]; i++);
+    pass &= check("repeatable", i == TRACE_STROKES);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
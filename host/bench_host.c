@@ -0,0 +1,70 @@
+/**
+*      @file bench_host.c
+*      @author Prithvi Bhat
+*      @brief Host driver for the firmware microbenchmarks in bench.c
+*               Provides the timer, output and the few peripheral entry points the kernels call,
+*               so commands.c and strings.c run unmodified on a PC
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -D'_delay_cycles(x)=' -DBENCH_HOST -o bench_host \
+*                           host/bench_host.c host/eeprom_host.c bench.c commands.c strings.c format.c config.c journal.c profile.c minimap.c tone.c window.c surface.c grid.c health.c -lm
+*             Usage:    ./bench_host > bench.csv
+*
+*             Ticks are TSC cycles on x86 and nanoseconds elsewhere
+**/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "../bench.h"
+#include "../eeprom_memory_map.h"
+#include "../config.h"
+#include "eeprom_host.h"
+#include "../commands.h"
+
+/**
+*      @brief Function to provide a default configuration in an erased emulated EEPROM
+**/
+void bench_init(void)
+{
+    host_boot_geometry();
+    config_set(FIX_X, 0);       config_set(FIX_Y, 0);
+    config_set(TC_AVG, 10);
+    update_solver_constants();
+}
+
+uint32_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+void bench_puts(const char *string)
+{
+    for (; *string; string++)
+    {
+        if (*string != '\r')    putchar(*string);
+    }
+}
+
+// Peripheral entry points used by the kernels
+void putcUart0(char c)                          { (void)c; }
+void putsUart0(char *str)                       { (void)str; }
+bool readUart0(char *c)                         { (void)c; return false; }
+void putsLcd(uint8_t row, uint8_t col, const char str[]) { (void)row; (void)col; (void)str; }
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits) { (void)glyph; (void)row; (void)bits; }
+uint32_t timer_ms(void)                         { return 0; }
+void waitMicrosecond(uint32_t us)               { (void)us; }
+
+int main(void)
+{
+    bench_run_all();
+    return 0;
+}
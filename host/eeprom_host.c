@@ -0,0 +1,130 @@
+/**
+*      @file eeprom_host.c
+*      @author Prithvi Bhat
+*      @brief Host model of the TM4C123 EEPROM counting reads and writes per word
+*               Provides initEeprom(), readEeprom() and writeEeprom() so config.c and journal.c run unmodified
+*               host_boot_geometry() needs config.c linked as well
+**/
+
+#include <stdint.h>
+#include "eeprom_host.h"
+#include <stdbool.h>
+#include "../eeprom.h"
+#include "../config.h"
+
+// Global Variables
+static uint32_t g_eeprom[EEPROM_WORDS];
+static uint32_t g_eeprom_writes[EEPROM_WORDS];
+static uint32_t g_eeprom_reads = 0;
+
+/**
+*      @brief Function to return every word to its erased state, counts are kept
+**/
+void eeprom_host_erase(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < EEPROM_WORDS; i++)  g_eeprom[i] = 0xFFFFFFFF;
+}
+
+/**
+*      @brief Function to reset the read and write counters
+**/
+void eeprom_host_clear_counts(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < EEPROM_WORDS; i++)  g_eeprom_writes[i] = 0;
+    g_eeprom_reads = 0;
+}
+
+/**
+*      @brief Function to return the number of writes to one word
+**/
+uint32_t eeprom_host_writes(uint16_t add)
+{
+    return g_eeprom_writes[add % EEPROM_WORDS];
+}
+
+/**
+*      @brief Function to return the highest write count in a range of words
+**/
+uint32_t eeprom_host_max_writes(uint16_t first, uint16_t count)
+{
+    uint32_t max = 0;
+    uint16_t i;
+
+    for (i = first; i < first + count && i < EEPROM_WORDS; i++)
+    {
+        if (g_eeprom_writes[i] > max)   max = g_eeprom_writes[i];
+    }
+    return max;
+}
+
+/**
+*      @brief Function to return the number of writes to a range of words
+**/
+uint32_t eeprom_host_sum_writes(uint16_t first, uint16_t count)
+{
+    uint32_t total = 0;
+    uint16_t i;
+
+    for (i = first; i < first + count && i < EEPROM_WORDS; i++)     total += g_eeprom_writes[i];
+    return total;
+}
+
+/**
+*      @brief Function to return the number of reads since the counters were cleared
+**/
+uint32_t eeprom_host_reads(void)
+{
+    return g_eeprom_reads;
+}
+
+/**
+*      @brief Function to boot from an erased EEPROM with the geometry of the host checks
+*               A at (0, 0), B at (0, 200), C at (300, 200). Checks that link commands.c call
+*               update_solver_constants() afterwards
+**/
+void host_boot_geometry(void)
+{
+    eeprom_host_erase();
+    config_init();
+    config_set(CRD_AX, 0);      config_set(CRD_AY, 0);
+    config_set(CRD_BX, 0);      config_set(CRD_BY, 200);
+    config_set(CRD_CX, 300);    config_set(CRD_CY, 200);
+    config_flush();
+}
+
+bool g_eeprom_stream = true;                     // Block calls read word by word on the host either way
+
+void initEeprom(void)
+{
+}
+
+void writeEeprom(uint16_t add, uint32_t data)
+{
+    add %= EEPROM_WORDS;
+    g_eeprom[add] = data;
+    g_eeprom_writes[add]++;
+}
+
+uint32_t readEeprom(uint16_t add)
+{
+    g_eeprom_reads++;
+    return g_eeprom[add % EEPROM_WORDS];
+}
+
+void readEepromBlock(uint16_t add, uint32_t data[], uint16_t count)
+{
+    uint16_t i;
+
+    for (i = 0; i < count; i++)     data[i] = readEeprom(add + i);
+}
+
+void writeEepromBlock(uint16_t add, const uint32_t data[], uint16_t count)
+{
+    uint16_t i;
+
+    for (i = 0; i < count; i++)     writeEeprom(add + i, data[i]);
+}
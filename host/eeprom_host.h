@@ -0,0 +1,36 @@
+/**
+*      @file eeprom_host.h
+*      @author Prithvi Bhat
+*      @brief Host model of the TM4C123 EEPROM counting reads and writes per word, and the pieces every host
+*               check shares: the pass/FAIL line and the boot with the sensor geometry the checks assume
+**/
+#ifndef EEPROM_HOST_H
+#define EEPROM_HOST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../eeprom_memory_map.h"
+
+// Function prototypes
+void eeprom_host_erase(void);
+void eeprom_host_clear_counts(void);
+uint32_t eeprom_host_writes(uint16_t add);
+uint32_t eeprom_host_max_writes(uint16_t first, uint16_t count);
+uint32_t eeprom_host_sum_writes(uint16_t first, uint16_t count);
+uint32_t eeprom_host_reads(void);
+void host_boot_geometry(void);
+
+/**
+*      @brief Function to print one result of a host check
+*      @param name what was checked
+*      @param pass result
+*      @return bool pass, to be and-ed into the overall result
+**/
+static inline bool check(const char *name, bool pass)
+{
+    printf("%-44s %s\n", name, pass ? "pass" : "FAIL");
+    return pass;
+}
+
+#endif
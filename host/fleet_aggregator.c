@@ -0,0 +1,456 @@
+/**
+*      @file fleet_aggregator.c
+*      @author Prithvi Bhat
+*      @brief Host daemon that merges the fix streams of several receiver boards into one time ordered output
+*               * One epoll reactor thread reads every serial device and assembles lines
+*               * Decoded fixes are pushed into a lock-free queue per device
+*               * The main thread drains the queues into a min-heap and releases fixes once they are older
+*                 than the reorder window, so the output is ordered by receive time across all boards
+*               * Per-device throughput and queue depth are reported on stderr
+*
+*             Build:    gcc -O2 -std=gnu11 -pthread -o fleet_aggregator host/fleet_aggregator.c
+*             Usage:    fleet_aggregator [-w window_ms] [-i stats_s] [-t run_s] /dev/ttyACM0 /dev/ttyACM1 ...
+*                       fleet_aggregator -n 4 [-r fixes_per_s]      (pseudo-terminals stand in for boards)
+*
+*             Output:   time_ms,device,x_mm,y_mm  (one CSV line per fix on stdout)
+**/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "spsc_queue.h"
+
+#define MAX_DEVICES         32          // Maximum number of receiver boards
+#define QUEUE_CAPACITY      1024        // Fixes buffered per device, must be a power of two
+#define LINE_LENGTH         128         // Longest line accepted from a board
+#define READ_CHUNK          512         // Bytes read per read() call
+#define EPOLL_BATCH         16          // Events handled per epoll_wait() call
+
+/**
+*      @brief One decoded fix
+**/
+typedef struct
+{
+    uint64_t time_ns;                   // Receive time of the terminating newline (CLOCK_MONOTONIC)
+    uint32_t device;                    // Index of the source device
+    int32_t x;                          // x coordinate in mm
+    int32_t y;                          // y coordinate in mm
+} fix_record_t;
+
+/**
+*      @brief Per-device state
+*               Line buffer is owned by the reactor, queue is shared, counters are written by the reactor only
+**/
+typedef struct
+{
+    const char *path;
+    int fd;
+    char line[LINE_LENGTH];
+    size_t line_length;
+    spsc_queue_t queue;
+    fix_record_t storage[QUEUE_CAPACITY];
+    atomic_uint_fast64_t bytes, fixes, drops;
+    uint64_t reported_bytes, reported_fixes;    // Snapshot of the last stats report (main thread only)
+} device_t;
+
+// Global Variables
+static device_t g_devices[MAX_DEVICES];
+static uint32_t g_device_count = 0;
+static volatile sig_atomic_t g_stop = 0;
+static int g_sim_masters[MAX_DEVICES];
+static uint32_t g_sim_rate = 100;
+
+static fix_record_t g_heap[MAX_DEVICES * QUEUE_CAPACITY];
+static size_t g_heap_size = 0;
+
+/**
+*      @brief Function to read the monotonic clock in nanoseconds
+**/
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void stop_handler(int signal_number)
+{
+    (void)signal_number;
+    g_stop = 1;
+}
+
+/**
+*      @brief Function to parse a signed decimal integer and advance the cursor
+*      @return true if at least one digit was consumed
+**/
+static bool parse_integer(const char **cursor, int32_t *value)
+{
+    const char *s = *cursor;
+    bool negative = false;
+    int32_t result = 0;
+
+    while (*s == ' ')   s++;
+    if (*s == '-')      { negative = true; s++; }
+    if (*s < '0' || *s > '9')   return false;
+
+    while (*s >= '0' && *s <= '9')  result = result * 10 + (*s++ - '0');
+
+    *value = negative ? -result : result;
+    *cursor = s;
+    return true;
+}
+
+/**
+*      @brief Function to decode one line produced by calculate_coordinates
+*               Expected format: "x,y: <x>mm, <y>mm"
+*      @return true if the line carried a fix
+**/
+static bool decode_fix(const char *line, int32_t *x, int32_t *y)
+{
+    const char *s = strstr(line, "x,y:");
+
+    if (s == NULL)                                  return false;
+    s += 4;
+
+    if (!parse_integer(&s, x))                      return false;
+    if (strncmp(s, "mm,", 3) != 0)                  return false;
+    s += 3;
+
+    if (!parse_integer(&s, y))                      return false;
+    return strncmp(s, "mm", 2) == 0;
+}
+
+/**
+*      @brief Function to split received bytes into lines and queue any decoded fixes
+**/
+static void device_consume(device_t *device, uint32_t index, const char *data, size_t length, uint64_t time_ns)
+{
+    size_t i;
+    fix_record_t record;
+
+    for (i = 0; i < length; i++)
+    {
+        char c = data[i];
+
+        if (c == '\r' || c == '\n')
+        {
+            if (device->line_length == 0)   continue;           // Blank line between records
+
+            device->line[device->line_length] = '\0';
+            device->line_length = 0;
+
+            if (!decode_fix(device->line, &record.x, &record.y))  continue;
+
+            record.time_ns = time_ns;
+            record.device = index;
+
+            if (spsc_push(&device->queue, &record))     atomic_fetch_add_explicit(&device->fixes, 1, memory_order_relaxed);
+            else                                        atomic_fetch_add_explicit(&device->drops, 1, memory_order_relaxed);
+        }
+        else if (device->line_length < LINE_LENGTH - 1)
+        {
+            device->line[device->line_length++] = c;
+        }
+    }
+}
+
+/**
+*      @brief Reactor thread, services every device from a single epoll instance
+**/
+static void *reactor_thread(void *argument)
+{
+    int epoll_fd = *(int *)argument;
+    struct epoll_event events[EPOLL_BATCH];
+    char buffer[READ_CHUNK];
+    int i, ready;
+
+    while (!g_stop)
+    {
+        ready = epoll_wait(epoll_fd, events, EPOLL_BATCH, 100);
+
+        for (i = 0; i < ready; i++)
+        {
+            uint32_t index = events[i].data.u32;
+            device_t *device = &g_devices[index];
+            ssize_t length;
+
+            while ((length = read(device->fd, buffer, sizeof(buffer))) > 0)   // Edge triggered, drain fully
+            {
+                atomic_fetch_add_explicit(&device->bytes, (uint64_t)length, memory_order_relaxed);
+                device_consume(device, index, buffer, (size_t)length, now_ns());
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+*      @brief Function to open a serial device in raw, non-blocking mode
+**/
+static int open_serial(const char *path)
+{
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0)     return -1;
+
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/**
+*      @brief Function to create a pseudo-terminal pair that stands in for one board
+*      @param master Receives the master side, written by the simulator
+*      @return char* path of the slave side, opened by the reactor like any serial device
+**/
+static char *open_simulated_board(int *master)
+{
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)    return NULL;
+
+    if (tcgetattr(fd, &tio) == 0)                       // No echo or newline translation on the board side
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    *master = fd;
+    return strdup(ptsname(fd));
+}
+
+/**
+*      @brief Simulator thread, writes firmware formatted fixes into every pseudo-terminal master
+**/
+static void *simulator_thread(void *argument)
+{
+    unsigned int seed = 1;
+    uint64_t period_ns = 1000000000ull / g_sim_rate;
+    uint64_t next = now_ns();
+    uint32_t i, stroke = 0;
+    char line[64];
+    (void)argument;
+
+    while (!g_stop)
+    {
+        for (i = 0; i < g_device_count; i++)
+        {
+            int32_t x = 100 + (int32_t)((stroke * 3 + i * 17) % 200) + (rand_r(&seed) % 3) - 1;
+            int32_t y = 50 + (int32_t)((stroke * 2 + i * 11) % 150) + (rand_r(&seed) % 3) - 1;
+            int length = snprintf(line, sizeof(line), "x,y: %dmm, %dmm\r\n\r\n", x, y);
+
+            if (write(g_sim_masters[i], line, (size_t)length) < 0 && errno != EAGAIN)   g_stop = 1;
+        }
+        stroke++;
+
+        next += period_ns;
+        struct timespec ts = { (time_t)(next / 1000000000ull), (long)(next % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    return NULL;
+}
+
+/**
+*      @brief Min-heap helpers ordered by receive time, ties broken by device index
+**/
+static bool record_before(const fix_record_t *a, const fix_record_t *b)
+{
+    if (a->time_ns != b->time_ns)   return a->time_ns < b->time_ns;
+    return a->device < b->device;
+}
+
+static void heap_push(const fix_record_t *record)
+{
+    size_t i = g_heap_size++;
+
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!record_before(record, &g_heap[parent]))   break;
+        g_heap[i] = g_heap[parent];
+        i = parent;
+    }
+    g_heap[i] = *record;
+}
+
+static void heap_pop(fix_record_t *record)
+{
+    fix_record_t last = g_heap[--g_heap_size];
+    size_t i = 0;
+
+    *record = g_heap[0];
+
+    while (true)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= g_heap_size)                                                       break;
+        if (child + 1 < g_heap_size && record_before(&g_heap[child + 1], &g_heap[child]))   child++;
+        if (!record_before(&g_heap[child], &last))                                      break;
+        g_heap[i] = g_heap[child];
+        i = child;
+    }
+    g_heap[i] = last;
+}
+
+/**
+*      @brief Function to print one fix to stdout
+**/
+static void emit(const fix_record_t *record, uint64_t start_ns, uint64_t *last_ns, uint64_t *late)
+{
+    if (record->time_ns < *last_ns)     (*late)++;     // Arrived after the reorder window had closed
+    else                                *last_ns = record->time_ns;
+
+    printf("%.3f,%" PRIu32 ",%" PRId32 ",%" PRId32 "\n",
+           (double)(record->time_ns - start_ns) / 1e6, record->device, record->x, record->y);
+}
+
+/**
+*      @brief Function to print per-device throughput and queue depth on stderr
+**/
+static void report_stats(double interval_s, uint64_t late)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_device_count; i++)
+    {
+        device_t *device = &g_devices[i];
+        uint64_t bytes = atomic_load_explicit(&device->bytes, memory_order_relaxed);
+        uint64_t fixes = atomic_load_explicit(&device->fixes, memory_order_relaxed);
+
+        fprintf(stderr, "[%2" PRIu32 "] %-16s %9.1f B/s %8.1f fix/s  depth %4zu  drops %" PRIu64 "\n",
+                i, device->path,
+                (double)(bytes - device->reported_bytes) / interval_s,
+                (double)(fixes - device->reported_fixes) / interval_s,
+                spsc_depth(&device->queue),
+                (uint64_t)atomic_load_explicit(&device->drops, memory_order_relaxed));
+
+        device->reported_bytes = bytes;
+        device->reported_fixes = fixes;
+    }
+    fprintf(stderr, "     heap %zu  late %" PRIu64 "\n", g_heap_size, late);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-w window_ms] [-i stats_s] [-t run_s] [-n simulated_boards] [-r fixes_per_s] [device ...]\n", name);
+}
+
+/**
+*      @brief Main, parses arguments, starts the reactor and runs the merge loop
+**/
+int main(int argc, char *argv[])
+{
+    uint32_t window_ms = 20, stats_s = 1, run_s = 0, simulated = 0;
+    uint64_t late = 0, last_emitted = 0;
+    pthread_t reactor, simulator;
+    int epoll_fd, option;
+    uint32_t i;
+
+    while ((option = getopt(argc, argv, "w:i:t:n:r:h")) != -1)
+    {
+        switch (option)
+        {
+            case 'w':   window_ms = (uint32_t)strtoul(optarg, NULL, 10);   break;
+            case 'i':   stats_s = (uint32_t)strtoul(optarg, NULL, 10);     break;
+            case 't':   run_s = (uint32_t)strtoul(optarg, NULL, 10);       break;
+            case 'n':   simulated = (uint32_t)strtoul(optarg, NULL, 10);   break;
+            case 'r':   g_sim_rate = (uint32_t)strtoul(optarg, NULL, 10);  break;
+            default:    usage(argv[0]);                                     return 1;
+        }
+    }
+
+    if (g_sim_rate == 0)    g_sim_rate = 1;
+    if (stats_s == 0)       stats_s = 1;
+
+    for (i = 0; i < simulated && g_device_count < MAX_DEVICES; i++)
+    {
+        char *path = open_simulated_board(&g_sim_masters[g_device_count]);
+        if (path == NULL)   { perror("posix_openpt"); return 1; }
+        g_devices[g_device_count++].path = path;
+    }
+
+    for (; optind < argc && g_device_count < MAX_DEVICES; optind++)
+    {
+        g_devices[g_device_count++].path = argv[optind];
+    }
+
+    if (g_device_count == 0)    { usage(argv[0]); return 1; }
+
+    epoll_fd = epoll_create1(0);
+
+    for (i = 0; i < g_device_count; i++)
+    {
+        device_t *device = &g_devices[i];
+        struct epoll_event event = { .events = EPOLLIN | EPOLLET, .data.u32 = i };
+
+        device->fd = open_serial(device->path);
+        if (device->fd < 0)     { perror(device->path); return 1; }
+
+        spsc_init(&device->queue, device->storage, QUEUE_CAPACITY, sizeof(fix_record_t));
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, device->fd, &event);
+    }
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    pthread_create(&reactor, NULL, reactor_thread, &epoll_fd);
+    if (simulated)  pthread_create(&simulator, NULL, simulator_thread, NULL);
+
+    uint64_t start = now_ns();
+    uint64_t window_ns = (uint64_t)window_ms * 1000000ull;
+    uint64_t last_report = start;
+    fix_record_t record;
+
+    while (!g_stop || g_heap_size)
+    {
+        uint64_t now = now_ns();
+
+        for (i = 0; i < g_device_count; i++)                                // Gather everything decoded so far
+        {
+            while (g_heap_size < sizeof(g_heap) / sizeof(g_heap[0]) && spsc_pop(&g_devices[i].queue, &record))
+                heap_push(&record);
+        }
+
+        while (g_heap_size && (g_stop || g_heap[0].time_ns + window_ns <= now))  // Release what the window has closed on
+        {
+            heap_pop(&record);
+            emit(&record, start, &last_emitted, &late);
+        }
+        fflush(stdout);
+
+        if (now - last_report >= (uint64_t)stats_s * 1000000000ull)
+        {
+            report_stats((double)(now - last_report) / 1e9, late);
+            last_report = now;
+        }
+
+        if (run_s && now - start >= (uint64_t)run_s * 1000000000ull)   g_stop = 1;
+
+        usleep(1000);
+    }
+
+    pthread_join(reactor, NULL);
+    if (simulated)  pthread_join(simulator, NULL);
+
+    report_stats((double)(now_ns() - last_report) / 1e9, late);
+    return 0;
+}
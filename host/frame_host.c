@@ -0,0 +1,178 @@
+/**
+*      @file frame_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the binary fix frame
+*               A synthetic pen is stroked through the capture windows and calculate_coordinates() in
+*               commands.c reports the fix with binary output on. The bytes sent are decoded against the
+*               frame table in README.md: sync, type, length, position, residual, GDOP, variances, samples
+*               and flags, and the Fletcher-16 is worked out independently. A frame must describe the
+*               windows of its own fix, a changed byte must fail the checksum and a rejected fix must
+*               clear the valid flag and the position
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -D'_delay_cycles(x)=' -o frame_host \
+*                           host/frame_host.c host/eeprom_host.c commands.c config.c journal.c format.c minimap.c tone.c window.c surface.c grid.c health.c -lm
+*             Usage:    ./frame_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../commands.h"
+
+#define CONVERSION_CONSTANT 0.008575        // mm per timer tick, matches commands.c
+#define FRAME_BYTES         24              // Sync, type, length, 18 payload bytes, checksum
+#define DEPTH               8               // Captures averaged per fix
+#define PEN_X               120             // Pen position, frame of the sensor coordinates
+#define PEN_Y               90
+
+// Global Variables
+static capture_window_t g_window_A, g_window_B, g_window_C;
+static uint8_t g_sent[2 * FRAME_BYTES];     // Bytes written to the terminal
+static uint16_t g_sent_count = 0;
+
+// Peripheral entry points used by commands.c
+void putcUart0(char c)
+{
+    if (g_sent_count < sizeof(g_sent))  g_sent[g_sent_count] = (uint8_t)c;
+    g_sent_count++;
+}
+void putsUart0(char *str)                       { for (; *str; str++) putcUart0(*str); }
+void putsLcd(uint8_t row, uint8_t col, const char str[]) { (void)row; (void)col; (void)str; }
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits) { (void)glyph; (void)row; (void)bits; }
+uint32_t timer_ms(void)                         { return 0; }
+void waitMicrosecond(uint32_t us)               { (void)us; }
+
+/**
+*      @brief Function to fill fresh windows with strokes of a pen at x, y
+*      @param noise ticks added to and taken from alternate captures of sensor A
+**/
+static void fill(int32_t x, int32_t y, int32_t noise)
+{
+    uint32_t ticks[3];
+    uint8_t i;
+
+    window_reset(&g_window_A, DEPTH);
+    window_reset(&g_window_B, DEPTH);
+    window_reset(&g_window_C, DEPTH);
+    calculate_expected_ticks(x, y, ticks);
+
+    for (i = 0; i < DEPTH; i++)
+    {
+        window_push(&g_window_A, ticks[0] + ((i & 1) ? noise : -noise));
+        window_push(&g_window_B, ticks[1]);
+        window_push(&g_window_C, ticks[2]);
+    }
+}
+
+/**
+*      @brief Function to report a fix and keep the bytes it sent
+*      @return bool true if exactly one frame was sent
+**/
+static bool report(void)
+{
+    g_sent_count = 0;
+    calculate_coordinates(&g_window_A, &g_window_B, &g_window_C);
+    return g_sent_count == FRAME_BYTES;
+}
+
+static int16_t field_int(const uint8_t *frame, uint8_t offset)
+{
+    return (int16_t)(frame[offset] | (frame[offset + 1] << 8));
+}
+
+static uint16_t field_uint(const uint8_t *frame, uint8_t offset)
+{
+    return (uint16_t)(frame[offset] | (frame[offset + 1] << 8));
+}
+
+/**
+*      @brief Function to check the Fletcher-16 of a frame, worked out from its definition
+**/
+static bool checksum_ok(const uint8_t *frame)
+{
+    uint16_t sum1 = 0, sum2 = 0;
+    uint8_t i;
+
+    for (i = 2; i < FRAME_BYTES - 2; i++)
+    {
+        sum1 = (sum1 + frame[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return frame[FRAME_BYTES - 2] == sum1 && frame[FRAME_BYTES - 1] == sum2;
+}
+
+/**
+*      @brief Function to work out the variance of a window in 0.001 mm^2 as commands.c reports it, about the
+*               mean range rounded down to a whole mm
+**/
+static uint16_t expected_variance(const capture_window_t *window)
+{
+    double mean = window->sum / (double)window->filled, total = 0;
+    uint32_t distance = (uint32_t)(mean * CONVERSION_CONSTANT);
+    uint8_t i;
+
+    for (i = 0; i < window->filled; i++)
+    {
+        double error = window_sample(window, i) * CONVERSION_CONSTANT - distance;
+        total += error * error;
+    }
+    return (uint16_t)(total / window->filled * 1000 + 0.5);
+}
+
+int main(void)
+{
+    uint8_t frame[FRAME_BYTES];
+    uint16_t first_variance;
+    uint8_t i, caught;
+    bool pass = true;
+
+    host_boot_geometry();
+    update_solver_constants();
+    set_fix_output(true);
+
+    fill(PEN_X, PEN_Y, 20);
+    pass &= check("one frame per fix", report());
+    for (i = 0; i < FRAME_BYTES; i++)   frame[i] = g_sent[i];
+
+    pass &= check("sync bytes A5 5A", frame[0] == 0xA5 && frame[1] == 0x5A);
+    pass &= check("type 01, payload length 18", frame[2] == 0x01 && frame[3] == 18);
+    pass &= check("checksum matches Fletcher-16", checksum_ok(frame));
+    printf("fix %d, %d mm, residual %d, GDOP %u, variance %u %u %u, samples %u %u %u, flags 0x%02X\n",
+           field_int(frame, 4), field_int(frame, 6), field_int(frame, 8), field_uint(frame, 10),
+           field_uint(frame, 12), field_uint(frame, 14), field_uint(frame, 16), frame[18], frame[19], frame[20], frame[21]);
+    pass &= check("position of the pen", abs(field_int(frame, 4) - PEN_X) <= 1);
+    pass &= check("residual within a mm", abs(field_int(frame, 8)) <= 100);
+    pass &= check("GDOP plausible", field_uint(frame, 10) >= 100 && field_uint(frame, 10) < 1000);
+    pass &= check("variances of the windows of the fix", field_uint(frame, 12) == expected_variance(&g_window_A) &&
+                                                         field_uint(frame, 14) == expected_variance(&g_window_B) &&
+                                                         field_uint(frame, 16) == expected_variance(&g_window_C));
+    pass &= check("samples of the windows", frame[18] == DEPTH && frame[19] == DEPTH && frame[20] == DEPTH);
+    pass &= check("valid flag only", frame[21] == 0x01);
+
+    for (i = 2, caught = 0; i < FRAME_BYTES - 2; i++)                           // Change each byte in turn
+    {
+        frame[i] ^= 0x10;
+        if (!checksum_ok(frame))    caught++;
+        frame[i] ^= 0x10;
+    }
+    pass &= check("every changed byte fails the checksum", caught == FRAME_BYTES - 4);
+
+    first_variance = field_uint(frame, 12);
+    fill(PEN_X, PEN_Y, 40);                                                     // Noisier strokes, no variance command
+    report();
+    pass &= check("new windows, new variance in the frame", field_uint(g_sent, 12) != first_variance &&
+                                                            field_uint(g_sent, 12) == expected_variance(&g_window_A));
+
+    fill(PEN_X, PEN_Y, 400);                                                    // Far too noisy for a fix
+    pass &= check("rejected fix sends a frame", report());
+    pass &= check("rejected fix clears valid and position", g_sent[21] == 0 && field_int(g_sent, 4) == 0 &&
+                                                             field_int(g_sent, 6) == 0 && field_uint(g_sent, 10) == 0);
+    pass &= check("rejected fix checksum matches", checksum_ok(g_sent));
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
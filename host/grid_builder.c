@@ -0,0 +1,427 @@
+/**
+*      @file grid_builder.c
+*      @author Prithvi Bhat
+*      @brief Builds the spatial correction grid from recorded taps and prints the script that uploads it
+*               Each trace line is a tap, "ref_x,ref_y,fix_x,fix_y" in mm: the known position of the pen and
+*               the fix reported for it, recorded with the grid off and the surface mapping cleared. Lines
+*               starting with '#' are skipped. The error of every tap, reference minus fix, is shared out
+*               to the four nodes around the fix with the bilinear weights grid.c interpolates with, and
+*               each node takes the weighted average of its taps. A few passes refit what the
+*               interpolated grid still leaves of the errors, nodes without taps copy the nearest node
+*               that has some. The quantised grid is then run through grid.c to report the error left
+*
+*               -s builds a grid from synthetic taps of a smooth bias field instead, uploads it to grid.c
+*               the way the terminal would and checks the correction
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o grid_builder \
+*                           host/grid_builder.c host/eeprom_host.c grid.c config.c journal.c format.c -lm
+*             Usage:    ./grid_builder -w 300 -h 200 taps.csv > grid.txt      then send grid.txt to the terminal
+*                       ./grid_builder -s
+**/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../grid.h"
+#include "../eeprom.h"
+
+#define MAX_TAPS        65536
+#define REFINE_PASSES   4                       // Refits of the remaining error
+#define MIN_WEIGHT      0.25                    // Node weight below which a node counts as without taps
+#define WORDS_PER_LINE  6                       // Words per "grid data" line
+#define NOISE_MM        0.6                     // Peak to peak fix noise of the synthetic taps
+#define PI              3.14159265358979
+
+/**
+*      @brief One recorded tap
+**/
+typedef struct
+{
+    double ref_x, ref_y;                        // Known pen position
+    double fix_x, fix_y;                        // Reported fix
+} tap_t;
+
+// Global Variables
+static tap_t g_taps[MAX_TAPS];
+static uint32_t g_tap_count = 0;
+static double g_width = 300, g_height = 200;
+static double g_node[GRID_NODES][2];            // Corrections in mm before quantisation
+static uint32_t g_words[GRID_WORDS];
+static uint32_t g_seed = 12345;
+
+void putcUart0(char c)
+{
+    (void)c;
+}
+
+/**
+*      @brief Function to find the node below and left of a fix and the bilinear weights of its cell
+*      @param n set to the node index
+*      @param weight set to the weights of nodes n, n + 1, n + GRID_SIZE and n + GRID_SIZE + 1
+**/
+static void cell(double x, double y, uint16_t *n, double *weight)
+{
+    double u = x * (GRID_SIZE - 1) / g_width, v = y * (GRID_SIZE - 1) / g_height;
+    int32_t i, j;
+
+    if (u < 0)  u = 0;
+    if (v < 0)  v = 0;
+    i = (int32_t)u;
+    j = (int32_t)v;
+    if (i > GRID_SIZE - 2)  i = GRID_SIZE - 2;
+    if (j > GRID_SIZE - 2)  j = GRID_SIZE - 2;
+    u -= i;
+    v -= j;
+    if (u > 1)  u = 1;
+    if (v > 1)  v = 1;
+
+    *n = (uint16_t)(j * GRID_SIZE + i);
+    weight[0] = (1 - u) * (1 - v);
+    weight[1] = u * (1 - v);
+    weight[2] = (1 - u) * v;
+    weight[3] = u * v;
+}
+
+/**
+*      @brief Function to build the grid from the taps and pack it into g_words
+*      @return uint16_t nodes that had no taps of their own
+**/
+static uint16_t build(void)
+{
+    static const uint8_t offset[4] = { 0, 1, GRID_SIZE, GRID_SIZE + 1 };
+    static double sum[GRID_NODES][3];
+    uint16_t n, m, k, empty = 0, source;
+    uint32_t t, pass;
+    double weight[4];
+    int32_t c;
+
+    memset(g_node, 0, sizeof(g_node));
+    for (pass = 0; pass < REFINE_PASSES; pass++)
+    {
+        memset(sum, 0, sizeof(sum));
+        for (t = 0; t < g_tap_count; t++)
+        {
+            const tap_t *tap = &g_taps[t];
+            double ex = tap->ref_x - tap->fix_x, ey = tap->ref_y - tap->fix_y;
+
+            cell(tap->fix_x, tap->fix_y, &n, weight);
+            for (k = 0; k < 4; k++)                                             // Error the grid leaves so far
+            {
+                ex -= weight[k] * g_node[n + offset[k]][0];
+                ey -= weight[k] * g_node[n + offset[k]][1];
+            }
+            for (k = 0; k < 4; k++)
+            {
+                sum[n + offset[k]][0] += weight[k];
+                sum[n + offset[k]][1] += weight[k] * ex;
+                sum[n + offset[k]][2] += weight[k] * ey;
+            }
+        }
+        for (n = 0; n < GRID_NODES; n++)
+        {
+            if (sum[n][0] < MIN_WEIGHT)     continue;
+            g_node[n][0] += sum[n][1] / sum[n][0];
+            g_node[n][1] += sum[n][2] / sum[n][0];
+        }
+    }
+
+    for (n = 0; n < GRID_NODES; n++)                                            // Fill nodes without taps
+    {
+        double nearest = 1e30;
+
+        if (sum[n][0] >= MIN_WEIGHT)    continue;
+        empty++;
+        source = n;
+        for (m = 0; m < GRID_NODES; m++)
+        {
+            double di = (double)(m % GRID_SIZE) - n % GRID_SIZE, dj = (double)(m / GRID_SIZE) - n / GRID_SIZE;
+
+            if (sum[m][0] >= MIN_WEIGHT && di * di + dj * dj < nearest)
+            {
+                nearest = di * di + dj * dj;
+                source = m;
+            }
+        }
+        g_node[n][0] = g_node[source][0];
+        g_node[n][1] = g_node[source][1];
+    }
+
+    for (n = 0; n < GRID_NODES; n += 2)                                         // Quantise and pack
+    {
+        int32_t pair[4];
+
+        for (k = 0; k < 4; k++)
+        {
+            c = (int32_t)lround(g_node[n + k / 2][k % 2] * (1 << GRID_FRACTION));
+            pair[k] = (c < INT8_MIN) ? INT8_MIN : ((c > INT8_MAX) ? INT8_MAX : c);
+        }
+        g_words[n / 2] = GRID_PACK(pair[0], pair[1], pair[2], pair[3]);
+    }
+    return empty;
+}
+
+/**
+*      @brief Function to hand the packed grid to grid.c as "grid load" and "grid data" would
+*      @param crc CRC announced, config_crc32() of the words for a good upload
+**/
+static void upload(uint32_t crc)
+{
+    int32_t line[WORDS_PER_LINE];
+    uint8_t count = 0;
+    uint16_t i;
+
+    grid_upload_begin(crc);
+    for (i = 0; i < GRID_WORDS; i++)
+    {
+        line[count++] = (int32_t)g_words[i];
+        if (count == WORDS_PER_LINE || i == GRID_WORDS - 1)
+        {
+            grid_upload_data(line, count);
+            count = 0;
+        }
+    }
+}
+
+/**
+*      @brief Function to average the distance between the corrected fixes of the taps and their references
+*      @param corrected false for the raw fixes
+**/
+static double mean_error(bool corrected)
+{
+    double total = 0;
+    uint32_t t;
+
+    for (t = 0; t < g_tap_count; t++)
+    {
+        float x = (float)g_taps[t].fix_x, y = (float)g_taps[t].fix_y;
+
+        if (corrected)  grid_apply(&x, &y);
+        total += hypot(x - g_taps[t].ref_x, y - g_taps[t].ref_y);
+    }
+    return (g_tap_count != 0) ? total / g_tap_count : 0;
+}
+
+/**
+*      @brief Function to load the packed grid into an emulated device
+**/
+static void device_load(void)
+{
+    eeprom_host_erase();
+    config_init();
+    grid_load((int32_t)g_width, (int32_t)g_height);
+    upload(config_crc32(g_words, GRID_WORDS));
+}
+
+/**
+*      @brief Function to print the upload script
+**/
+static void print_script(void)
+{
+    uint16_t i;
+
+    printf("grid load 0x%08X\n", config_crc32(g_words, GRID_WORDS));
+    for (i = 0; i < GRID_WORDS; i++)
+    {
+        printf("%s0x%08X", (i % WORDS_PER_LINE == 0) ? "grid data " : " ", g_words[i]);
+        if (i % WORDS_PER_LINE == WORDS_PER_LINE - 1 || i == GRID_WORDS - 1)  printf("\n");
+    }
+}
+
+/**
+*      @brief Synthetic fix bias, smooth over the writing area, in mm
+**/
+static void bias(double x, double y, double *bx, double *by)
+{
+    *bx = 1.2 * sin(2 * PI * x / g_width) * cos(PI * y / g_height) + 0.6 * y / g_height;
+    *by = -0.9 * cos(PI * x / g_width) * sin(2 * PI * y / g_height) + 0.4 * x / g_width;
+}
+
+static double noise(void)
+{
+    g_seed = g_seed * 1664525 + 1013904223;                                     // Numerical Recipes LCG
+    return ((g_seed >> 16) % 1000) * NOISE_MM / 1000 - NOISE_MM / 2;
+}
+
+/**
+*      @brief Function to record synthetic taps, a few per cell over the whole writing area
+**/
+static void synthesise(uint32_t per_cell)
+{
+    uint32_t i, j, k;
+
+    g_tap_count = 0;
+    for (i = 0; i < GRID_SIZE - 1; i++)
+    {
+        for (j = 0; j < GRID_SIZE - 1; j++)
+        {
+            for (k = 0; k < per_cell; k++)
+            {
+                tap_t *tap = &g_taps[g_tap_count++];
+                double bx, by;
+
+                g_seed = g_seed * 1664525 + 1013904223;
+                tap->ref_x = (i + ((g_seed >> 16) % 1000) / 1000.0) * g_width / (GRID_SIZE - 1);
+                g_seed = g_seed * 1664525 + 1013904223;
+                tap->ref_y = (j + ((g_seed >> 16) % 1000) / 1000.0) * g_height / (GRID_SIZE - 1);
+                bias(tap->ref_x, tap->ref_y, &bx, &by);
+                tap->fix_x = tap->ref_x + bx + noise();
+                tap->fix_y = tap->ref_y + by + noise();
+            }
+        }
+    }
+}
+
+/**
+*      @brief Function to build a grid from synthetic taps and check it through grid.c
+**/
+static int self_check(void)
+{
+    double before, after, fresh_before = 0, fresh_after = 0;
+    float x, y;
+    uint32_t i, good_crc;
+    bool pass = true;
+
+    eeprom_host_erase();
+    config_init();
+    grid_load((int32_t)g_width, (int32_t)g_height);
+    x = 100;
+    y = 50;
+    grid_apply(&x, &y);
+    pass &= check("no correction without a grid", x == 100 && y == 50);
+
+    synthesise(20);
+    pass &= check("every node has taps", build() == 0);
+    device_load();
+    pass &= check("upload committed", config_get(GRID_CRC) == config_crc32(g_words, GRID_WORDS) && config_get(GRID_MODE) == 1);
+
+    before = mean_error(false);
+    after = mean_error(true);
+
+    g_seed = 777;                                                               // Fresh taps, not used to build the grid
+    synthesise(4);
+    fresh_before = mean_error(false);
+    fresh_after = mean_error(true);
+    printf("mean fix error of the taps                   %.3f mm raw, %.3f mm corrected\n", before, after);
+    printf("mean fix error of fresh taps                 %.3f mm raw, %.3f mm corrected\n", fresh_before, fresh_after);
+    pass &= check("bias mostly removed", fresh_after < fresh_before / 2 && fresh_after < 0.45);
+
+    x = -50;
+    y = 500;
+    grid_apply(&x, &y);
+    pass &= check("fixes beyond the area use the edge nodes", isfinite(x) && fabsf(x + 50) < 3 && fabsf(y - 500) < 3);
+
+    config_init();                                                              // Reboot
+    grid_load((int32_t)g_width, (int32_t)g_height);
+    pass &= check("grid restored after reboot", fabs(mean_error(true) - fresh_after) < 1e-6);
+
+    good_crc = config_crc32(g_words, GRID_WORDS);
+    g_words[3] ^= 0x00010000;
+    upload(good_crc);
+    g_words[3] ^= 0x00010000;
+    pass &= check("bad CRC keeps the stored grid", fabs(mean_error(true) - fresh_after) < 1e-6);
+
+    grid_enable(false);
+    pass &= check("grid off leaves fixes alone", fabs(mean_error(true) - fresh_before) < 1e-6);
+
+    for (i = 0; i < GRID_WORDS; i++)    writeEeprom(GRID_BASE + i, 0xFFFFFFFF);     // Grid erased under the CRC
+    grid_enable(true);
+    grid_load((int32_t)g_width, (int32_t)g_height);
+    pass &= check("erased grid is not used", fabs(mean_error(true) - fresh_before) < 1e-6);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
+
+/**
+*      @brief Function to read the taps of a trace file
+*      @return bool false if the file cannot be read
+**/
+static bool read_trace(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    uint32_t skipped = 0;
+
+    if (file == NULL)   return false;
+
+    while (fgets(line, sizeof(line), file) != NULL && g_tap_count < MAX_TAPS)
+    {
+        tap_t *tap = &g_taps[g_tap_count];
+
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')   continue;
+        if (sscanf(line, "%lf,%lf,%lf,%lf", &tap->ref_x, &tap->ref_y, &tap->fix_x, &tap->fix_y) == 4)
+        {
+            g_tap_count++;
+        }
+        else
+        {
+            skipped++;
+        }
+    }
+    fclose(file);
+
+    if (skipped != 0)   fprintf(stderr, "%u lines skipped\n", skipped);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t empty;
+    int option;
+
+    while ((option = getopt(argc, argv, "w:h:s")) != -1)
+    {
+        switch (option)
+        {
+            case 'w':
+            {
+                g_width = atof(optarg);
+                break;
+            }
+
+            case 'h':
+            {
+                g_height = atof(optarg);
+                break;
+            }
+
+            case 's':
+            {
+                return self_check();
+            }
+
+            default:
+            {
+                fprintf(stderr, "Usage: %s [-w width_mm] [-h height_mm] taps.csv | -s\n", argv[0]);
+                return 2;
+            }
+        }
+    }
+
+    if (optind >= argc || g_width <= 0 || g_height <= 0)
+    {
+        fprintf(stderr, "Usage: %s [-w width_mm] [-h height_mm] taps.csv | -s\n", argv[0]);
+        return 2;
+    }
+    if (!read_trace(argv[optind]) || g_tap_count == 0)
+    {
+        fprintf(stderr, "No taps read from %s\n", argv[optind]);
+        return 1;
+    }
+
+    empty = build();
+    print_script();
+
+    device_load();
+    fprintf(stderr, "%u taps, %u of %u nodes without taps copied a neighbour\n", g_tap_count, empty, GRID_NODES);
+    fprintf(stderr, "mean fix error %.3f mm raw, %.3f mm corrected\n", mean_error(false), mean_error(true));
+    return 0;
+}
@@ -0,0 +1,240 @@
+/**
+*      @file health_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the channel health and of tracking on two ranges
+*               Strokes heard and missed by each sensor are fed to health_update() in health.c as the watchdog
+*               ISR does. A channel must go down on the HEALTH_MISS_LIMIT missed stroke and not before, come
+*               back on the HEALTH_RECOVER_STROKES good stroke with its bit set in the recovered mask, and go
+*               down on outliers exactly when the running rate, worked out here from its definition, passes
+*               HEALTH_OUTLIER_LIMIT. A pen moving every range at once is no outlier
+*               With each sensor down in turn track_stroke() in commands.c must solve on the other two ranges:
+*               the fix must match the crossing of the two circles worked out here, on the side of the
+*               writing area (y > 0 with A down, x > 0 with C down) before the first fix, and on the side of
+*               the last fix with B down
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -D'_delay_cycles(x)=' -o health_host \
+*                           host/health_host.c host/eeprom_host.c commands.c config.c journal.c format.c minimap.c tone.c window.c surface.c grid.c health.c -lm
+*             Usage:    ./health_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../commands.h"
+#include "../health.h"
+
+#define CONVERSION_CONSTANT 0.008575        // mm per timer tick, matches commands.c
+#define DEPTH               8               // Captures averaged per fix
+#define D1                  200             // Fix frame: B at the origin, A at (0, D1), C at (D2, 0)
+#define D2                  300
+#define OUTLIER_TICKS       6000            // Capture jump of a bad comparator, above HEALTH_JUMP_TICKS
+#define RATE_SMOOTHING      16              // Matches health.c
+#define RATE_ONE            256
+
+// Global Variables
+static capture_window_t g_window_A, g_window_B, g_window_C;
+static char g_printed[512];                 // Text written to the terminal
+static uint16_t g_printed_count = 0;
+
+// Peripheral entry points used by commands.c and health.c
+void putcUart0(char c)
+{
+    if (g_printed_count < sizeof(g_printed) - 1)    g_printed[g_printed_count++] = c;
+    g_printed[g_printed_count] = 0;
+}
+void putsUart0(char *str)                       { for (; *str; str++) putcUart0(*str); }
+void putsLcd(uint8_t row, uint8_t col, const char str[]) { (void)row; (void)col; (void)str; }
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits) { (void)glyph; (void)row; (void)bits; }
+uint32_t timer_ms(void)                         { return 0; }
+void waitMicrosecond(uint32_t us)               { (void)us; }
+
+/**
+*      @brief Function to feed one stroke of a pen at x, y in the fix frame
+*      @param heard bit i set if sensor i heard the stroke
+*      @param jump ticks added to the capture of sensor C, a comparator firing early or late
+*      @return uint8_t the recovered mask of health_update()
+**/
+static uint8_t stroke(int32_t x, int32_t y, uint8_t heard, uint32_t jump)
+{
+    uint32_t ticks[3];
+    bool flags[3];
+    uint8_t i;
+
+    calculate_expected_ticks(x, D1 - y, ticks);                                 // Sensor coordinates, y from A
+    ticks[2] += jump;
+    for (i = 0; i < 3; i++)     flags[i] = (heard >> i) & 1;
+    return health_update(flags, ticks);
+}
+
+/**
+*      @brief Function to fill fresh windows with a pen held at x, y, leaving the window of the sensor down empty
+**/
+static void fill(int32_t x, int32_t y, uint8_t down)
+{
+    capture_window_t *window[3] = { &g_window_A, &g_window_B, &g_window_C };
+    uint32_t ticks[3];
+    uint8_t i, j;
+
+    calculate_expected_ticks(x, D1 - y, ticks);
+    for (i = 0; i < 3; i++)
+    {
+        window_reset(window[i], DEPTH);
+        for (j = 0; j < DEPTH && i != down; j++)    window_push(window[i], ticks[i]);
+    }
+}
+
+/**
+*      @brief Function to take a sensor down with missed strokes, the others hearing a pen at x, y
+**/
+static void take_down(uint8_t down, int32_t x, int32_t y)
+{
+    uint8_t i;
+
+    health_reset();
+    for (i = 0; i < HEALTH_MISS_LIMIT; i++)     stroke(x, y, 0x07 & ~(1 << down), 0);
+}
+
+/**
+*      @brief Function to work out where the circles around the two sensors in use cross
+*               Ranges are taken to whole mm as commands.c does, and of the two crossings the one in the
+*               half plane of the point side_x, side_y is kept
+**/
+static void crossing(uint8_t down, int32_t x, int32_t y, float side_x, float side_y, float *fix_x, float *fix_y)
+{
+    const float sensor_x[3] = { 0, 0, D2 }, sensor_y[3] = { D1, 0, 0 };
+    uint32_t ticks[3];
+    float range[3], ex, ey, spacing, along, across;
+    uint8_t i, p = (down == 0) ? 1 : 0, q = (down == 2) ? 1 : 2;
+
+    calculate_expected_ticks(x, D1 - y, ticks);
+    for (i = 0; i < 3; i++)     range[i] = (float)(uint32_t)(ticks[i] * CONVERSION_CONSTANT);
+
+    ex = sensor_x[q] - sensor_x[p];
+    ey = sensor_y[q] - sensor_y[p];
+    spacing = sqrtf(ex * ex + ey * ey);
+    along = (range[p] * range[p] - range[q] * range[q] + spacing * spacing) / (2 * spacing);
+    across = sqrtf(range[p] * range[p] - along * along);
+
+    *fix_x = sensor_x[p] + (along * ex - across * ey) / spacing;                // Left of p to q
+    *fix_y = sensor_y[p] + (along * ey + across * ex) / spacing;
+    if ((ex * (side_y - sensor_y[p]) - ey * (side_x - sensor_x[p])) < 0)
+    {
+        *fix_x = sensor_x[p] + (along * ex + across * ey) / spacing;            // Right of p to q
+        *fix_y = sensor_y[p] + (along * ey - across * ex) / spacing;
+    }
+}
+
+/**
+*      @brief Function to take a two range fix of a pen at x, y and compare it with the crossing on the side
+*               of side_x, side_y
+**/
+static bool two_range_fix(uint8_t down, int32_t x, int32_t y, float side_x, float side_y, int32_t *fix_x, int32_t *fix_y)
+{
+    float expected_x, expected_y;
+
+    fill(x, y, down);
+    if (!track_stroke(&g_window_A, &g_window_B, &g_window_C, fix_x, fix_y))    return false;
+    crossing(down, x, y, side_x, side_y, &expected_x, &expected_y);
+
+    printf("sensor %c down, pen %d, %d mm, fix %d, %d mm, crossing %.1f, %.1f mm\n",
+           'A' + down, (int)x, (int)y, (int)*fix_x, (int)*fix_y, expected_x, expected_y);
+    return fabsf(*fix_x - expected_x) <= 0.5f && fabsf(*fix_y - expected_y) <= 0.5f;
+}
+
+int main(void)
+{
+    int32_t rate = 0, fix_x, fix_y;
+    uint8_t i, recovered, down_at = 0, recovered_at = 0, model_down_at = 0, model_recovered_at = 0;
+    char expected[64];
+    bool pass = true;
+
+    host_boot_geometry();
+    update_solver_constants();
+
+    // Missed strokes
+    health_reset();
+    for (i = 0; i < 10; i++)    stroke(150, 100, 0x07, 0);
+    pass &= check("steady strokes leave every sensor up", health_down_count() == 0 && !health_changed());
+
+    for (i = 1; i < HEALTH_MISS_LIMIT; i++)     stroke(150, 100, 0x06, 0);
+    pass &= check("sensor A up until the miss limit", health_up(0) && !health_changed());
+    stroke(150, 100, 0x06, 0);
+    pass &= check("sensor A down on the miss limit", !health_up(0) && health_down_channel() == 0 &&
+                                                     health_down_count() == 1);
+    pass &= check("change reported once", health_changed() && !health_changed());
+
+    for (i = 1, recovered = 0; i < HEALTH_RECOVER_STROKES; i++)     recovered |= stroke(150, 100, 0x07, 0);
+    pass &= check("sensor A down until the recover count", recovered == 0 && !health_up(0));
+    recovered = stroke(150, 100, 0x07, 0);
+    pass &= check("sensor A back with its recovered bit", recovered == 0x01 && health_up(0) && health_changed());
+
+    // Outliers
+    health_reset();
+    stroke(150, 100, 0x07, 0);
+    for (i = 1; i <= 40 && !down_at; i++)                                       // Sensor C jumps every stroke
+    {
+        stroke(150, 100, 0x07, (i & 1) ? OUTLIER_TICKS : 0);
+        rate += (RATE_ONE - rate) / RATE_SMOOTHING;
+        if (!model_down_at && rate > HEALTH_OUTLIER_LIMIT)  model_down_at = i;
+        if (!health_up(2))  down_at = i;
+    }
+    printf("outliers: sensor C down on stroke %u, rate %d/256\n", down_at, (int)rate);
+    pass &= check("sensor C down when the rate passes the limit", down_at == model_down_at && down_at > 1 &&
+                                                                   health_up(0) && health_up(1));
+
+    g_printed_count = 0;
+    health_print();
+    sprintf(expected, "Sensor C down, missed 0 in a row, outliers %d%%", (int)((rate * 100 + RATE_ONE / 2) / RATE_ONE));
+    pass &= check("rate reported by health", strstr(g_printed, expected) != NULL);
+
+    for (i = 1; i <= 60 && !recovered_at; i++)                                  // Comparator settles where it was
+    {
+        recovered = stroke(150, 100, 0x07, (down_at & 1) ? OUTLIER_TICKS : 0);
+        rate += (0 - rate) / RATE_SMOOTHING;
+        if (!model_recovered_at && i >= HEALTH_RECOVER_STROKES && rate < HEALTH_RECOVER_RATE)  model_recovered_at = i;
+        if (recovered == 0x04)  recovered_at = i;
+    }
+    printf("outliers: sensor C back on stroke %u, rate %d/256\n", recovered_at, (int)rate);
+    pass &= check("sensor C back when the rate decays", recovered_at == model_recovered_at &&
+                                                        recovered_at > HEALTH_RECOVER_STROKES && health_up(2));
+
+    health_reset();
+    for (i = 0; i < 20; i++)    stroke((i & 1) ? 50 : 250, (i & 1) ? 150 : 50, 0x07, 0);   // Pen lifted and set down
+    pass &= check("pen moving every range is no outlier", health_down_count() == 0);
+
+    // Two ranges
+    take_down(0, 150, 50);                                                      // No fix yet, writing area side
+    pass &= check("A down, fix on the crossing with y > 0", two_range_fix(0, 150, 50, 0, D1, &fix_x, &fix_y) &&
+                                                             fix_y > 0);
+    pass &= check("A down, fix on the pen", abs(fix_x - 150) <= 2 && abs(fix_y - 50) <= 2);
+
+    take_down(2, 60, 120);
+    pass &= check("C down, fix on the crossing with x > 0", two_range_fix(2, 60, 120, D2, 0, &fix_x, &fix_y) &&
+                                                             fix_x > 0);
+    pass &= check("C down, fix on the pen", abs(fix_x - 60) <= 2 && abs(fix_y - 120) <= 2);
+
+    take_down(1, 100, 60);                                                      // Last fix on the side of B
+    pass &= check("B down, fix on the side of B", two_range_fix(1, 100, 60, 0, 0, &fix_x, &fix_y));
+    pass &= check("B down, fix on the pen", abs(fix_x - 100) <= 2 && abs(fix_y - 60) <= 2);
+
+    health_reset();                                                             // Three range fix beyond A to C
+    fill(250, 150, HEALTH_NONE);
+    track_stroke(&g_window_A, &g_window_B, &g_window_C, &fix_x, &fix_y);
+    take_down(1, 250, 150);
+    pass &= check("B down, fix on the side of the last fix", two_range_fix(1, 250, 150, 250, 150, &fix_x, &fix_y));
+    pass &= check("B down, not mirrored onto B", abs(fix_x - 250) <= 2 && abs(fix_y - 150) <= 2);
+
+    take_down(0, 150, 100);
+    for (i = 0; i < HEALTH_MISS_LIMIT; i++)     stroke(150, 100, 0x04, 0);  // B misses as well
+    fill(150, 100, 0);
+    pass &= check("two sensors down, no fix", health_down_count() == 2 &&
+                                              !track_stroke(&g_window_A, &g_window_B, &g_window_C, &fix_x, &fix_y));
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
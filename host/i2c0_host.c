@@ -0,0 +1,364 @@
+/**
+*      @file i2c0_host.c
+*      @author Prithvi Bhat
+*      @brief Host model of the I2C0 master checking the transaction queue, the LCD byte sequences, the
+*             traffic of the LCD shadow refresh and the pen trail map
+*               i2c0.c and i2c0_lcd.c are compiled in with their registers replaced by host variables.
+*               Each command written to I2C0_MCS_R is carried out the next time the firmware reads
+*               I2C0_MRIS_R or the model services the interrupt, and every START, address, data byte and
+*               STOP is recorded so the bus traffic can be compared with what the LCD expects
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -D'_delay_cycles(x)=' -o i2c0_host host/i2c0_host.c minimap.c format.c
+*             Usage:    ./i2c0_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../tm4c123gh6pm.h"
+#include "../gpio.h"
+
+#undef SYSCTL_RCGCI2C_R
+#undef I2C0_MSA_R
+#undef I2C0_MCS_R
+#undef I2C0_MDR_R
+#undef I2C0_MTPR_R
+#undef I2C0_MIMR_R
+#undef I2C0_MRIS_R
+#undef I2C0_MICR_R
+#undef I2C0_MCR_R
+
+#define SYSCTL_RCGCI2C_R        g_rcgci2c
+#define I2C0_MSA_R              g_msa
+#define I2C0_MCS_R              g_mcs
+#define I2C0_MDR_R              g_mdr
+#define I2C0_MTPR_R             g_mtpr
+#define I2C0_MIMR_R             g_mimr
+#define I2C0_MRIS_R             i2c0_host_mris()
+#define I2C0_MICR_R             g_micr
+#define I2C0_MCR_R              g_mcr
+
+#define STATUS                  0x80000000              // Marks g_mcs as status, firmware commands never set it
+#define LOG_SIZE                4096
+#define EVENT_START             0x100
+#define EVENT_STOP              0x200
+
+// Global Variables
+static volatile uint32_t g_rcgci2c, g_msa, g_mcs = STATUS, g_mdr, g_mtpr, g_mimr, g_micr, g_mcr, g_ris;
+static uint16_t g_log[LOG_SIZE];                        // EVENT_START | address, data bytes, EVENT_STOP
+static uint16_t g_log_length = 0;
+static uint16_t g_nack_at = 0;                          // Log length at which the next byte is not acknowledged
+static bool g_in_transaction = false;
+static bool g_nested = false;
+
+static uint32_t i2c0_host_mris(void);
+
+void enablePort(PORT port)                                      { (void)port; }
+void selectPinPushPullOutput(PORT port, uint8_t pin)            { (void)port; (void)pin; }
+void selectPinOpenDrainOutput(PORT port, uint8_t pin)           { (void)port; (void)pin; }
+void setPinAuxFunction(PORT port, uint8_t pin, uint32_t fn)     { (void)port; (void)pin; (void)fn; }
+void enableNvicInterrupt(uint8_t vectorNumber)                  { (void)vectorNumber; }
+void waitMicrosecond(uint32_t us)                               { (void)us; }
+
+#include "../i2c0.c"
+#include "../i2c0_lcd.c"
+#include "../minimap.h"
+#include "eeprom_host.h"
+
+static void log_event(uint16_t event)
+{
+    if (g_log_length < LOG_SIZE)    g_log[g_log_length++] = event;
+}
+
+/**
+*      @brief Function to carry out a command waiting in I2C0_MCS_R, as the controller would
+**/
+static void i2c0_host_step(void)
+{
+    uint32_t command = g_mcs, status = 0;
+
+    if (g_micr & I2C_MICR_IC)   g_ris = g_micr = 0;
+    if (command & STATUS)       return;
+
+    if (command & I2C_MCS_RUN)
+    {
+        if (command & I2C_MCS_START)
+        {
+            if (g_in_transaction)   g_nested = true;            // Repeated start, never used for writes here
+            log_event(EVENT_START | (g_msa >> 1));
+            g_in_transaction = true;
+        }
+        if (g_in_transaction && g_nack_at != 0 && g_log_length >= g_nack_at)
+        {
+            status |= I2C_MCS_ERROR | I2C_MCS_DATACK;           // Byte lost, controller holds the bus
+            g_nack_at = 0;
+        }
+        else    log_event(g_mdr & 0xFF);
+    }
+    if ((command & I2C_MCS_STOP) && g_in_transaction)
+    {
+        log_event(EVENT_STOP);
+        g_in_transaction = false;
+    }
+    g_mcs = STATUS | status;
+    g_ris = I2C_MRIS_RIS;
+}
+
+static uint32_t i2c0_host_mris(void)
+{
+    i2c0_host_step();
+    return g_ris;
+}
+
+/**
+*      @brief Function to take up to count interrupts, as many as the queue needs if count is 0
+*      @return uint32_t interrupts taken
+**/
+static uint32_t i2c0_host_service(uint32_t count)
+{
+    uint32_t taken = 0;
+
+    while ((g_mimr & I2C_MIMR_IM) && (count == 0 || taken < count))
+    {
+        i2c0_host_step();
+        if (!g_ris)     break;
+        i2c0Isr();
+        taken++;
+    }
+    return taken;
+}
+
+// Glyph rows written in the log, counted by lcd_traffic()
+static uint32_t g_glyph_rows = 0;
+
+// Completion callback bookkeeping
+static uint32_t g_completed = 0, g_failed = 0;
+
+static void count_completion(bool success)
+{
+    if (success)    g_completed++;
+    else            g_failed++;
+}
+
+/**
+*      @brief Function to append the 4 PCF8574 bytes an LCD byte should produce
+**/
+static uint16_t expect_lcd_byte(uint16_t *expect, uint16_t length, uint8_t data, uint8_t flags)
+{
+    expect[length++] = (data & 0xF0) | LCD_E | flags | LCD_BACKLIGHT;
+    expect[length++] = (data & 0xF0) | flags | LCD_BACKLIGHT;
+    expect[length++] = ((data << 4) & 0xFF) | LCD_E | flags | LCD_BACKLIGHT;
+    expect[length++] = ((data << 4) & 0xFF) | flags | LCD_BACKLIGHT;
+    return length;
+}
+
+/**
+*      @brief Function to count the LCD transactions, commands, characters and glyph rows in the bus log
+*      @return uint32_t bit times on the bus, 9 per byte including the address and 1 each for START and STOP
+**/
+static uint32_t lcd_traffic(uint32_t *transactions, uint32_t *commands, uint32_t *characters)
+{
+    uint32_t bits = 0;
+    uint16_t i, n = 0;
+    uint8_t data = 0;
+    bool cgram = false;
+
+    *transactions = *commands = *characters = g_glyph_rows = 0;
+    for (i = 0; i < g_log_length; i++)
+    {
+        if (g_log[i] & EVENT_START)
+        {
+            (*transactions)++;
+            bits += 1 + 9;
+            n = 0;
+        }
+        else if (g_log[i] & EVENT_STOP)     bits += 1;
+        else
+        {
+            if (n % 4 == 0)     data = g_log[i] & 0xF0;
+            if (n % 4 == 2)     data |= (g_log[i] >> 4) & 0x0F;
+            if (n++ % 4 == 3)
+            {
+                if (!(g_log[i] & LCD_RS))
+                {
+                    (*commands)++;
+                    if (data & 0xC0)    cgram = !(data & 0x80);         // Set CGRAM or DDRAM address
+                }
+                else if (cgram)     g_glyph_rows++;
+                else                (*characters)++;
+            }
+            bits += 9;
+        }
+    }
+    return bits;
+}
+
+int main(void)
+{
+    static uint16_t expect[LOG_SIZE];
+    uint16_t length = 0, i;
+    uint32_t accepted = 0, transactions, commands, characters, bits;
+    uint8_t bytes[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    bool pass = true;
+
+    // Speed is chosen at init
+    initI2c0(I2C0_STANDARD);
+    pass &= check("standard mode timer period", g_mtpr == 19);
+
+    // Reset nibble is written directly, the configuration commands are queued as one burst and left pending
+    initLcd(I2C0_FAST);
+    pass &= check("fast mode timer period", g_mtpr == 4);
+    pass &= check("init leaves commands queued", getI2c0QueueDepth() == 1 && g_log_length == 4);
+    i2c0_host_service(0);
+    expect[length++] = EVENT_START | LCD_ADD;
+    expect[length++] = 0x20 | LCD_E;
+    expect[length++] = 0x20;
+    expect[length++] = EVENT_STOP;
+    expect[length++] = EVENT_START | LCD_ADD;
+    length = expect_lcd_byte(expect, length, 0x28, 0);
+    length = expect_lcd_byte(expect, length, 0x0C, 0);
+    length = expect_lcd_byte(expect, length, 0x06, 0);
+    expect[length++] = EVENT_STOP;
+    pass &= check("init byte sequence", g_log_length == length && memcmp(g_log, expect, length * 2) == 0);
+    pass &= check("queue idle after init", isI2c0QueueIdle() && g_mimr == 0);
+
+    // First refresh clears every cell, a little at a time so the queue keeps room for others
+    g_log_length = length = 0;
+    setLcdRefreshRate(10);
+    pass &= check("refresh waits for its period", !refreshLcd(50));
+    while (refreshLcd(100))
+    {
+        pass &= getI2c0QueuedBytes() < LCD_QUEUE_BUDGET + LCD_BURST_BYTES;
+        i2c0_host_service(0);
+    }
+    bits = lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("first refresh writes all cells and glyphs", characters == LCD_ROWS * LCD_COLS && commands == 3 &&
+                  g_glyph_rows == LCD_GLYPHS * LCD_GLYPH_ROWS);
+    pass &= check("refresh stays within its queue budget", pass);
+    pass &= check("cells sent in bursts of a row or more", transactions <= 10);
+    printf("\nfull screen refresh, bursts     %u bit times, %u us at 400 kHz\n", bits, bits * 10 / 4);
+    printf("one write per PCF8574 byte      %u bit times, %u us at 100 kHz\n\n",
+           (characters + g_glyph_rows + commands) * 4 * 20, (characters + g_glyph_rows + commands) * 4 * 20 * 10);
+
+    // putsLcd only touches the shadow, the refresh sends it
+    g_log_length = 0;
+    putsLcd(2, 3, "X: 12.5");
+    pass &= check("putsLcd does not touch the bus", g_log_length == 0 && isI2c0QueueIdle());
+    refreshLcd(200);
+    i2c0_host_service(0);
+    expect[length++] = EVENT_START | LCD_ADD;
+    length = expect_lcd_byte(expect, length, 0x80 + 20 + 3, 0);
+    length = expect_lcd_byte(expect, length, 'X', LCD_RS);
+    length = expect_lcd_byte(expect, length, ':', LCD_RS);
+    expect[length++] = EVENT_STOP;
+    expect[length++] = EVENT_START | LCD_ADD;
+    length = expect_lcd_byte(expect, length, 0x80 + 20 + 6, 0);       // The space is already on the display
+    for (i = 3; i < 7; i++)     length = expect_lcd_byte(expect, length, "X: 12.5"[i], LCD_RS);
+    expect[length++] = EVENT_STOP;
+    pass &= check("refresh byte sequence", g_log_length == length && memcmp(g_log, expect, length * 2) == 0);
+
+    // One changed digit costs one cursor move and one character, no sooner than the refresh period
+    g_log_length = 0;
+    putsLcd(2, 3, "X: 12.6");
+    pass &= check("refresh rate is capped", !refreshLcd(250) && g_log_length == 0);
+    refreshLcd(300);
+    i2c0_host_service(0);
+    lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("single changed cell", transactions == 1 && commands == 1 && characters == 1);
+
+    // Unchanged text costs nothing, cells running on from row 0 into row 2 need no cursor move
+    g_log_length = 0;
+    putsLcd(2, 3, "X: 12.6");
+    pass &= check("unchanged text sends nothing", !refreshLcd(400) && g_log_length == 0);
+    putsLcd(0, 19, "a");
+    putsLcd(2, 0, "b");
+    refreshLcd(500);
+    i2c0_host_service(0);
+    lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("row 0 runs on into row 2", transactions == 1 && commands == 1 && characters == 2);
+
+    // A changed glyph row costs one CGRAM address and one byte, and the next cell needs a DDRAM address again
+    g_log_length = 0;
+    setLcdGlyphRow(3, 5, 0x11);
+    setLcdGlyphRow(3, 5, 0x11);
+    putsLcd(2, 4, "x");
+    refreshLcd(600);
+    i2c0_host_service(0);
+    lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("single changed glyph row", g_glyph_rows == 1 && commands == 2 && characters == 1);
+    pass &= check("glyph row address", g_log[1] == (((0x40 | (3 * 8 + 5)) & 0xF0) | LCD_E | LCD_BACKLIGHT));
+
+    // The map shares the display, one fix costs at most two glyph rows plus the changed status cells
+    minimap_set_area(300, 200);
+    minimap_enable(true);
+    refreshLcd(700);
+    i2c0_host_service(0);
+    pass &= check("map glyphs placed", lcdScreen[0][16] == LCD_GLYPH_CODE && lcdScreen[1][19] == LCD_GLYPH_CODE + 7);
+    g_log_length = 0;
+    minimap_add_fix(150, 100, 700);
+    refreshLcd(800);
+    i2c0_host_service(0);
+    lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("first fix lights one pixel", g_glyph_rows == 1 && lcdGlyph[2 + 4 * 0][7] == 0x01 << 4);
+    g_log_length = 0;
+    minimap_add_fix(151, 101, 800);
+    refreshLcd(900);
+    i2c0_host_service(0);
+    lcd_traffic(&transactions, &commands, &characters);
+    pass &= check("fix on a lit pixel uploads no glyph", g_glyph_rows == 0 && characters != 0);
+    for (i = 0; i < MINIMAP_TRAIL; i++)     minimap_add_fix(0, 0, 1000 + i * 100);
+    refreshLcd(5000);
+    i2c0_host_service(0);
+    pass &= check("trail forgets old fixes", lcdGlyph[2][7] == 0 && lcdGlyph[4][7] == 0x10);
+    pass &= check("rate and quality line", memcmp(lcdScreen[MINIMAP_STATUS_ROW], "10.0Hz Q 100%       ", LCD_COLS) == 0);
+    minimap_add_miss();
+    minimap_enable(false);
+    refreshLcd(6000);
+    i2c0_host_service(0);
+    pass &= check("map hides cleanly", lcdScreen[0][16] == ' ' && lcdScreen[MINIMAP_STATUS_ROW][0] == ' ');
+
+    // Transactions complete in order, each with its callback, while more are being queued
+    g_log_length = 0;
+    g_completed = g_failed = 0;
+    for (i = 0; i < 10; i++)
+    {
+        queueI2c0Write(0x10 + i, bytes, 1 + i % 8, count_completion);
+        i2c0_host_service(3);
+    }
+    i2c0_host_service(0);
+    for (i = 0, length = 0; i < g_log_length; i++)                 // Starts must name 0x10, 0x11, ... in turn
+    {
+        if (g_log[i] & EVENT_START)     length += (g_log[i] == (EVENT_START | (0x10 + length)));
+    }
+    pass &= check("completion order and callbacks", g_completed == 10 && g_failed == 0 && length == 10);
+    pass &= check("no repeated starts", !g_nested && !g_in_transaction);
+
+    // A full queue refuses transactions without losing the ones already accepted
+    g_log_length = 0;
+    g_completed = 0;
+    while (queueI2c0Write(0x20, bytes, 8, count_completion))    accepted++;
+    pass &= check("queue refuses when full", accepted == QUEUE_BYTES / 8);
+    i2c0_host_service(0);
+    pass &= check("full queue drains", g_completed == accepted && isI2c0QueueIdle());
+    pass &= check("byte ring wraps cleanly", queueI2c0Write(0x21, bytes, 8, count_completion) && i2c0_host_service(0) == 8);
+
+    // A byte that is not acknowledged fails its transaction, releases the bus and the queue moves on
+    g_log_length = 0;
+    g_completed = g_failed = 0;
+    g_nack_at = 3;                                              // Second data byte of the first write
+    queueI2c0Write(0x30, bytes, 4, count_completion);
+    queueI2c0Write(0x31, bytes, 2, count_completion);
+    i2c0_host_service(0);
+    pass &= check("error fails only its transaction", g_failed == 1 && g_completed == 1);
+    pass &= check("bus released after error", !g_in_transaction && g_log[3] == EVENT_STOP);
+    pass &= check("next transaction sent whole", g_log_length == 8 && g_log[4] == (EVENT_START | 0x31) && g_log[7] == EVENT_STOP);
+
+    // Blocking calls still work once the queue is idle
+    g_log_length = 0;
+    writeI2c0Registers(0x40, 0x05, bytes, 2);
+    pass &= check("blocking write after queue use", g_log_length == 5 && g_log[1] == 0x05 && g_log[4] == EVENT_STOP);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
@@ -0,0 +1,79 @@
+/**
+*      @file journal_wear.c
+*      @author Prithvi Bhat
+*      @brief Host wear model for the EEPROM journal
+*               Drives config.c and journal.c against host/eeprom_host.c with a stream of fix offset and
+*               averaging updates, rebooting every so often to check that the journal rebuilds the latest
+*               values, then reports the write count of the most worn word
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o journal_wear \
+*                           host/journal_wear.c host/eeprom_host.c config.c journal.c format.c
+*             Usage:    ./journal_wear [updates] [updates per background compaction step]
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../journal.h"
+
+#define REBOOT_INTERVAL 997                 // Updates between simulated resets
+#define AVERAGE_LIMIT   10                  // Matches MAX_AVERAGES
+
+void putcUart0(char c)
+{
+    (void)c;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t updates = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+    uint32_t service = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    uint32_t i, fix_x = 0, fix_y = 0, average = 1, reboots = 0, scan_reads = 0, errors = 0;
+
+    host_boot_geometry();
+    eeprom_host_clear_counts();
+
+    for (i = 1; i <= updates; i++)
+    {
+        fix_x = (i * 7) % 41;
+        fix_y = (i * 13) % 37;
+        config_set(FIX_X, fix_x);
+        config_set(FIX_Y, fix_y);
+        if (i % 10 == 0)
+        {
+            average = 1 + i / 10 % AVERAGE_LIMIT;
+            config_set(TC_AVG, average);
+        }
+        config_flush();
+
+        if (service != 0 && i % service == 0)   journal_service();
+
+        if (i % REBOOT_INTERVAL == 0)
+        {
+            uint32_t reads = eeprom_host_reads();
+
+            journal_init();                                                 // Boot scan on its own
+            if (eeprom_host_reads() - reads > scan_reads)     scan_reads = eeprom_host_reads() - reads;
+
+            config_init();
+            reboots++;
+            if (config_get(FIX_X) != fix_x || config_get(FIX_Y) != fix_y || config_get(TC_AVG) != average ||
+                config_get(CRD_CX) != 300 || config_status() != CONFIG_OK)
+            {
+                errors++;
+            }
+        }
+    }
+
+    printf("updates                     %u\n", updates);
+    printf("reboots checked             %u, mismatches %u\n", reboots, errors);
+    printf("journal writes              %u over %u words\n", eeprom_host_sum_writes(JOURNAL_BASE, JOURNAL_WORDS), JOURNAL_WORDS);
+    printf("most worn journal word      %u writes\n", eeprom_host_max_writes(JOURNAL_BASE, JOURNAL_WORDS));
+    printf("most worn image word        %u writes\n", eeprom_host_max_writes(0, CONFIG_IMAGE_WORDS));
+    printf("fixed slot equivalent       %u writes to FIX_X\n", updates);
+    printf("boot scan                   %u reads at most\n", scan_reads);
+
+    return errors != 0;
+}
@@ -0,0 +1,84 @@
+/**
+*      @file spsc_queue.h
+*      @author Prithvi Bhat
+*      @brief Lock-free single producer / single consumer queue for host tools
+*               The producer only ever writes head and the consumer only ever writes tail, so the two
+*               sides never contend on the same cache line and no lock is required
+**/
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SPSC_CACHE_LINE     64
+
+typedef struct
+{
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;       // Next slot to be written (producer owned)
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;       // Next slot to be read (consumer owned)
+    _Alignas(SPSC_CACHE_LINE) size_t capacity;          // Number of slots, must be a power of two
+    size_t element_size;                                // Size of one element in bytes
+    uint8_t *storage;                                   // capacity * element_size bytes
+} spsc_queue_t;
+
+/**
+*      @brief Function to initialise a queue over caller provided storage
+*      @param queue Pointer to queue structure
+*      @param storage Backing storage of capacity * element_size bytes
+*      @param capacity Number of slots (power of two)
+*      @param element_size Size of one element
+**/
+static inline void spsc_init(spsc_queue_t *queue, void *storage, size_t capacity, size_t element_size)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->capacity = capacity;
+    queue->element_size = element_size;
+    queue->storage = storage;
+}
+
+/**
+*      @brief Function to push one element (producer side only)
+*      @return true if pushed, false if queue is full
+**/
+static inline bool spsc_push(spsc_queue_t *queue, const void *element)
+{
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail >= queue->capacity)     return false;
+
+    memcpy(&queue->storage[(head & (queue->capacity - 1)) * queue->element_size], element, queue->element_size);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+*      @brief Function to pop one element (consumer side only)
+*      @return true if an element was copied out, false if queue is empty
+**/
+static inline bool spsc_pop(spsc_queue_t *queue, void *element)
+{
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail)                       return false;
+
+    memcpy(element, &queue->storage[(tail & (queue->capacity - 1)) * queue->element_size], queue->element_size);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/**
+*      @brief Function to read the number of queued elements (approximate when called concurrently)
+**/
+static inline size_t spsc_depth(spsc_queue_t *queue)
+{
+    return atomic_load_explicit(&queue->head, memory_order_acquire) - atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
+
+#endif
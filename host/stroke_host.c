@@ -0,0 +1,111 @@
+/**
+*      @file stroke_host.c
+*      @author Prithvi Bhat
+*      @brief Host check that every stroke gives a fresh averaged fix
+*               Strokes of a synthetic pen are slid through the capture windows as the watchdog ISR does,
+*               and track_stroke() in commands.c is run after each one as the main loop does. A pen moving
+*               along x must move the fix on every stroke once the window holds only moving strokes (before
+*               that the fix moves by less than the whole mm ranges resolve), trailing the pen by half the
+*               window, and a pen held still must settle on the fix a fresh window gives there
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -D'_delay_cycles(x)=' -o stroke_host \
+*                           host/stroke_host.c host/eeprom_host.c commands.c config.c journal.c format.c minimap.c tone.c window.c surface.c grid.c health.c -lm
+*             Usage:    ./stroke_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../commands.h"
+
+#define DEPTH           4                   // Captures averaged per fix
+#define STEP_MM         2                   // Pen travel per stroke
+#define STROKES         20                  // Strokes of the moving pen
+#define START_X         100                 // Pen start, frame of the sensor coordinates
+#define START_Y         120
+
+// Global Variables
+static capture_window_t g_window_A, g_window_B, g_window_C;
+
+// Peripheral entry points used by commands.c
+void putcUart0(char c)                          { (void)c; }
+void putsUart0(char *str)                       { (void)str; }
+void putsLcd(uint8_t row, uint8_t col, const char str[]) { (void)row; (void)col; (void)str; }
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits) { (void)glyph; (void)row; (void)bits; }
+uint32_t timer_ms(void)                         { return 0; }
+void waitMicrosecond(uint32_t us)               { (void)us; }
+
+/**
+*      @brief Function to slide one stroke of a pen at x, y through the windows
+**/
+static void stroke(int32_t x, int32_t y)
+{
+    uint32_t ticks[3];
+
+    calculate_expected_ticks(x, y, ticks);
+    window_push(&g_window_A, ticks[0]);
+    window_push(&g_window_B, ticks[1]);
+    window_push(&g_window_C, ticks[2]);
+}
+
+/**
+*      @brief Function to fill fresh windows with a pen held at x, y and take the fix
+**/
+static bool held_fix(int32_t x, int32_t y, int32_t *fix_x, int32_t *fix_y)
+{
+    uint8_t i;
+
+    window_reset(&g_window_A, DEPTH);
+    window_reset(&g_window_B, DEPTH);
+    window_reset(&g_window_C, DEPTH);
+    for (i = 0; i < DEPTH; i++)     stroke(x, y);
+
+    return track_stroke(&g_window_A, &g_window_B, &g_window_C, fix_x, fix_y);
+}
+
+int main(void)
+{
+    int32_t fix_x = 0, fix_y = 0, last_x, last_y, still_x, still_y, pen_x = START_X;
+    uint8_t i, fixes = 0, moved = 0;
+    bool pass = true;
+
+    host_boot_geometry();
+    update_solver_constants();
+
+    pass &= check("fix from a pen held still", held_fix(START_X, START_Y, &fix_x, &fix_y));
+    pass &= check("fix on the pen", abs(fix_x - START_X) <= 1);
+
+    for (i = 0; i < STROKES; i++)                                               // Pen moving along x
+    {
+        last_x = fix_x;
+        last_y = fix_y;
+        pen_x += STEP_MM;
+        stroke(pen_x, START_Y);
+
+        if (!track_stroke(&g_window_A, &g_window_B, &g_window_C, &fix_x, &fix_y))   continue;
+        fixes++;
+        if (i < DEPTH)  continue;                                               // Still holding strokes of the pen at rest,
+                                                                                // moves below the whole mm ranges
+        if (fix_x > last_x)     moved++;
+        if (abs(fix_y - last_y) > 1)    moved = 0;                              // Sideways jump
+    }
+    printf("moving pen: %u fixes and %u moves in %u strokes, fix %d mm behind the pen\n",
+           fixes, moved, STROKES, (int)(pen_x - fix_x));
+    pass &= check("a fix for every stroke", fixes == STROKES);
+    pass &= check("every stroke moves the fix", moved == STROKES - DEPTH);
+    pass &= check("fix trails the pen by half the window", abs(pen_x - fix_x - (DEPTH - 1) * STEP_MM / 2) <= 1);
+
+    for (i = 0; i < DEPTH; i++)                                                 // Pen stops
+    {
+        stroke(pen_x, START_Y);
+        track_stroke(&g_window_A, &g_window_B, &g_window_C, &fix_x, &fix_y);
+    }
+    held_fix(pen_x, START_Y, &still_x, &still_y);
+    pass &= check("stopped pen settles on the held fix", fix_x == still_x && fix_y == still_y);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
@@ -0,0 +1,154 @@
+/**
+*      @file surface_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the surface homography
+*               Reference points on a rotated, skewed and tilted surface are tapped with and without fix
+*               noise, and surface.c has to fit a mapping that takes fixes anywhere on the writing area to
+*               surface coordinates. Refused fits, the identity default and storage are checked as well
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o surface_host \
+*                           host/surface_host.c host/eeprom_host.c surface.c config.c journal.c format.c -lm
+*             Usage:    ./surface_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../surface.h"
+
+#define NOISE_MM        0.5                     // Peak to peak fix noise of a noisy tap
+
+// Mounting to surface mapping: a few degrees of rotation, some skew, scale to screen pixels and a slight tilt
+static const double g_truth[9] = { 6.35, 0.42, 80.0, -0.31, 6.52, 40.0, 0.00021, -0.00013, 1 };
+
+// Global Variables
+static uint32_t g_seed = 12345;
+
+void putcUart0(char c)
+{
+    (void)c;
+}
+
+/**
+*      @brief Function to map a fix with the true mapping
+**/
+static void truth(double x, double y, double *u, double *v)
+{
+    double w = g_truth[6] * x + g_truth[7] * y + g_truth[8];
+
+    *u = (g_truth[0] * x + g_truth[1] * y + g_truth[2]) / w;
+    *v = (g_truth[3] * x + g_truth[4] * y + g_truth[5]) / w;
+}
+
+/**
+*      @brief Function to tap the reference point seen at fix x, y
+**/
+static void tap(double x, double y, bool noisy)
+{
+    double u, v;
+
+    truth(x, y, &u, &v);
+    if (noisy)
+    {
+        g_seed = g_seed * 1664525 + 1013904223;                                 // Numerical Recipes LCG
+        x += ((g_seed >> 16) % 1000) * NOISE_MM / 1000 - NOISE_MM / 2;
+        g_seed = g_seed * 1664525 + 1013904223;
+        y += ((g_seed >> 16) % 1000) * NOISE_MM / 1000 - NOISE_MM / 2;
+    }
+    surface_tap((float)x, (float)y, (int32_t)lround(u), (int32_t)lround(v));
+}
+
+/**
+*      @brief Function to find the worst mapping error over the writing area
+*      @return double largest distance from the true surface point, in surface units
+**/
+static double worst_error(void)
+{
+    double worst = 0, u, v;
+    int32_t x, y;
+
+    for (x = 10; x <= 290; x += 20)
+    {
+        for (y = 10; y <= 190; y += 20)
+        {
+            float fx = (float)x, fy = (float)y;
+
+            surface_apply(&fx, &fy);
+            truth(x, y, &u, &v);
+            u = hypot(fx - u, fy - v);
+            if (u > worst)  worst = u;
+        }
+    }
+    return worst;
+}
+
+int main(void)
+{
+    static const double corners[][2] = { { 20, 20 }, { 280, 20 }, { 280, 180 }, { 20, 180 } };
+    float x = 123.4f, y = 56.7f;
+    double exact, noisy;
+    uint8_t i, j;
+    bool pass = true;
+
+    eeprom_host_erase();
+    config_init();
+    surface_load();
+
+    surface_apply(&x, &y);
+    pass &= check("identity by default", x == 123.4f && y == 56.7f);
+
+    // Too few points, and points on one line, are refused
+    for (i = 0; i < 3; i++)     tap(corners[i][0], corners[i][1], false);
+    pass &= check("three points are refused", !surface_fit());
+    surface_clear();
+    for (i = 0; i < 5; i++)     tap(20 + 50 * i, 30 + 30 * i, false);
+    pass &= check("points on one line are refused", !surface_fit());
+    surface_clear();
+
+    // Four corners fix the mapping, surface points are whole pixels
+    for (i = 0; i < 4; i++)     tap(corners[i][0], corners[i][1], false);
+    pass &= check("four point fit", surface_fit());
+    exact = worst_error();
+
+    // A noisy 3x3 grid of taps is averaged by the least squares fit
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 3; j++)     tap(20 + 130 * i, 20 + 80 * j, true);
+    }
+    pass &= check("nine point fit", surface_fit());
+    noisy = worst_error();
+
+    printf("worst error over the writing area            %.2f px from 4 exact taps, %.2f px from 9 noisy\n", exact, noisy);
+    pass &= check("exact taps map to within a pixel", exact < 1);
+    pass &= check("noisy taps map to within 3 pixels", noisy < 3);
+
+    // The mapping survives a reboot
+    config_init();
+    surface_load();
+    pass &= check("mapping restored after reboot", fabs(worst_error() - noisy) < 1e-3);
+
+    // Affine mapping, no perspective
+    surface_clear();
+    for (i = 0; i < 4; i++)
+    {
+        double u = 2 * corners[i][0] - corners[i][1] + 5, v = corners[i][0] + 3 * corners[i][1] - 7;
+        surface_tap((float)corners[i][0], (float)corners[i][1], (int32_t)u, (int32_t)v);
+    }
+    pass &= check("affine fit", surface_fit());
+    x = 100;
+    y = 50;
+    surface_apply(&x, &y);
+    pass &= check("affine mapping exact", fabsf(x - 155) < 0.01f && fabsf(y - 243) < 0.01f);
+
+    surface_clear();
+    x = 100;
+    y = 50;
+    surface_apply(&x, &y);
+    pass &= check("clear restores the identity", x == 100 && y == 50);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
@@ -0,0 +1,124 @@
+/**
+*      @file tone_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the buzzer tone sequencer
+*               tone.c is compiled in with the buzzer PWM registers replaced by host variables and driven
+*               one simulated millisecond at a time, checking pattern timing, priority pre-emption,
+*               merging of overlapping requests and the order of queued tones
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o tone_host \
+*                           host/tone_host.c host/eeprom_host.c config.c journal.c format.c
+*             Usage:    ./tone_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../tm4c123gh6pm.h"
+#include "eeprom_host.h"
+
+#undef PWM1_0_LOAD_R
+#undef PWM1_0_CMPB_R
+
+#define PWM1_0_LOAD_R           g_load
+#define PWM1_0_CMPB_R           g_cmpb
+
+// Global Variables
+static volatile uint32_t g_load = 0, g_cmpb = 0;
+
+#include "../tone.c"
+
+void putcUart0(char c)
+{
+    (void)c;
+}
+
+/**
+*      @brief Function to run the sequencer until it falls silent
+*      @param sounding set to the milliseconds the buzzer was on
+*      @param starts set to the number of times the buzzer was switched on
+*      @return uint32_t milliseconds until the sequencer was idle
+**/
+static uint32_t run(uint32_t *sounding, uint32_t *starts)
+{
+    uint32_t ms = 0;
+    bool on = false;
+
+    *sounding = *starts = 0;
+    do
+    {
+        tone_tick();
+        ms++;
+        if (g_load != 0 && !on)     (*starts)++;
+        on = (g_load != 0);
+        *sounding += on;
+    } while (tone_playing() != TONE_NONE && ms < 100000);
+    return ms;
+}
+
+int main(void)
+{
+    uint32_t sounding, starts, ms, i;
+    uint8_t order[8], played = 0, last, cut;
+    bool pass = true;
+
+    eeprom_host_erase();
+    config_init();
+    config_set(LOAD_IR, 20000);     config_set(PER1_IR, 30000);     config_set(PER2_IR, 10000);     config_set(CONT_IR, 2);
+    config_set(LOAD_A, 30000);      config_set(PER1_A, 20000);      config_set(PER2_A, 50000);      config_set(CONT_A, 3);
+    config_set(LOAD_B, 30000);      config_set(PER1_B, 20000);      config_set(PER2_B, 50000);      config_set(CONT_B, 3);
+    config_set(LOAD_C, 30000);      config_set(PER1_C, 20000);      config_set(PER2_C, 50000);      config_set(CONT_C, 3);
+    config_set(LOAD_ERR, 40000);    config_set(PER1_ERR, 100000);   config_set(PER2_ERR, 100000);   config_set(CONT_ERR, 4);
+    config_flush();
+
+    // A request returns at once and the pattern starts on the next tick: 2 x (30 ms on, 10 ms off)
+    tone_request(BEEP_IR_INT);
+    pass &= check("request does not touch the buzzer", g_load == 0 && tone_playing() == TONE_NONE);
+    ms = run(&sounding, &starts);
+    pass &= check("pattern timing", sounding == 60 && starts == 2 && ms == 1 + 80);
+    pass &= check("buzzer off when idle", g_load == 0 && g_cmpb == 0);
+
+    // A request for the tone being played is merged into it, 3 x 20 ms on in all, the first on phase still running
+    tone_request(BEEP_US_A_INT);
+    tone_tick();
+    for (i = 0; i < 10; i++)
+    {
+        tone_request(BEEP_US_A_INT);
+        tone_tick();
+    }
+    ms = run(&sounding, &starts);
+    pass &= check("overlapping requests merge", starts == 3 && 11 + sounding == 60);
+
+    // The error tone cuts a capture tone short and the capture tones then follow in order
+    tone_request(BEEP_US_C_INT);
+    tone_request(BEEP_US_B_INT);
+    tone_tick();
+    pass &= check("lower pattern number first on a tie", tone_playing() == BEEP_US_B_INT);
+    for (i = 0; i < 5; i++)     tone_tick();
+    tone_request(BEEP_US_A_INT);
+    tone_request(BEEP_ERROR);
+    tone_request(BEEP_IR_INT);
+    last = cut = tone_playing();
+    for (ms = 0; ms < 100000 && (ms < 2 || tone_playing() != TONE_NONE); ms++)
+    {
+        tone_tick();
+        if (tone_playing() != last && tone_playing() != TONE_NONE && played < sizeof(order))
+        {
+            order[played++] = tone_playing();
+        }
+        last = tone_playing();
+    }
+    pass &= check("error tone pre-empts at once", cut == BEEP_US_B_INT && played > 0 && order[0] == BEEP_ERROR);
+    pass &= check("queued tones follow by priority and number", played == 4 && order[1] == BEEP_IR_INT &&
+                  order[2] == BEEP_US_A_INT && order[3] == BEEP_US_C_INT);
+
+    // Timings are read when a pattern starts
+    config_set(CONT_IR, 5);
+    config_set(PER2_IR, 0);
+    tone_request(BEEP_IR_INT);
+    ms = run(&sounding, &starts);
+    pass &= check("configuration applies to the next tone", sounding == 150 && ms == 1 + 150);
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
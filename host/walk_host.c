@@ -0,0 +1,141 @@
+/**
+*      @file walk_host.c
+*      @author Prithvi Bhat
+*      @brief Host check of the comparator walk correction
+*               Synthetic pulses get weaker with distance: narrower and later to cross the comparator.
+*               walk.c is calibrated from strokes at a few known positions and then has to take the walk
+*               out of strokes elsewhere on the writing area. Interpolation between table steps and the
+*               filling of steps that saw no pulse are checked as well
+*
+*             Build:    gcc -O2 -std=c99 -iquote . -o walk_host \
+*                           host/walk_host.c host/eeprom_host.c walk.c config.c journal.c format.c -lm
+*             Usage:    ./walk_host
+**/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "eeprom_host.h"
+#include "../config.h"
+#include "../walk.h"
+
+#define CONVERSION_CONSTANT     0.008575    // mm per timer tick, matches commands.c
+#define PULSE_WIDTH_MM          1600000.0   // Pulse width in ticks times distance in mm
+#define WALK_TICKS              400000.0    // Late arrival in ticks times pulse width in ticks
+#define NOISE_TICKS             6           // Peak to peak capture noise
+#define WIDTH_STEP              2000        // Table step in ticks
+
+// Sensor positions in mm, as set by the benchmark
+static const double g_sensor_x[WALK_CHANNELS] = { 0, 0, 300 };
+static const double g_sensor_y[WALK_CHANNELS] = { 0, 200, 200 };
+
+// Global Variables
+static uint32_t g_seed = 12345;
+
+void putcUart0(char c)
+{
+    (void)c;
+}
+
+/**
+*      @brief Function to make the pulse a sensor sees from a pen at x, y
+*      @param ideal set to the arrival without walk
+*      @param arrival set to the captured arrival
+*      @param width set to the captured pulse width
+**/
+static void pulse(uint8_t channel, double x, double y, uint32_t *ideal, uint32_t *arrival, uint32_t *width)
+{
+    double dx = x - g_sensor_x[channel], dy = y - g_sensor_y[channel];
+    double distance = sqrt(dx * dx + dy * dy);
+
+    g_seed = g_seed * 1664525 + 1013904223;                                     // Numerical Recipes LCG
+    *ideal = (uint32_t)(distance / CONVERSION_CONSTANT + 0.5);
+    *width = (uint32_t)(PULSE_WIDTH_MM / distance);
+    *arrival = *ideal + (uint32_t)(WALK_TICKS / *width) + (g_seed >> 16) % NOISE_TICKS;
+}
+
+/**
+*      @brief Function to average the arrival error over a grid of positions
+*      @return double mean absolute error in ticks, with or without the correction
+**/
+static double grid_error(bool corrected)
+{
+    double total = 0;
+    uint32_t samples = 0, ideal, arrival, width;
+    uint8_t channel;
+    int32_t x, y;
+
+    config_set(WALK_MODE, corrected);
+    for (x = 20; x <= 280; x += 20)
+    {
+        for (y = 20; y <= 180; y += 20)
+        {
+            for (channel = 0; channel < WALK_CHANNELS; channel++)
+            {
+                pulse(channel, x, y, &ideal, &arrival, &width);
+                total += fabs((double)(int32_t)(arrival - walk_offset(channel, width) - ideal));
+                samples++;
+            }
+        }
+    }
+    return total / samples;
+}
+
+int main(void)
+{
+    static const int32_t positions[][2] = { { 20, 20 }, { 150, 100 }, { 280, 180 }, { 280, 20 }, { 60, 160 } };
+    uint32_t expected[WALK_CHANNELS], ideal, arrival, width;
+    uint8_t p, i, channel;
+    double before, after;
+    bool pass = true;
+
+    eeprom_host_erase();
+    config_init();
+    config_set(WALK_BIN, WIDTH_STEP);
+
+    // Interpolation between the middles of the steps
+    config_set(WALK_MODE, 1);
+    for (i = 0; i < WALK_BINS; i++)     config_set(WALK_A + i, i * 100);
+    pass &= check("offset flat below the first step middle", walk_offset(0, WIDTH_STEP / 4) == 0);
+    pass &= check("offset interpolated between step middles", walk_offset(0, 2 * WIDTH_STEP) == 150);
+    pass &= check("offset flat beyond the last step middle", walk_offset(0, 100 * WIDTH_STEP) == 700);
+    pass &= check("no offset without a width", walk_offset(0, 0) == 0);
+    config_set(WALK_MODE, 0);
+    pass &= check("no offset while correction is off", walk_offset(0, 2 * WIDTH_STEP) == 0 && !walk_capture_widths());
+
+    // Calibrate from strokes at a few known positions
+    for (p = 0; p < sizeof(positions) / sizeof(positions[0]); p++)
+    {
+        for (channel = 0; channel < WALK_CHANNELS; channel++)
+        {
+            pulse(channel, positions[p][0], positions[p][1], &expected[channel], &arrival, &width);
+        }
+        walk_calibrate_begin(expected);
+        if (p == 0)     pass &= check("calibrating captures widths", walk_capture_widths());
+
+        for (i = 0; i < 20; i++)
+        {
+            for (channel = 0; channel < WALK_CHANNELS; channel++)
+            {
+                pulse(channel, positions[p][0], positions[p][1], &ideal, &arrival, &width);
+                walk_calibrate_add(channel, arrival, width);
+            }
+        }
+    }
+    pass &= check("calibration stored", walk_calibrate_save());
+
+    for (i = 1; i < WALK_BINS && config_get(WALK_A + i) != config_get(WALK_A + i - 1); i++);
+    pass &= check("steps without pulses copy a neighbour", i < WALK_BINS);
+
+    before = grid_error(false);
+    after = grid_error(true);
+    printf("mean arrival error over the writing area    %.1f ticks uncorrected, %.1f corrected\n", before, after);
+    pass &= check("walk mostly removed", after < before / 4);
+
+    walk_calibrate_begin(expected);
+    pass &= check("nothing stored without pulses", !walk_calibrate_save());
+
+    printf("\n%s\n", pass ? "all checks passed" : "checks FAILED");
+    return !pass;
+}
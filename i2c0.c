@@ -20,6 +20,7 @@
 #include <stdbool.h>
 #include "tm4c123gh6pm.h"
 #include "gpio.h"
+#include "nvic.h"
 #include "i2c0.h"
 
 // PortB masks
@@ -30,15 +31,39 @@
 #define I2C0SCL PORTB,2
 #define I2C0SDA PORTB,3
 
+// Transaction queue sizes, powers of two
+#define QUEUE_TRANSACTIONS 64
+#define QUEUE_BYTES 256
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+// Queued write transactions, filled by queueI2c0Write() and drained by i2c0Isr()
+// Transaction bytes live in a separate ring so short and long writes share the space
+typedef struct _I2C0_TRANSACTION
+{
+    uint8_t add;
+    uint8_t size;
+    uint8_t first;                  // index of the first byte in i2c0QueueBytes
+    i2c0Callback callback;
+} I2C0_TRANSACTION;
+
+I2C0_TRANSACTION i2c0Queue[QUEUE_TRANSACTIONS];
+uint8_t i2c0QueueBytes[QUEUE_BYTES];
+volatile uint8_t i2c0QueueHead = 0;     // next free transaction, written by the producer only
+volatile uint8_t i2c0QueueTail = 0;     // transaction in flight, written by the isr only
+volatile uint16_t i2c0ByteHead = 0;
+volatile uint16_t i2c0ByteTail = 0;
+volatile uint8_t i2c0Sent = 0;          // bytes of the transaction in flight already on the bus
+volatile bool i2c0Busy = false;
+volatile bool i2c0Stopping = false;     // STOP issued after an error, next interrupt ends the transaction
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initI2c0(void)
+void initI2c0(I2C0_SPEED speed)
 {
     // Enable clocks
     SYSCTL_RCGCI2C_R |= SYSCTL_RCGCI2C_R0;
@@ -53,9 +78,16 @@ void initI2c0(void)
 
     // Configure I2C0 peripheral
     I2C0_MCR_R = 0;                                     // disable to program
-    I2C0_MTPR_R = 19;                                   // (40MHz/2) / (6+4) / (19+1) = 100kbps
+    if (speed == I2C0_FAST)
+        I2C0_MTPR_R = 4;                                // (40MHz/2) / (6+4) / (4+1) = 400kbps
+    else
+        I2C0_MTPR_R = 19;                               // (40MHz/2) / (6+4) / (19+1) = 100kbps
     I2C0_MCR_R = I2C_MCR_MFE;                           // master
     I2C0_MCS_R = I2C_MCS_STOP;
+
+    // Queued transactions are serviced by the interrupt, which is only unmasked while one is in flight
+    I2C0_MIMR_R = 0;
+    enableNvicInterrupt(INT_I2C0);
 }
 
 // For simple devices with a single internal register
@@ -201,4 +233,111 @@ bool isI2c0Error(void)
     return (I2C0_MCS_R & I2C_MCS_ERROR);
 }
 
+// Transaction queue
+// The blocking functions above must only be used while the queue is idle
+
+// Puts the next byte of the transaction at the tail on the bus
+static void sendI2c0QueueByte(void)
+{
+    I2C0_TRANSACTION *t = &i2c0Queue[i2c0QueueTail];
+    uint32_t command = I2C_MCS_RUN;
+    if (i2c0Sent == 0)
+    {
+        I2C0_MSA_R = t->add << 1; // add:r/~w=0
+        command |= I2C_MCS_START;
+    }
+    if (i2c0Sent == t->size - 1)
+        command |= I2C_MCS_STOP;
+    I2C0_MDR_R = i2c0QueueBytes[(t->first + i2c0Sent) & (QUEUE_BYTES - 1)];
+    i2c0Sent++;
+    I2C0_MICR_R = I2C_MICR_IC;
+    I2C0_MCS_R = command;
+}
+
+// Retires the transaction at the tail and starts the next one, if any
+static void finishI2c0Transaction(bool success)
+{
+    I2C0_TRANSACTION *t = &i2c0Queue[i2c0QueueTail];
+    i2c0Callback callback = t->callback;
+    i2c0ByteTail += t->size;
+    i2c0QueueTail = (i2c0QueueTail + 1) & (QUEUE_TRANSACTIONS - 1);
+    i2c0Sent = 0;
+    i2c0Stopping = false;
+    if (callback != 0)
+        callback(success);
+    if (i2c0QueueTail != i2c0QueueHead)
+        sendI2c0QueueByte();
+    else
+    {
+        i2c0Busy = false;
+        I2C0_MIMR_R = 0;
+    }
+}
+
+void i2c0Isr(void)
+{
+    I2C0_MICR_R = I2C_MICR_IC;
+    if (!i2c0Busy)
+        return;
+    if (i2c0Stopping)
+        finishI2c0Transaction(false);
+    else if (I2C0_MCS_R & I2C_MCS_ERROR)
+    {
+        // Address or data not acknowledged, release the bus unless arbitration was lost
+        if (!(I2C0_MCS_R & I2C_MCS_ARBLST) && i2c0Sent < i2c0Queue[i2c0QueueTail].size)
+        {
+            i2c0Stopping = true;
+            I2C0_MCS_R = I2C_MCS_STOP;
+        }
+        else
+            finishI2c0Transaction(false);
+    }
+    else if (i2c0Sent < i2c0Queue[i2c0QueueTail].size)
+        sendI2c0QueueByte();
+    else
+        finishI2c0Transaction(true);
+}
+
+// Copies a write transaction into the queue and returns at once
+// callback, if not 0, runs in interrupt context when the transaction completes
+// Returns false, queueing nothing, if the queue has no room
+bool queueI2c0Write(uint8_t add, const uint8_t data[], uint8_t size, i2c0Callback callback)
+{
+    uint8_t i, head = i2c0QueueHead;
+    I2C0_TRANSACTION *t = &i2c0Queue[head];
+    if (size == 0
+        || ((head + 1) & (QUEUE_TRANSACTIONS - 1)) == i2c0QueueTail
+        || (uint16_t)(i2c0ByteHead - i2c0ByteTail) > QUEUE_BYTES - size)
+        return false;
+    for (i = 0; i < size; i++)
+        i2c0QueueBytes[(i2c0ByteHead + i) & (QUEUE_BYTES - 1)] = data[i];
+    t->add = add;
+    t->size = size;
+    t->first = i2c0ByteHead & (QUEUE_BYTES - 1);
+    t->callback = callback;
+    i2c0ByteHead += size;
+    i2c0QueueHead = (head + 1) & (QUEUE_TRANSACTIONS - 1);
+    // The interrupt is masked whenever i2c0Busy is false, so starting here cannot race with it
+    if (!i2c0Busy)
+    {
+        i2c0Busy = true;
+        sendI2c0QueueByte();
+        I2C0_MIMR_R = I2C_MIMR_IM;
+    }
+    return true;
+}
+
+uint8_t getI2c0QueueDepth(void)
+{
+    return (i2c0QueueHead - i2c0QueueTail) & (QUEUE_TRANSACTIONS - 1);
+}
+
+uint16_t getI2c0QueuedBytes(void)
+{
+    return i2c0ByteHead - i2c0ByteTail;
+}
 
+bool isI2c0QueueIdle(void)
+{
+    return !i2c0Busy;
+}
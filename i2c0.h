@@ -22,11 +22,21 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Bus speed, selected once by initI2c0()
+typedef enum _I2C0_SPEED
+{
+    I2C0_STANDARD,      // 100 kHz
+    I2C0_FAST           // 400 kHz
+} I2C0_SPEED;
+
+// Completion callback for queued transactions, called from the I2C0 interrupt
+typedef void (*i2c0Callback)(bool success);
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initI2c0(void);
+void initI2c0(I2C0_SPEED speed);
 // For simple devices with a single internal register
 void writeI2c0Data(uint8_t add, uint8_t data);
 uint8_t readI2c0Data(uint8_t add);
@@ -41,5 +51,12 @@ void readI2c0Registers(uint8_t add, uint8_t reg, uint8_t data[], uint8_t size);
 bool pollI2c0Address(uint8_t add);
 bool isI2c0Error(void);
 
+// Interrupt driven transaction queue
+bool queueI2c0Write(uint8_t add, const uint8_t data[], uint8_t size, i2c0Callback callback);
+uint8_t getI2c0QueueDepth(void);
+uint16_t getI2c0QueuedBytes(void);
+bool isI2c0QueueIdle(void);
+void i2c0Isr(void);
+
 #endif
 
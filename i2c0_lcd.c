@@ -33,33 +33,92 @@
 #define LCD_E  4
 #define LCD_BACKLIGHT 8
 
+// Refresh stops queueing once this many bytes are waiting, leaving the rest of the I2C0 queue free
+#define LCD_QUEUE_BUDGET 128
+// Longest burst: a cursor command and a full row
+#define LCD_BURST_BYTES (4 * (LCD_COLS + 1))
+#define LCD_CURSOR_UNKNOWN 0xFF
+// lcdCursor values with this bit set are CGRAM addresses
+#define LCD_CGRAM 0x80
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+// putsLcd() writes lcdShadow, refreshLcd() copies the cells that differ into lcdScreen and onto the display
+char lcdShadow[LCD_ROWS][LCD_COLS];
+char lcdScreen[LCD_ROWS][LCD_COLS];
+uint8_t lcdDirtyRows = 0;
+uint8_t lcdCursor = LCD_CURSOR_UNKNOWN;     // DDRAM address, or LCD_CGRAM | CGRAM address, the next byte lands on
+uint32_t lcdRefreshPeriod = 100;            // ms between refreshes
+uint32_t lcdLastRefresh = 0;
+bool lcdRefreshing = false;                 // refresh started but cut short by LCD_QUEUE_BUDGET
+uint8_t lcdBurst[LCD_BURST_BYTES];          // contiguous cells collected into one I2C0 write
+uint8_t lcdBurstSize = 0;
+
+// Custom character patterns, shadowed and diffed a row at a time like the cells
+uint8_t lcdGlyph[LCD_GLYPHS][LCD_GLYPH_ROWS];
+uint8_t lcdGlyphSent[LCD_GLYPHS][LCD_GLYPH_ROWS];
+uint8_t lcdDirtyGlyphs = 0;
+
+// DDRAM order of the rows, the last cell of row 0 continues into row 2 and row 1 into row 3
+const uint8_t lcdRowOrder[LCD_ROWS] = {0, 2, 1, 3};
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+// Packs the two E cycles of one byte into 4 PCF8574 output bytes
+// The PCF8574 latches each byte of a write onto its outputs in turn,
+// so any number of these can follow each other in one I2C0 write
+void packTextLcdByte(uint8_t bytes[], uint8_t data, uint8_t flags)
+{
+    bytes[0] = (data & 0xF0) | LCD_E | flags | LCD_BACKLIGHT;
+    bytes[1] = (data & 0xF0) | flags | LCD_BACKLIGHT;
+    bytes[2] = (data << 4) | LCD_E | flags | LCD_BACKLIGHT;
+    bytes[3] = (data << 4) | flags | LCD_BACKLIGHT;
+}
+
+// Queues one byte as a single 4 byte transaction
+// Only waits if the I2C0 queue is full
+void writeTextLcdByte(uint8_t data, uint8_t flags)
+{
+    uint8_t bytes[4];
+    packTextLcdByte(bytes, data, flags);
+    while (!queueI2c0Write(LCD_ADD, bytes, 4, 0));
+}
+
 void writeTextLcdCommand(uint8_t command)
 {
-    writeI2c0Data(LCD_ADD, (command & 0xF0) | LCD_E | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (command & 0xF0) | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (command << 4) | LCD_E | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (command << 4) | LCD_BACKLIGHT);
+    writeTextLcdByte(command, 0);
 }
 
 void writeTextLcdData(char c)
 {
-    writeI2c0Data(LCD_ADD, (c & 0xF0) | LCD_E | LCD_RS | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (c & 0xF0) | LCD_RS | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (c << 4) | LCD_E | LCD_RS | LCD_BACKLIGHT);
-    writeI2c0Data(LCD_ADD, (c << 4) | LCD_RS | LCD_BACKLIGHT);
+    writeTextLcdByte(c, LCD_RS);
+}
+
+// Queues the bytes collected in lcdBurst as one transaction
+void flushLcdBurst(void)
+{
+    if (lcdBurstSize == 0)
+        return;
+    while (!queueI2c0Write(LCD_ADD, lcdBurst, lcdBurstSize, 0));
+    lcdBurstSize = 0;
+}
+
+void appendLcdBurst(uint8_t data, uint8_t flags)
+{
+    packTextLcdByte(&lcdBurst[lcdBurstSize], data, flags);
+    lcdBurstSize += 4;
 }
 
-void initLcd()
+// The PCF8574 is specified for 100 kHz, most backpacks also run at 400 kHz
+void initLcd(I2C0_SPEED speed)
 {
-    initI2c0();
+    uint8_t row, col;
+    const uint8_t reset = 0x20;
+    initI2c0(speed);
 
     // Wait for device to come out of reset
     waitMicrosecond(2000);
@@ -68,19 +127,147 @@ void initLcd()
     // Note: If device was not reset, the device could already be in 4-bit mode
     //       If this is the case, then this single E cycle will corrupt phase of writes
     //       and the display will likely only initialize correctly every other time
-    writeI2c0Data(LCD_ADD, 0x20 | LCD_E);
-    writeI2c0Data(LCD_ADD, 0x20);
+    // Both nibble writes go in one blocking burst, everything after it goes through the I2C0 queue
+    writeI2c0Registers(LCD_ADD, 0x20 | LCD_E, &reset, 1);
 
-    // Continue configuration using dual E cycle (2 nibble) writes
-    writeTextLcdCommand(0x28); // 4-bit interface, 2 lines, 5x8 font
-    writeTextLcdCommand(0x0C); // display on, no cursor, no blink
-    writeTextLcdCommand(0x06); // shift cursor to right after writes
+    // Continue configuration using dual E cycle (2 nibble) writes, sent as one burst
+    appendLcdBurst(0x28, 0); // 4-bit interface, 2 lines, 5x8 font
+    appendLcdBurst(0x0C, 0); // display on, no cursor, no blink
+    appendLcdBurst(0x06, 0); // shift cursor to right after writes
+    flushLcdBurst();
+
+    // Contents after reset are unknown, so the first refresh writes every cell and glyph row
+    for (row = 0; row < LCD_ROWS; row++)
+        for (col = 0; col < LCD_COLS; col++)
+        {
+            lcdShadow[row][col] = ' ';
+            lcdScreen[row][col] = 0;
+        }
+    for (row = 0; row < LCD_GLYPHS; row++)
+        for (col = 0; col < LCD_GLYPH_ROWS; col++)
+        {
+            lcdGlyph[row][col] = 0;
+            lcdGlyphSent[row][col] = 0xFF;
+        }
+    lcdDirtyRows = (1 << LCD_ROWS) - 1;
+    lcdDirtyGlyphs = (1 << LCD_GLYPHS) - 1;
+    lcdCursor = LCD_CURSOR_UNKNOWN;
+}
+
+uint8_t getLcdAddress(uint8_t row, uint8_t col)
+{
+    return (row & 1) * 64 + (row & 2) * 10 + col;
 }
 
+// Writes text into the shadow, the display follows on a later refreshLcd()
+// Text past the last column is dropped
 void putsLcd(uint8_t row, uint8_t col, const char str[])
 {
     uint8_t i = 0;
-    writeTextLcdCommand(0x80 + (row & 1) * 64 + (row & 2) * 10 + col);
-    while (str[i] != NULL)
-        writeTextLcdData(str[i++]);
+    if (row >= LCD_ROWS)
+        return;
+    while (str[i] != 0 && col < LCD_COLS)
+    {
+        if (lcdShadow[row][col] != str[i])
+        {
+            lcdShadow[row][col] = str[i];
+            lcdDirtyRows |= 1 << row;
+        }
+        col++;
+        i++;
+    }
+}
+
+// Sets one 5 pixel row of a custom character, bit 4 is the leftmost pixel
+// Display the character with code LCD_GLYPH_CODE + glyph, the pattern follows on a later refreshLcd()
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits)
+{
+    if (glyph >= LCD_GLYPHS || row >= LCD_GLYPH_ROWS)
+        return;
+    bits &= 0x1F;
+    if (lcdGlyph[glyph][row] != bits)
+    {
+        lcdGlyph[glyph][row] = bits;
+        lcdDirtyGlyphs |= 1 << glyph;
+    }
+}
+
+// Sets the maximum refresh rate, 0 refreshes whenever refreshLcd() is called
+void setLcdRefreshRate(uint8_t hz)
+{
+    lcdRefreshPeriod = (hz == 0) ? 0 : 1000 / hz;
+}
+
+// Adds one byte for DDRAM or CGRAM address target to the current burst
+// A new burst starts, led by an address command, where the target does not follow on from the last byte
+// Returns false, adding nothing, if the refresh has used up its share of the I2C0 queue
+bool queueLcdCell(uint8_t target, uint8_t data)
+{
+    if (lcdBurstSize == 0 || target != lcdCursor || lcdBurstSize + 4 > LCD_BURST_BYTES)
+    {
+        flushLcdBurst();
+        if (getI2c0QueuedBytes() >= LCD_QUEUE_BUDGET)
+            return false;
+        if (target != lcdCursor)
+            appendLcdBurst((target & LCD_CGRAM) ? 0x40 | (target & 0x3F) : 0x80 | target, 0);
+    }
+    appendLcdBurst(data, LCD_RS);
+    lcdCursor = target + 1;
+    return true;
+}
+
+// Low priority task, call from the main loop with the current time in ms
+// At most once per refresh period, queues the glyph rows and cells whose shadow differs from what was
+// last sent, glyphs first so cells never show a stale pattern
+// An address command is only queued where the changed bytes are not contiguous, and each address
+// command with the run of bytes after it is sent as one burst
+// Returns true if anything was queued
+bool refreshLcd(uint32_t ms)
+{
+    uint8_t i, row, col, address;
+    bool queued = false;
+    if (lcdDirtyRows == 0 && lcdDirtyGlyphs == 0)
+        return false;
+    if (!lcdRefreshing)
+    {
+        if (ms - lcdLastRefresh < lcdRefreshPeriod)
+            return false;
+        lcdLastRefresh = ms;
+        lcdRefreshing = true;
+    }
+    for (i = 0; i < LCD_GLYPHS; i++)
+    {
+        if (!(lcdDirtyGlyphs & (1 << i)))
+            continue;
+        for (row = 0; row < LCD_GLYPH_ROWS; row++)
+        {
+            if (lcdGlyph[i][row] == lcdGlyphSent[i][row])
+                continue;
+            if (!queueLcdCell(LCD_CGRAM | (i * LCD_GLYPH_ROWS + row), lcdGlyph[i][row]))
+                return true;
+            lcdGlyphSent[i][row] = lcdGlyph[i][row];
+            queued = true;
+        }
+        lcdDirtyGlyphs &= ~(1 << i);
+    }
+    for (i = 0; i < LCD_ROWS; i++)
+    {
+        row = lcdRowOrder[i];
+        if (!(lcdDirtyRows & (1 << row)))
+            continue;
+        for (col = 0; col < LCD_COLS; col++)
+        {
+            if (lcdShadow[row][col] == lcdScreen[row][col])
+                continue;
+            address = getLcdAddress(row, col);
+            if (!queueLcdCell(address, lcdShadow[row][col]))
+                return true;
+            lcdScreen[row][col] = lcdShadow[row][col];
+            queued = true;
+        }
+        lcdDirtyRows &= ~(1 << row);
+    }
+    flushLcdBurst();
+    lcdRefreshing = false;
+    return queued;
 }
@@ -24,13 +24,26 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "i2c0.h"
+
+#define LCD_ROWS 4
+#define LCD_COLS 20
+
+// Custom 5x8 characters in CGRAM, shown with codes LCD_GLYPH_CODE to LCD_GLYPH_CODE + 7
+// (codes 0-7 select the same patterns but 0 cannot be written with putsLcd())
+#define LCD_GLYPHS 8
+#define LCD_GLYPH_ROWS 8
+#define LCD_GLYPH_CODE 8
 
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initLcd();
+void initLcd(I2C0_SPEED speed);
 void putsLcd(uint8_t row, uint8_t col, const char str[]);
+void setLcdGlyphRow(uint8_t glyph, uint8_t row, uint8_t bits);
+void setLcdRefreshRate(uint8_t hz);
+bool refreshLcd(uint32_t ms);
 
 #endif
 
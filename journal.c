@@ -0,0 +1,175 @@
+/**
+*      @file journal.c
+*      @author Prithvi Bhat
+*      @brief Wear leveled, append only EEPROM journal for frequently rewritten parameters
+*               * Every update appends a (sequence, key, value) entry at the head of a ring spanning
+*                 JOURNAL_SEGMENTS EEPROM blocks, so writes are spread over the whole region
+*                 instead of hammering one word
+*               * The entry with the highest sequence number for a key holds its current value
+*               * Before the head enters a segment, the live entries of that segment have to be copied
+*                 to the head. journal_service() does this one entry at a time from the main loop,
+*                 journal_write() only does it itself if the head would otherwise catch up
+*               * journal_init() rebuilds the state from one streamed read of the region, so the boot
+*                 scan is bounded by JOURNAL_WORDS reads
+*               * The value is written before the header, a reset in between leaves a stale entry
+*                 that is superseded by a newer one for the same key
+**/
+
+#include "journal.h"
+#include "eeprom.h"
+
+#define SEQUENCE_MASK   0x00FFFFFF                  // Sequence numbers are 24 bits and wrap
+#define NO_SLOT         0xFF
+#define HEADER(seq, key)    (((uint32_t)(seq) << 8) | (key))
+#define SEGMENT(slot)       ((slot) / JOURNAL_SEGMENT_ENTRIES)
+#define HEADER_ADDRESS(slot)    (JOURNAL_BASE + (slot) * JOURNAL_ENTRY_WORDS)
+#define VALUE_ADDRESS(slot)     (HEADER_ADDRESS(slot) + 1)
+
+// Global Variables
+static uint32_t g_journal_value[JOURNAL_KEYS];      // Current value of each key
+static uint8_t g_journal_slot[JOURNAL_KEYS];        // Slot of the entry holding it, NO_SLOT if never written
+static uint8_t g_journal_head = 0;                  // Next slot to write
+static uint32_t g_journal_sequence = 0;             // Sequence number of the next entry
+
+/**
+*      @brief Function to compare two sequence numbers allowing for wrap around
+*      @return bool true if a was written after b
+**/
+static bool journal_newer(uint32_t a, uint32_t b)
+{
+    uint32_t distance = (a - b) & SEQUENCE_MASK;
+    return distance != 0 && distance < (SEQUENCE_MASK + 1) / 2;
+}
+
+/**
+*      @brief Function to write an entry at the head
+**/
+static void journal_append(uint8_t key, uint32_t value)
+{
+    uint8_t slot = g_journal_head;
+
+    writeEeprom(VALUE_ADDRESS(slot), value);
+    writeEeprom(HEADER_ADDRESS(slot), HEADER(g_journal_sequence, key));    // Entry becomes valid here
+
+    g_journal_value[key] = value;
+    g_journal_slot[key] = slot;
+    g_journal_head = (slot + 1) % JOURNAL_ENTRIES;
+    g_journal_sequence = (g_journal_sequence + 1) & SEQUENCE_MASK;
+}
+
+/**
+*      @brief Function to find a live entry in the segment after the head
+*      @param live set to the number of live entries in that segment
+*      @return uint8_t key of the live entry, JOURNAL_KEYS if the segment can be overwritten
+**/
+static uint8_t journal_next_live(uint8_t *live)
+{
+    uint8_t key, next = (SEGMENT(g_journal_head) + 1) % JOURNAL_SEGMENTS, found = JOURNAL_KEYS;
+
+    *live = 0;
+    for (key = 0; key < JOURNAL_KEYS; key++)
+    {
+        if (g_journal_slot[key] != NO_SLOT && SEGMENT(g_journal_slot[key]) == next)
+        {
+            (*live)++;
+            found = key;
+        }
+    }
+    return found;
+}
+
+/**
+*      @brief Function to rebuild the latest value of every key from the journal
+**/
+void journal_init(void)
+{
+    uint32_t entries[JOURNAL_WORDS], key_sequence[JOURNAL_KEYS] = {0}, last_sequence = 0;
+    uint8_t slot, key, last_slot = NO_SLOT;
+
+    for (key = 0; key < JOURNAL_KEYS; key++)    g_journal_slot[key] = NO_SLOT;
+
+    readEepromBlock(JOURNAL_BASE, entries, JOURNAL_WORDS);                  // Whole journal in one streamed read
+
+    for (slot = 0; slot < JOURNAL_ENTRIES; slot++)
+    {
+        uint32_t header = entries[slot * JOURNAL_ENTRY_WORDS], sequence = header >> 8;
+
+        key = header & 0xFF;
+        if (key >= JOURNAL_KEYS)    continue;                               // Erased or foreign word
+
+        if (last_slot == NO_SLOT || journal_newer(sequence, last_sequence))
+        {
+            last_sequence = sequence;
+            last_slot = slot;
+        }
+
+        if (g_journal_slot[key] == NO_SLOT || journal_newer(sequence, key_sequence[key]))
+        {
+            key_sequence[key] = sequence;
+            g_journal_slot[key] = slot;
+        }
+    }
+
+    for (key = 0; key < JOURNAL_KEYS; key++)
+    {
+        if (g_journal_slot[key] != NO_SLOT)     g_journal_value[key] = entries[g_journal_slot[key] * JOURNAL_ENTRY_WORDS + 1];
+    }
+
+    g_journal_head = (last_slot == NO_SLOT) ? 0 : (last_slot + 1) % JOURNAL_ENTRIES;
+    g_journal_sequence = (last_slot == NO_SLOT) ? 0 : (last_sequence + 1) & SEQUENCE_MASK;
+}
+
+/**
+*      @brief Function to read the current value of a key
+*      @param key 0 to JOURNAL_KEYS - 1
+*      @param value set to the current value if the key has been written
+*      @return bool false if the key has never been written
+**/
+bool journal_read(uint8_t key, uint32_t *value)
+{
+    if (key >= JOURNAL_KEYS || g_journal_slot[key] == NO_SLOT)   return false;
+
+    *value = g_journal_value[key];
+    return true;
+}
+
+/**
+*      @brief Function to record a new value for a key, unchanged values are not written
+*      @param key 0 to JOURNAL_KEYS - 1
+*      @param value new value
+**/
+void journal_write(uint8_t key, uint32_t value)
+{
+    uint8_t live, free, moved, remaining;
+
+    if (key >= JOURNAL_KEYS)    return;
+    if (g_journal_slot[key] != NO_SLOT && g_journal_value[key] == value)    return;
+
+    free = JOURNAL_SEGMENT_ENTRIES - g_journal_head % JOURNAL_SEGMENT_ENTRIES;
+    journal_next_live(&live);
+    if (live > 0 && free <= live)                                           // Head would catch up with live entries
+    {
+        for (; live > 0; live--)                                            // Last copy moves the head into the freed segment
+        {
+            moved = journal_next_live(&remaining);
+            journal_append(moved, g_journal_value[moved]);
+        }
+    }
+
+    journal_append(key, value);
+}
+
+/**
+*      @brief Function to compact the journal in the background, call from the main loop
+*               Copies at most one live entry out of the segment the head enters next
+*      @return bool true if an entry was copied
+**/
+bool journal_service(void)
+{
+    uint8_t live, key = journal_next_live(&live);
+
+    if (key == JOURNAL_KEYS)    return false;
+
+    journal_append(key, g_journal_value[key]);
+    return true;
+}
@@ -0,0 +1,25 @@
+/**
+*      @file journal.h
+*      @author Prithvi Bhat
+*      @brief Wear leveled, append only EEPROM journal for frequently rewritten parameters
+**/
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+#include "eeprom_memory_map.h"
+
+#define JOURNAL_KEYS            4       // Distinct keys, must stay below JOURNAL_SEGMENT_ENTRIES
+#define JOURNAL_ENTRY_WORDS     2       // Header (sequence << 8 | key) and value
+#define JOURNAL_ENTRIES         (JOURNAL_WORDS / JOURNAL_ENTRY_WORDS)
+#define JOURNAL_SEGMENT_ENTRIES (JOURNAL_SEGMENT_WORDS / JOURNAL_ENTRY_WORDS)
+#define JOURNAL_SEGMENTS        (JOURNAL_WORDS / JOURNAL_SEGMENT_WORDS)
+
+// Function prototypes
+void journal_init(void);
+bool journal_read(uint8_t key, uint32_t *value);
+void journal_write(uint8_t key, uint32_t value);
+bool journal_service(void);
+
+#endif
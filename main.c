@@ -23,20 +23,33 @@
 #include "uart0.h"
 #include "wait.h"
 #include "strings.h"
-#include <stdio.h>
 #include "eeprom_memory_map.h"
 #include "commands.h"
 #include <string.h>
 #include "i2c0_lcd.h"
+#include "bench.h"
+#include "dispatch.h"
+#include "format.h"
+#include "config.h"
+#include "journal.h"
+#include "profile.h"
+#include "minimap.h"
+#include "window.h"
+#include "adaptive.h"
+#include "walk.h"
+#include "surface.h"
+#include "grid.h"
+#include "health.h"
 
-#define IS_COMMAND(string, count)       if(isCommand(&user_data, string, count))
 #define RESET                           (NVIC_APINT_R = (NVIC_APINT_VECTKEY | NVIC_APINT_SYSRESETREQ))
 #define ASSERT(value)                   if(value >= 0)
 
 // Global Variables
-uint32_t g_timer_A_accumulated = 0, g_timer_B_accumulated = 0, g_timer_C_accumulated = 0, count = 0;
-uint32_t g_timer_A_FIFO[MAX_FIFO_SIZE], g_timer_B_FIFO[MAX_FIFO_SIZE], g_timer_C_FIFO[MAX_FIFO_SIZE];
+uint32_t g_capture_A = 0, g_capture_B = 0, g_capture_C = 0, count = 0;      // Captures of the stroke in flight, averaging depth
+uint32_t g_width_A = 0, g_width_B = 0, g_width_C = 0;                      // Pulse widths, 0 unless both edges are captured
+capture_window_t g_window_A = { .depth = 1 }, g_window_B = { .depth = 1 }, g_window_C = { .depth = 1 };
 bool ir_in, sA_in, sB_in, sC_in;
+volatile bool g_stroke = false;                                             // Windows slid on, a fresh fix is due
 
 // Pin Macros
 #define IR_IN       		PORTA,6		            // Input pin for IR signal
@@ -45,6 +58,9 @@ bool ir_in, sA_in, sB_in, sC_in;
 #define US_C_IN 		    PORTC,6		            // Input pin for comparator output from Sensor 3
 #define BUZZ_OUT            PORTD,1                 // Output pin for buzzer
 
+#define LCD_REFRESH_RATE    10                      // Hz, the display shadow is sent at most this often
+#define LCD_I2C_SPEED       I2C0_FAST               // I2C0_STANDARD if the display backpack misbehaves at 400 kHz
+
 /**
  *      @brief Function to initialize all necessary hardware on the device
  **/
@@ -63,12 +79,18 @@ void init_TM4C_hardware(void)
 
     setPinAuxFunction(BUZZ_OUT, GPIO_PCTL_PD1_M1PWM1);
 
-    initLcd();                                      // Initialise I2C display device
+    timer_tick_init();                              // Millisecond time base for background tasks
+    initLcd(LCD_I2C_SPEED);                         // Initialise I2C display device
+    setLcdRefreshRate(LCD_REFRESH_RATE);
     initEeprom(); 					                // Initialize MCU to use EEPROM
+    config_init();                                  // Finish any interrupted commit and load the configuration
+    profile_init();                                 // Cache the calibration profiles
+    update_solver_constants();
     pwm_init();                                     // Initialise PWM
 
     initUart0();                                    // Initialise UART0
     setUart0BaudRate(115200, 40e6);                 // Set UART baud rate and clock
+    enableUart0RxInterrupt();                       // Receive into a ring buffer from the UART0 ISR
 
     disableNvicInterrupt(INT_GPIOD);				// Disable the interrupt using its vector
     disableNvicInterrupt(INT_GPIOA);                // Disable the interrupt using its vector
@@ -88,16 +110,53 @@ void init_TM4C_hardware(void)
     timer_init();                                   // Initialise timers
 }
 
+/**
+ *      @brief Function to set the number of captures averaged in every window
+ **/
+static void set_window_depth(uint8_t depth)
+{
+    count = depth;
+    window_set_depth(&g_window_A, depth);
+    window_set_depth(&g_window_B, depth);
+    window_set_depth(&g_window_C, depth);
+}
+
+/**
+ *      @brief Function to take the comparator walk out of an arrival
+ *      @param channel sensor, 0 for A
+ *      @param capture timer capture of the leading edge
+ *      @param width pulse width in timer ticks, 0 if unknown
+ **/
+static uint32_t correct_capture(uint8_t channel, uint32_t capture, uint32_t width)
+{
+    return capture - walk_offset(channel, width);
+}
+
 /**
  *      @brief ISR for when the MCU receives input from the comparator for Ultrasound Sensor A
  **/
 void sA_interrupt_handler(void)
 {
-    g_timer_A_FIFO[g_timer_A_accumulated++] = WTIMER0_TAV_R;    // Read timer register
+    if (sA_in)                                                  // Trailing edge of the pulse
+    {
+        g_width_A = WTIMER0_TAV_R - g_capture_A;
+    }
+    else
+    {
+        g_capture_A = WTIMER0_TAV_R;                            // Read timer register
+        g_width_A = 0;
+        sA_in = true;                                           // Set flag for feedback
+
+        if (walk_capture_widths())                              // Keep counting until the trailing edge
+        {
+            WTIMER0_ICR_R |= TIMER_ICR_CAECINT;                 // Reset Timer interrupt
+            return;
+        }
+    }
+
     WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;                           // Disable timer
     WTIMER0_TAV_R = 0;                                          // Reset Register
     WTIMER0_ICR_R |= TIMER_ICR_CAECINT;                         // Reset Timer interrupt
-    sA_in = true;                                               // Set flag for feedback
 }
 
 /**
@@ -105,11 +164,26 @@ void sA_interrupt_handler(void)
  **/
 void sB_interrupt_handler(void)
 {
-    g_timer_B_FIFO[g_timer_B_accumulated++] = WTIMER0_TBV_R;    // Read timer register
+    if (sB_in)                                                  // Trailing edge of the pulse
+    {
+        g_width_B = WTIMER0_TBV_R - g_capture_B;
+    }
+    else
+    {
+        g_capture_B = WTIMER0_TBV_R;                            // Read timer register
+        g_width_B = 0;
+        sB_in = true;                                           // Set flag for feedback
+
+        if (walk_capture_widths())                              // Keep counting until the trailing edge
+        {
+            WTIMER0_ICR_R |= TIMER_ICR_CBECINT;                 // Reset Timer interrupt
+            return;
+        }
+    }
+
     WTIMER0_CTL_R &= ~TIMER_CTL_TBEN;                           // Disable timer
     WTIMER0_TBV_R = 0;                                          // Reset Register
     WTIMER0_ICR_R |= TIMER_ICR_CBECINT;                         // Reset Timer interrupt
-    sB_in = true;                                               // Set flag for feedback
 }
 
 /**
@@ -117,11 +191,26 @@ void sB_interrupt_handler(void)
  **/
 void sC_interrupt_handler(void)
 {
-    g_timer_C_FIFO[g_timer_C_accumulated++] = WTIMER1_TAV_R;    // Read timer register
+    if (sC_in)                                                  // Trailing edge of the pulse
+    {
+        g_width_C = WTIMER1_TAV_R - g_capture_C;
+    }
+    else
+    {
+        g_capture_C = WTIMER1_TAV_R;                            // Read timer register
+        g_width_C = 0;
+        sC_in = true;                                           // Set flag for feedback
+
+        if (walk_capture_widths())                              // Keep counting until the trailing edge
+        {
+            WTIMER1_ICR_R |= TIMER_ICR_CAECINT;                 // Reset Timer interrupt
+            return;
+        }
+    }
+
     WTIMER1_CTL_R &= ~TIMER_CTL_TAEN;                           // Disable timer
     WTIMER1_TAV_R = 0;                                          // Reset Register
     WTIMER1_ICR_R |= TIMER_ICR_CAECINT;                         // Reset Timer interrupt
-    sC_in = true;                                               // Set flag for feedback
 }
 
 /**
@@ -146,10 +235,52 @@ void timeout_interrupt_handler(void)
 
     timer_init();                                               // Re-initialise timer as failsafe
 
-    if ((ir_in && !(sA_in && sB_in && sC_in)))
+    if (ir_in)                                                  // Only strokes started by the pen count towards health
     {
-        LED_TIMEOUT;
-        beep_now(BEEP_ERROR);
+        bool heard[HEALTH_CHANNELS] = { sA_in, sB_in, sC_in };
+        uint32_t arrival[HEALTH_CHANNELS] = { g_capture_A, g_capture_B, g_capture_C };
+        uint32_t width[HEALTH_CHANNELS] = { g_width_A, g_width_B, g_width_C };
+        uint32_t capture[ADAPTIVE_CHANNELS] =
+        {
+            correct_capture(0, g_capture_A, g_width_A),
+            correct_capture(1, g_capture_B, g_width_B),
+            correct_capture(2, g_capture_C, g_width_C),
+        };
+        capture_window_t *window[HEALTH_CHANNELS] = { &g_window_A, &g_window_B, &g_window_C };
+        uint8_t recovered = health_update(heard, capture), depth, i;
+        bool missed = false;
+
+        for (i = 0; i < HEALTH_CHANNELS; i++)
+        {
+            if (recovered & (1 << i))   window_reset(window[i], count);   // Captures from before it went down are stale
+            if (health_up(i) && !heard[i])  missed = true;
+        }
+
+        if (!missed && health_down_count() == 0)                // A complete stroke slides every window on by one
+        {
+            for (i = 0; i < HEALTH_CHANNELS; i++)
+            {
+                window_push(window[i], capture[i]);
+                if (heard[i])   walk_calibrate_add(i, arrival[i], width[i]);   // Complete strokes calibrate the walk
+            }
+            g_stroke = true;
+
+            depth = adaptive_update(capture);                   // Pen speed and noise pick the depth
+            if (adaptive_enabled() && depth != count)   set_window_depth(depth);
+        }
+        else if (!missed && health_down_count() == 1)           // Two healthy sensors carry the fix
+        {
+            for (i = 0; i < HEALTH_CHANNELS; i++)
+            {
+                if (health_up(i))   window_push(window[i], capture[i]);
+            }
+            g_stroke = true;
+        }
+        else
+        {
+            LED_TIMEOUT;
+            beep_now(BEEP_ERROR);
+        }
     }
 
     if (ir_in)
@@ -198,20 +329,9 @@ void ir_interrupt_handler(void)
 
     timer_init();                               // Re-initialise timer as failsafe
 
-    // Accept only a max of five values in FIFO to average
-    // Reset count and flush FIFO
-    if (g_timer_A_accumulated >= count||
-        g_timer_B_accumulated >= count||
-        g_timer_C_accumulated >= count
-    )
-    {
-        g_timer_A_accumulated = 0;
-        g_timer_B_accumulated = 0;
-        g_timer_C_accumulated = 0;
-        memset(g_timer_A_accumulated, 0, sizeof(g_timer_A_accumulated));
-        memset(g_timer_B_accumulated, 0, sizeof(g_timer_B_accumulated));
-        memset(g_timer_C_accumulated, 0, sizeof(g_timer_C_accumulated));
-    }
+    sA_in = sB_in = sC_in = false;              // The next edge on each sensor leads a new pulse
+    g_capture_A = g_capture_B = g_capture_C = 0;    // Nothing from an earlier stroke is carried over
+    g_width_A = g_width_B = g_width_C = 0;
 
     WTIMER0_CTL_R &= ~TIMER_CTL_TAEN;           // Stop timer 0 - Sensor A
     WTIMER0_CTL_R &= ~TIMER_CTL_TBEN;           // Stop timer 0 - Sensor B
@@ -230,118 +350,620 @@ void ir_interrupt_handler(void)
 }
 
 /**
- *      @brief Main, driver function
+ *      @brief Function to apply the averaging depth from the configuration to the capture windows
  **/
-void main(void)
+static void apply_average_depth(void)
 {
-    init_TM4C_hardware();
-    char string[100];
+    uint32_t depth = config_get(TC_AVG);
+    uint32_t min_depth = config_get(AVG_MIN), max_depth = config_get(AVG_MAX);
 
-    string_data_t *user_data;
-    uint16_t character_count;
-    uint8_t i;
+    if (depth == 0 || depth > MAX_AVERAGES) depth = 1;  // Capture only one value if nothing valid was stored
+    if (min_depth == 0 || max_depth > MAX_AVERAGES || min_depth >= max_depth)   min_depth = max_depth = 0;
 
-    count = readEeprom(TC_AVG);
+    disableNvicInterrupt(INT_WTIMER3A);                 // Strokes enter the windows from the watchdog ISR
+    adaptive_configure(min_depth, max_depth);
+    set_window_depth(adaptive_enabled() ? min_depth : depth);
+    enableNvicInterrupt(INT_WTIMER3A);
+}
 
-    if (count <= 0)     count = 1;              // Capture only one value if nothing specified by user
+/**
+ *      @brief Function to copy the capture windows without a stroke landing half way through
+ **/
+static void snapshot_windows(capture_window_t *window_A, capture_window_t *window_B, capture_window_t *window_C)
+{
+    disableNvicInterrupt(INT_WTIMER3A);
+    *window_A = g_window_A;
+    *window_B = g_window_B;
+    *window_C = g_window_C;
+    enableNvicInterrupt(INT_WTIMER3A);
+}
+
+/**
+ *      @brief Command handler to store sensor coordinates in EEPROM
+ **/
+static void command_sensor(const command_args_t *args)
+{
+    update_sensor_coordinates(args->string[0], args->integer[1], args->integer[2]);
+    putsUart0("Assuming input coordinates are in mm\r\n\r\n");
+}
+
+/**
+ *      @brief Command handler to clear the capture windows and reset the system
+ **/
+static void command_reset(const command_args_t *args)
+{
+    (void)args;
 
-    if (readEeprom(0x00) == 0xFF)               // Coordinates have not previously been written into EEPROM
+    disableNvicInterrupt(INT_WTIMER3A);
+    window_reset(&g_window_A, count);           // Reset All values
+    window_reset(&g_window_B, count);           // Reset All values
+    window_reset(&g_window_C, count);           // Reset All values
+
+    RESET;                                      // Reset System
+}
+
+/**
+ *      @brief Command handler to print the averaged distance from each sensor
+ **/
+static void command_distance(const command_args_t *args)
+{
+    capture_window_t window_A, window_B, window_C;
+
+    (void)args;
+    snapshot_windows(&window_A, &window_B, &window_C);
+    calculate_distance(&window_A, &window_B, &window_C, true);
+}
+
+/**
+ *      @brief Command handler to set the number of captures averaged per fix
+ *               average <count>        Fixed depth
+ *               average <min> <max>    Depth follows the pen speed and capture noise between min and max
+ **/
+static void command_average(const command_args_t *args)
+{
+    int32_t average = args->integer[0];
+    int32_t maximum = (args->count > 1) ? args->integer[1] : 0;
+
+    if (average <= 0 || average > MAX_AVERAGES || maximum > MAX_AVERAGES || (args->count > 1 && maximum <= average))
     {
-        putsUart0("Sensor coordinates missing!\r\n\r\n");
+        format_string(putcUart0, "ERROR! Max average of ");
+        format_uint(putcUart0, MAX_AVERAGES);
+        format_string(putcUart0, ", adaptive bounds need min < max\r\n\r\n");
+        return;
     }
 
-    while (1)
+    if (args->count > 1)
     {
-        string_input_get(&user_data);           // Read user input
-        string_parse(&user_data);               // Parse user input
+        config_set(AVG_MIN, (uint32_t)average);
+        config_set(AVG_MAX, (uint32_t)maximum);
+    }
+    else
+    {
+        config_set(TC_AVG, (uint32_t)average);  // Write the number of averages into eeprom
+        config_set(AVG_MIN, 0);                 // A fixed depth ends adaptive averaging
+        config_set(AVG_MAX, 0);
+    }
+    config_flush();
+    putsUart0("Averager updated\r\n\r\n");
+    apply_average_depth();
+}
+
+/**
+ *      @brief Command handler to update beep tones
+ **/
+static void command_beep(const command_args_t *args)
+{
+    write_beep((beep_t)args->integer[0], args->integer[1], args->integer[2],
+               (args->count > 3) ? args->integer[3] : 0, (args->count > 4) ? args->integer[4] : 0);
+    putsUart0("Beep tones updated\r\n\r\n");
+}
+
+/**
+ *      @brief Command handler to print the variance of the captures
+ **/
+static void command_variance(const command_args_t *args)
+{
+    capture_window_t window_A, window_B, window_C;
+
+    (void)args;
+    snapshot_windows(&window_A, &window_B, &window_C);
+    calculate_variance(&window_A, &window_B, &window_C);
+}
+
+/**
+ *      @brief Command handler to print the x, y coordinates of the pen
+ **/
+static void command_coord(const command_args_t *args)
+{
+    capture_window_t window_A, window_B, window_C;
+
+    (void)args;
+    snapshot_windows(&window_A, &window_B, &window_C);
+    calculate_coordinates(&window_A, &window_B, &window_C);
+}
+
+/**
+ *      @brief Command handler to store the coordinate offsets
+ **/
+static void command_fix(const command_args_t *args)
+{
+    update_fix(args->integer[0], args->integer[1]);
+    putsUart0("Fix values updated\r\n");
+}
+
+/**
+ *      @brief Command handler to print the console receive error counters
+ **/
+static void command_uart(const command_args_t *args)
+{
+    (void)args;
+
+    format_string(putcUart0, "RX overruns: ");
+    format_uint(putcUart0, getUart0OverrunCount());
+    format_string(putcUart0, "\r\nRX buffer drops: ");
+    format_uint(putcUart0, getUart0DropCount());
+    format_string(putcUart0, "\r\nLines too long: ");
+    format_uint(putcUart0, string_input_too_long_count());
+    format_string(putcUart0, "\r\n\r\n");
+}
+
+/**
+ *      @brief Command handler for bulk configuration transfer
+ *               config load <words> <crc32>    Start a transactional upload
+ *               config data <word> ...         Append words, commits when the announced length is reached
+ *               config abort                   Discard a partial upload
+ *               config dump                    Print the configuration as a script for "config load"
+ **/
+static void command_config(const command_args_t *args)
+{
+    const char *action = args->string[0];
+
+    if (strcmp(action, "load") == 0 && args->count == 3)
+    {
+        config_load_begin((uint32_t)args->integer[1], (uint32_t)args->integer[2]);
+    }
+    else if (strcmp(action, "data") == 0 && args->count > 1)
+    {
+        config_load_data(&args->integer[1], args->count - 1);
+
+        apply_average_depth();                  // Averaging depth may have changed
+        update_solver_constants();
+    }
+    else if (strcmp(action, "abort") == 0 && args->count == 1)
+    {
+        config_load_abort();
+    }
+    else if (strcmp(action, "dump") == 0 && args->count == 1)
+    {
+        config_dump();
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: config <load words crc|data word...|abort|dump>\r\n\r\n");
+    }
+}
+
+/**
+ *      @brief Command handler for the spatial correction grid, built by host/grid_builder.c
+ *               grid                           Print the state of the grid
+ *               grid on|off                    Correct fixes with the stored grid, or not
+ *               grid load <crc32>              Start an upload of the grid words
+ *               grid data <word> ...           Append words, commits when the grid is complete
+ **/
+static void command_grid(const command_args_t *args)
+{
+    const char *action = (args->count > 0) ? args->string[0] : "";
+
+    if (args->count == 0)
+    {
+        grid_print();
+    }
+    else if ((strcmp(action, "on") == 0 || strcmp(action, "off") == 0) && args->count == 1)
+    {
+        grid_enable(strcmp(action, "on") == 0);
+        grid_print();
+    }
+    else if (strcmp(action, "load") == 0 && args->count == 2)
+    {
+        grid_upload_begin((uint32_t)args->integer[1]);
+    }
+    else if (strcmp(action, "data") == 0 && args->count > 1)
+    {
+        grid_upload_data(&args->integer[1], args->count - 1);
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: grid [on|off|load crc|data word...]\r\n\r\n");
+    }
+}
+
+/**
+ *      @brief Command handler for the health of the ultrasound channels, see health.c
+ *               health                         Print each sensor and whether it is tracked on two ranges
+ *               health reset                   Mark every sensor up again and clear the captures
+ **/
+static void command_health(const command_args_t *args)
+{
+    if (args->count == 1 && strcmp(args->string[0], "reset") == 0)
+    {
+        disableNvicInterrupt(INT_WTIMER3A);     // Windows and health are updated by the watchdog ISR
+        health_reset();
+        window_reset(&g_window_A, count);
+        window_reset(&g_window_B, count);
+        window_reset(&g_window_C, count);
+        enableNvicInterrupt(INT_WTIMER3A);
+    }
+    else if (args->count != 0)
+    {
+        putsUart0("ERROR! Usage: health [reset]\r\n\r\n");
+        return;
+    }
 
-        IS_COMMAND("sensor", 4)                 // Compare and act on user input
+    health_print();
+}
+
+/**
+ *      @brief Command handler for the mapping of fixes onto the writing surface
+ *               surface                        Print the mapping and the reference points waiting
+ *               surface tap <u> <v>            Pair the fix of a pen held still with surface point u, v
+ *               surface fit                    Fit the mapping to four or more points and store it
+ *               surface clear                  Back to the identity
+ **/
+static void command_surface(const command_args_t *args)
+{
+    capture_window_t window_A, window_B, window_C;
+    const char *action = (args->count > 0) ? args->string[0] : "";
+    float x, y;
+
+    if (args->count == 0)
+    {
+        surface_print();
+    }
+    else if (strcmp(action, "tap") == 0 && args->count == 3)
+    {
+        snapshot_windows(&window_A, &window_B, &window_C);
+        if (!calculate_position(&window_A, &window_B, &window_C, &x, &y))
         {
-            // Store sensor coordinates in EEPROM
-            update_sensor_coordinates (
-                                        getFieldString(&user_data, 1),
-                                        (int32_t)getFieldInteger(&user_data, 2),
-                                        (int32_t)getFieldInteger(&user_data, 3)
-                                    );
-            putsUart0("Assuming input coordinates are in mm\r\n\r\n");
-            continue;
+            putsUart0("ERROR! No strokes captured yet\r\n\r\n");
+            return;
+        }
+        if (!surface_tap(x, y, args->integer[1], args->integer[2]))
+        {
+            putsUart0("ERROR! Too many reference points, fit or clear first\r\n\r\n");
+            return;
         }
+        surface_print();
+    }
+    else if (strcmp(action, "fit") == 0 && args->count == 1)
+    {
+        if (!surface_fit())
+        {
+            putsUart0("ERROR! Tap at least four points that are not all on one line\r\n\r\n");
+            return;
+        }
+        surface_print();
+    }
+    else if (strcmp(action, "clear") == 0 && args->count == 1)
+    {
+        surface_clear();
+        surface_print();
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: surface [tap u v|fit|clear]\r\n\r\n");
+    }
+}
 
-        IS_COMMAND("reset", 1)
+/**
+ *      @brief Command handler for the receive chain latencies
+ *               latency                        Print the latencies
+ *               latency cal <x> <y>            Add the averaged strokes of a pen held at x, y
+ *               latency save                   Store the latencies from the positions added
+ **/
+static void command_latency(const command_args_t *args)
+{
+    capture_window_t window_A, window_B, window_C;
+    const char *action = (args->count > 0) ? args->string[0] : "";
+
+    if (args->count == 0)
+    {
+        print_latency();
+    }
+    else if (strcmp(action, "cal") == 0 && args->count == 3)
+    {
+        snapshot_windows(&window_A, &window_B, &window_C);
+        if (!calibrate_latency_add(&window_A, &window_B, &window_C, args->integer[1], args->integer[2]))
         {
-            for (i = 0; i < MAX_FIFO_SIZE; i++)
-            {
-                g_timer_A_FIFO[i] = 0;
-                g_timer_B_FIFO[i] = 0;
-                g_timer_C_FIFO[i] = 0;
-            }
-            g_timer_A_accumulated = 0;          // Reset All values
-            g_timer_B_accumulated = 0;          // Reset All values
-            g_timer_C_accumulated = 0;          // Reset All values
+            putsUart0("ERROR! No strokes captured yet\r\n\r\n");
+            return;
+        }
+        print_latency();
+    }
+    else if (strcmp(action, "save") == 0 && args->count == 1)
+    {
+        if (!calibrate_latency_save())
+        {
+            putsUart0("ERROR! Add a position with \"latency cal x y\" first\r\n\r\n");
+            return;
+        }
+        print_latency();
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: latency [cal x y|save]\r\n\r\n");
+    }
+}
 
-            RESET;                              // Reset System
-            continue;
+/**
+ *      @brief Command handler to show or hide the pen trail map and the fix rate and quality line
+ **/
+static void command_map(const command_args_t *args)
+{
+    if (strcmp(args->string[0], "on") == 0)
+    {
+        minimap_enable(true);
+    }
+    else if (strcmp(args->string[0], "off") == 0)
+    {
+        minimap_enable(false);
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: map <on|off>\r\n\r\n");
+        return;
+    }
+    putsUart0("Display updated\r\n\r\n");
+}
+
+/**
+ *      @brief Command handler to choose between text lines and binary frames for the fixes
+ **/
+static void command_output(const command_args_t *args)
+{
+    if (strcmp(args->string[0], "text") == 0)
+    {
+        set_fix_output(false);
+    }
+    else if (strcmp(args->string[0], "binary") == 0)
+    {
+        set_fix_output(true);
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: output <text|binary>\r\n\r\n");
+        return;
+    }
+    putsUart0("Fix output updated\r\n\r\n");
+}
+
+/**
+ *      @brief Command handler for calibration profiles
+ *               profile                        List the profiles, the active one is marked
+ *               profile use <n>                Switch to profile n, in RAM until saved
+ *               profile save <n> <name>        Store the current calibration as profile n
+ **/
+static void command_profile(const command_args_t *args)
+{
+    const char *action = (args->count > 0) ? args->string[0] : "list";
+
+    if (strcmp(action, "list") == 0 && args->count <= 1)
+    {
+        profile_list();
+    }
+    else if (strcmp(action, "use") == 0 && args->count == 2)
+    {
+        if (!profile_use((uint8_t)args->integer[1]))
+        {
+            putsUart0("ERROR! No such profile\r\n\r\n");
+            return;
         }
 
-        IS_COMMAND("distance", 1)
+        apply_average_depth();                  // Averaging depth comes with the profile
+        putsUart0("Profile loaded until reset, save it to keep it\r\n\r\n");
+    }
+    else if (strcmp(action, "save") == 0 && args->count == 3)
+    {
+        if (!profile_save((uint8_t)args->integer[1], args->string[2]))
         {
-            calculate_distance(g_timer_A_FIFO, g_timer_B_FIFO, g_timer_C_FIFO, true); // Output distance
-            continue;
+            format_string(putcUart0, "ERROR! Profile number must be below ");
+            format_uint(putcUart0, PROFILE_COUNT);
+            format_string(putcUart0, "\r\n\r\n");
+            return;
         }
+        putsUart0("Profile saved\r\n\r\n");
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: profile [list|use n|save n name]\r\n\r\n");
+    }
+}
+
+/**
+ *      @brief Command handler to set the speed of sound relative to 343 m/s, e.g. "sound 1.006" at 30 C
+ **/
+static void command_sound(const command_args_t *args)
+{
+    int32_t scale = args->integer[0];           // Thousandths
+
+    if (scale < 500 || scale > 1500)
+    {
+        putsUart0("ERROR! Scale must be between 0.5 and 1.5\r\n\r\n");
+        return;
+    }
+
+    config_set(SOS_SCALE, (uint32_t)scale * 1000);
+    config_flush();
+    update_solver_constants();
+    putsUart0("Speed of sound updated\r\n\r\n");
+}
 
-        IS_COMMAND("average", 2)
+/**
+ *      @brief Command handler for the comparator walk correction
+ *               walk                           Print the correction tables
+ *               walk <on|off>                  Capture both pulse edges and correct arrivals, or not
+ *               walk cal <x> <y>               Collect calibration strokes with the pen held at x, y
+ *               walk save                      Store the tables from the strokes collected
+ **/
+static void command_walk(const command_args_t *args)
+{
+    const char *action = (args->count > 0) ? args->string[0] : "";
+    uint32_t expected[WALK_CHANNELS];
+    bool saved;
+
+    if (args->count == 0)
+    {
+        walk_print();
+        return;
+    }
+    else if ((strcmp(action, "on") == 0 || strcmp(action, "off") == 0) && args->count == 1)
+    {
+        config_set(WALK_MODE, strcmp(action, "on") == 0);
+        config_flush();
+    }
+    else if (strcmp(action, "cal") == 0 && args->count == 3)
+    {
+        calculate_expected_ticks(args->integer[1], args->integer[2], expected);
+        disableNvicInterrupt(INT_WTIMER3A);             // Strokes are collected from the watchdog ISR
+        walk_calibrate_begin(expected);
+        enableNvicInterrupt(INT_WTIMER3A);
+        putsUart0("Calibrating, stroke at this position then move on or \"walk save\"\r\n\r\n");
+        return;
+    }
+    else if (strcmp(action, "save") == 0 && args->count == 1)
+    {
+        disableNvicInterrupt(INT_WTIMER3A);
+        saved = walk_calibrate_save();
+        enableNvicInterrupt(INT_WTIMER3A);
+        if (!saved)
         {
-            uint32_t average = (uint32_t)getFieldInteger(&user_data, 1);
+            putsUart0("ERROR! A sensor collected no pulse widths\r\n\r\n");
+            return;
+        }
+    }
+    else
+    {
+        putsUart0("ERROR! Usage: walk [on|off|cal x y|save]\r\n\r\n");
+        return;
+    }
+    putsUart0("Walk correction updated\r\n\r\n");
+}
 
-            if (average > MAX_AVERAGES)
-            {
-                fprintf(string, "ERROR! Max average of %d\r\n\r\n", MAX_AVERAGES);
-                putsUart0(string);
-            }
-            else
-            {
-                writeEeprom(TC_AVG, (uint32_t)average); // Write the number of averages into eeprom
-                putsUart0("Averager updated\r\n\r\n");
-                count = average;
-            }
+#ifdef BENCH
+/**
+ *      @brief Command handler to run the microbenchmarks, build with --define=BENCH
+ **/
+static void command_bench(const command_args_t *args)
+{
+    (void)args;
 
-            continue;
+    bench_run_all();
+}
+#endif
+
+/**
+ *      @brief Registry of terminal commands, must stay sorted by name
+ **/
+static const command_t g_commands[] =
+{
+    //  name        min max types   usage                                   handler
+    {   "average",  1,  2,  "ii",   "average <count> | <min> <max>",        command_average     },
+    {   "beep",     3,  5,  "iiiii", "beep <type> <load> <on> [off] [count]", command_beep        },
+#ifdef BENCH
+    {   "bench",    0,  0,  "",     "bench",                                command_bench       },
+#endif
+    {   "config",   1,  7,  "siiiiii", "config <load|data|abort|dump> ...", command_config      },
+    {   "coord",    0,  0,  "",     "coord",                                command_coord       },
+    {   "distance", 0,  0,  "",     "distance",                             command_distance    },
+    {   "fix",      2,  2,  "ii",   "fix <x offset> <y offset>",            command_fix         },
+    {   "grid",     0,  7,  "siiiiii", "grid [on|off|load|data] ...",       command_grid        },
+    {   "health",   0,  1,  "s",    "health [reset]",                       command_health      },
+    {   "latency",  0,  3,  "sii",  "latency [cal x y|save]",               command_latency     },
+    {   "map",      1,  1,  "s",    "map <on|off>",                         command_map         },
+    {   "output",   1,  1,  "s",    "output <text|binary>",                 command_output      },
+    {   "profile",  0,  3,  "sis",  "profile [list|use n|save n name]",     command_profile     },
+    {   "reset",    0,  0,  "",     "reset",                                command_reset       },
+    {   "sensor",   3,  3,  "sii",  "sensor <A|B|C> <x> <y>",               command_sensor      },
+    {   "sound",    1,  1,  "d",    "sound <scale>",                        command_sound       },
+    {   "surface",  0,  3,  "sii",  "surface [tap u v|fit|clear]",          command_surface     },
+    {   "uart",     0,  0,  "",     "uart",                                 command_uart        },
+    {   "variance", 0,  0,  "",     "variance",                             command_variance    },
+    {   "walk",     0,  3,  "sii",  "walk [on|off|cal x y|save]",           command_walk        },
+};
+
+#define COMMAND_COUNT   (sizeof(g_commands) / sizeof(g_commands[0]))
+
+/**
+ *      @brief Main, driver function
+ **/
+void main(void)
+{
+#ifdef BENCH
+    bench_init();                               // Cycle counter measures boot to armed
+#endif
+    init_TM4C_hardware();
+
+    string_data_t user_data;
+
+    apply_average_depth();
+
+    switch (config_status())
+    {
+        case CONFIG_BLANK:                      // Coordinates have not previously been written into EEPROM
+        {
+            putsUart0("Sensor coordinates missing!\r\n\r\n");
+            break;
         }
 
-        IS_COMMAND("beep", 4)                           // Update beep tones
+        case CONFIG_CORRUPT:                    // Header or CRC invalid, running on defaults
         {
-            int32_t type = (int32_t)getFieldInteger(&user_data, 1);
-            int32_t load = (int32_t)getFieldInteger(&user_data, 2);
-            int32_t per1 = (int32_t)getFieldInteger(&user_data, 3);
-
-            write_beep(type, load, per1);
-            // write_beep(0, 1, 1);
-            // write_beep(1, 2, 2);
-            // write_beep(2, 3, 2);
-            // write_beep(3, 4, 2);
-            // write_beep(4, 5, 3);
-
-            putsUart0("Beep tones updated\r\n\r\n");
+            putsUart0("Configuration corrupt, defaults loaded!\r\n\r\n");
+            break;
         }
 
-        IS_COMMAND("variance", 1)
+        case CONFIG_MIGRATED:
         {
-            calculate_variance(g_timer_A_FIFO, g_timer_B_FIFO, g_timer_C_FIFO); // Output Variance
+            putsUart0("Configuration upgraded to the current EEPROM layout\r\n\r\n");
+            break;
         }
 
-        IS_COMMAND("coord", 1)
+        default:
+        {
+            break;
+        }
+    }
+
+    dispatch_check(g_commands, COMMAND_COUNT);  // Lookup is a binary search, flag an unsorted registry early
+
+#ifdef BENCH
+    bench_boot_armed();
+#endif
+
+    while (1)
+    {
+        journal_service();                      // Compact the EEPROM journal a step at a time
+        refreshLcd(timer_ms());                 // Send the display cells that changed
+
+        if (health_changed())                   // A sensor went down or came back
         {
-            calculate_coordinates();
+            health_print();
         }
 
-        IS_COMMAND("fix", 3)
+        if (g_stroke)                           // Every stroke gives a fresh averaged fix
         {
-            int32_t x_fix = (int32_t)getFieldInteger(&user_data, 1);
-            int32_t y_fix = (int32_t)getFieldInteger(&user_data, 2);
+            capture_window_t window_A, window_B, window_C;
+            int32_t x, y;
 
-            update_fix(x_fix, y_fix);
+            g_stroke = false;
+            snapshot_windows(&window_A, &window_B, &window_C);
+            track_stroke(&window_A, &window_B, &window_C, &x, &y);
+        }
 
-            putsUart0("Fix values updated\r\n");
+        if (!string_input_poll(&user_data))     // Assemble user input without blocking
+        {
+            continue;
         }
+
+        string_parse(&user_data);               // Parse user input
+        dispatch_command(g_commands, COMMAND_COUNT, &user_data);   // Validate, convert arguments and run
     }
 }
@@ -0,0 +1,194 @@
+/**
+*      @file minimap.c
+*      @author Prithvi Bhat
+*      @brief Live pen trail drawn into the LCD's custom characters, with a fix rate and quality line
+*               * The last MINIMAP_TRAIL fixes are scaled onto a 20x16 pixel raster made of the eight 5x8
+*                 CGRAM characters, placed to the right of the coordinate readout
+*               * Each pixel counts the trail fixes on it, so adding a fix and retiring the oldest one
+*                 touches at most two pixels and only their glyph rows are handed to the LCD shadow,
+*                 which uploads a row only if its pattern changed
+*               * The status line shows the fix rate over the trail and the share of the last 16
+*                 attempts that produced a fix
+**/
+
+#include "minimap.h"
+#include "i2c0_lcd.h"
+#include "format.h"
+
+#define ATTEMPT_HISTORY     16                  // Attempts behind the quality figure, bits of g_attempts
+
+/**
+*      @brief One fix of the trail, already scaled to map pixels
+**/
+typedef struct
+{
+    uint8_t x;
+    uint8_t y;
+    uint32_t ms;
+} minimap_point_t;
+
+// Global Variables
+static minimap_point_t g_trail[MINIMAP_TRAIL];
+static uint8_t g_trail_head = 0, g_trail_count = 0;
+static uint8_t g_hits[MINIMAP_HEIGHT][MINIMAP_WIDTH];   // Trail fixes on each pixel
+static int32_t g_width_mm = 300, g_height_mm = 200;
+static uint16_t g_attempts = 0;                         // 1 for a fix, 0 for a miss, newest in bit 0
+static uint8_t g_attempt_count = 0;
+static bool g_enabled = false;
+
+/**
+*      @brief Function to hand one pixel row of a glyph to the LCD shadow
+*      @param x any pixel column inside the glyph
+*      @param y pixel row
+**/
+static void minimap_draw_row(uint8_t x, uint8_t y)
+{
+    uint8_t first = x - x % 5, bits = 0, i;
+
+    if (!g_enabled)     return;
+
+    for (i = 0; i < 5; i++)     bits = (bits << 1) | (g_hits[y][first + i] != 0);
+    setLcdGlyphRow((y / 8) * MINIMAP_GLYPH_COLS + first / 5, y % 8, bits);
+}
+
+/**
+*      @brief Function to scale a coordinate onto the map, positions off the writing area stick to its edge
+*      @param value position in mm
+*      @param range_mm size of the writing area along this axis
+*      @param pixels size of the map along this axis
+**/
+static uint8_t minimap_scale(int32_t value, int32_t range_mm, uint8_t pixels)
+{
+    if (value <= 0 || range_mm <= 0)    return 0;
+    if (value >= range_mm)              return pixels - 1;
+    return (uint8_t)((value * pixels) / range_mm);
+}
+
+/**
+*      @brief Function to write the rate and quality line
+**/
+static void minimap_draw_status(void)
+{
+    char line[LCD_COLS + 1];
+    uint32_t rate = 0, good = 0;
+    uint8_t i, length;
+
+    if (!g_enabled)     return;
+
+    if (g_trail_count > 1)                                                      // Tenths of a fix per second
+    {
+        uint32_t newest = g_trail[(g_trail_head + MINIMAP_TRAIL - 1) % MINIMAP_TRAIL].ms;
+        uint32_t oldest = g_trail[(g_trail_head + MINIMAP_TRAIL - g_trail_count) % MINIMAP_TRAIL].ms;
+        if (newest != oldest)   rate = ((g_trail_count - 1) * 10000) / (newest - oldest);
+    }
+    for (i = 0; i < g_attempt_count; i++)   good += (g_attempts >> i) & 1;
+
+    format_buffer_begin(line, sizeof(line));
+    format_fixed(format_buffer_put, rate, 1);
+    format_string(format_buffer_put, "Hz Q ");
+    format_uint(format_buffer_put, (g_attempt_count != 0) ? (good * 100) / g_attempt_count : 0);
+    format_string(format_buffer_put, "%");
+
+    for (length = 0; line[length] != '\0'; length++);
+    while (length < LCD_COLS)   line[length++] = ' ';                           // Clear what a longer line left
+    line[length] = '\0';
+    putsLcd(MINIMAP_STATUS_ROW, 0, line);
+}
+
+/**
+*      @brief Function to record a fix attempt for the quality figure
+**/
+static void minimap_attempt(bool success)
+{
+    g_attempts = (g_attempts << 1) | success;
+    if (g_attempt_count < ATTEMPT_HISTORY)  g_attempt_count++;
+}
+
+/**
+*      @brief Function to set the size of the writing area the map covers
+*               Call when the sensor geometry changes, the trail is cleared
+**/
+void minimap_set_area(int32_t width_mm, int32_t height_mm)
+{
+    uint8_t x, y;
+
+    if (width_mm == g_width_mm && height_mm == g_height_mm && g_trail_count != 0)    return;
+
+    g_width_mm = width_mm;
+    g_height_mm = height_mm;
+
+    g_trail_count = 0;
+    for (y = 0; y < MINIMAP_HEIGHT; y++)
+    {
+        for (x = 0; x < MINIMAP_WIDTH; x++)     g_hits[y][x] = 0;
+    }
+    for (y = 0; y < MINIMAP_HEIGHT; y++)
+    {
+        for (x = 0; x < MINIMAP_WIDTH; x += 5)  minimap_draw_row(x, y);
+    }
+}
+
+/**
+*      @brief Function to show or hide the map and status line, the trail is kept while hidden
+**/
+void minimap_enable(bool enable)
+{
+    char codes[MINIMAP_GLYPH_COLS + 1];
+    uint8_t x, y;
+
+    g_enabled = enable;
+
+    for (y = 0; y < MINIMAP_GLYPH_ROWS; y++)                                    // Place the glyphs, or blank them
+    {
+        for (x = 0; x < MINIMAP_GLYPH_COLS; x++)    codes[x] = enable ? LCD_GLYPH_CODE + y * MINIMAP_GLYPH_COLS + x : ' ';
+        codes[x] = '\0';
+        putsLcd(MINIMAP_LCD_ROW + y, MINIMAP_LCD_COL, codes);
+    }
+
+    if (!enable)
+    {
+        putsLcd(MINIMAP_STATUS_ROW, 0, "                    ");
+        return;
+    }
+
+    for (y = 0; y < MINIMAP_HEIGHT; y++)
+    {
+        for (x = 0; x < MINIMAP_WIDTH; x += 5)  minimap_draw_row(x, y);
+    }
+    minimap_draw_status();
+}
+
+/**
+*      @brief Function to add a fix to the trail, retiring the oldest one once the trail is full
+*      @param x_mm, y_mm pen position, y grows towards the top of the map
+*      @param ms time of the fix
+**/
+void minimap_add_fix(int32_t x_mm, int32_t y_mm, uint32_t ms)
+{
+    minimap_point_t *point = &g_trail[g_trail_head];
+
+    if (g_trail_count == MINIMAP_TRAIL)                                         // Slot holds the oldest fix
+    {
+        if (--g_hits[point->y][point->x] == 0)  minimap_draw_row(point->x, point->y);
+    }
+    else    g_trail_count++;
+
+    point->x = minimap_scale(x_mm, g_width_mm, MINIMAP_WIDTH);
+    point->y = MINIMAP_HEIGHT - 1 - minimap_scale(y_mm, g_height_mm, MINIMAP_HEIGHT);
+    point->ms = ms;
+    if (g_hits[point->y][point->x]++ == 0)  minimap_draw_row(point->x, point->y);
+
+    g_trail_head = (g_trail_head + 1) % MINIMAP_TRAIL;
+
+    minimap_attempt(true);
+    minimap_draw_status();
+}
+
+/**
+*      @brief Function to record an attempt that did not produce a fix
+**/
+void minimap_add_miss(void)
+{
+    minimap_attempt(false);
+    minimap_draw_status();
+}
@@ -0,0 +1,27 @@
+/**
+*      @file minimap.h
+*      @author Prithvi Bhat
+*      @brief Live pen trail drawn into the LCD's custom characters, with a fix rate and quality line
+**/
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define MINIMAP_GLYPH_COLS  4                               // Custom characters across the map
+#define MINIMAP_GLYPH_ROWS  2                               // Custom characters down the map
+#define MINIMAP_WIDTH       (MINIMAP_GLYPH_COLS * 5)        // Pixels
+#define MINIMAP_HEIGHT      (MINIMAP_GLYPH_ROWS * 8)        // Pixels
+#define MINIMAP_TRAIL       32                              // Fixes kept on the map
+#define MINIMAP_LCD_ROW     0                               // Top left character of the map
+#define MINIMAP_LCD_COL     16
+#define MINIMAP_STATUS_ROW  2                               // LCD row of the rate and quality line
+
+// Function prototypes
+void minimap_set_area(int32_t width_mm, int32_t height_mm);
+void minimap_enable(bool enable);
+void minimap_add_fix(int32_t x_mm, int32_t y_mm, uint32_t ms);
+void minimap_add_miss(void);
+
+#endif
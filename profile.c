@@ -0,0 +1,155 @@
+/**
+*      @file profile.c
+*      @author Prithvi Bhat
+*      @brief Named calibration profiles stored in EEPROM
+*               * Each profile takes one EEPROM block: name, sensor coordinates, fix values, averaging depth,
+*                 speed of sound scale, a CRC and the mapping and grid tags, see eeprom_memory_map.h
+*               * All profiles are read into RAM at boot. "profile use" copies one cached record into the
+*                 live configuration in RAM only and recomputes the solver constants once, nothing is
+*                 written until "profile save" stores the profile and makes the switch permanent
+*               * Latencies and walk offsets belong to the receive chains, not to where the receiver sits,
+*                 and are shared by every profile. The surface mapping and the correction grid do depend
+*                 on the geometry but are too large for a profile block, so a profile records which ones
+*                 it was saved with and "profile use" turns either off, in RAM, when it does not match
+*               * A block whose CRC does not match, including an erased one, is an empty slot. The tags
+*                 are outside the CRC, a block saved before them reads as matching no mapping or grid
+**/
+
+#include "profile.h"
+#include "config.h"
+#include "commands.h"
+#include "eeprom.h"
+#include "surface.h"
+#include "format.h"
+#include "uart0.h"
+
+#define PROFILE_WORDS           (PROFILE_GRID + 1)
+#define PROFILE_ADDRESS(i, w)   (PROFILE_BASE + (i) * EEPROM_BLOCK_WORDS + (w))
+
+/**
+*      @brief Cached copy of one profile block
+**/
+typedef struct
+{
+    uint32_t word[PROFILE_WORDS];
+    bool valid;
+} profile_t;
+
+// Global Variables
+static profile_t g_profiles[PROFILE_COUNT];
+
+// Configuration words held by a profile, in the order they are stored from PROFILE_DATA
+static const uint8_t g_profile_fields[PROFILE_FIELDS] =
+{
+    CRD_AX, CRD_AY, CRD_BX, CRD_BY, CRD_CX, CRD_CY, FIX_X, FIX_Y, TC_AVG, SOS_SCALE
+};
+
+/**
+*      @brief Function to read every profile block into RAM
+**/
+void profile_init(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < PROFILE_COUNT; i++)
+    {
+        readEepromBlock(PROFILE_ADDRESS(i, 0), g_profiles[i].word, PROFILE_WORDS);
+
+        g_profiles[i].valid = (config_crc32(g_profiles[i].word, PROFILE_CRC) == g_profiles[i].word[PROFILE_CRC]);
+    }
+}
+
+/**
+*      @brief Function to make a profile the active configuration, in RAM until profile_save()
+*      @param index profile number
+*      @return bool false if there is no such profile
+**/
+bool profile_use(uint8_t index)
+{
+    const uint32_t *word;
+    uint8_t f;
+
+    if (index >= PROFILE_COUNT || !g_profiles[index].valid)    return false;
+    word = g_profiles[index].word;
+
+    for (f = 0; f < PROFILE_FIELDS; f++)    config_hold(g_profile_fields[f], word[PROFILE_DATA + f]);
+    config_hold(PROFILE_ACTIVE, index);
+
+    surface_restore();                                                          // Stored calibration, if it is
+    if (surface_tag() != word[PROFILE_SURFACE])     surface_suspend();          // the one saved with the profile
+    config_revert(GRID_MODE);
+    if (config_get(GRID_CRC) != word[PROFILE_GRID]) config_hold(GRID_MODE, 0);
+
+    update_solver_constants();
+    return true;
+}
+
+/**
+*      @brief Function to store the active configuration as a profile and keep it, only changed words
+*               are written. A mapping or grid turned off by profile_use() stays off
+*      @param index profile number
+*      @param name up to PROFILE_NAME_LENGTH characters, longer names are cut
+*      @return bool false if there is no such profile slot
+**/
+bool profile_save(uint8_t index, const char *name)
+{
+    uint32_t record[PROFILE_WORDS] = {0};
+    uint8_t i;
+
+    if (index >= PROFILE_COUNT)     return false;
+
+    for (i = 0; i < PROFILE_NAME_LENGTH && name[i] != '\0'; i++)                // Pack the name, 4 characters per word
+    {
+        record[PROFILE_NAME + i / 4] |= (uint32_t)(uint8_t)name[i] << ((i % 4) * 8);
+    }
+
+    for (i = 0; i < PROFILE_FIELDS; i++)    record[PROFILE_DATA + i] = config_get(g_profile_fields[i]);
+    record[PROFILE_CRC] = config_crc32(record, PROFILE_CRC);
+    record[PROFILE_SURFACE] = surface_tag();
+    record[PROFILE_GRID] = config_get(GRID_CRC);
+
+    for (i = 0; i < PROFILE_WORDS; i++)                                         // A torn save reads as empty, or as
+    {                                                                           // saved without mapping and grid
+        if (g_profiles[index].word[i] != record[i])
+        {
+            writeEeprom(PROFILE_ADDRESS(index, i), record[i]);
+            g_profiles[index].word[i] = record[i];
+        }
+    }
+    g_profiles[index].valid = true;
+
+    config_set(PROFILE_ACTIVE, index);
+    config_keep();                                                              // Store a switch made by profile_use()
+    return true;
+}
+
+/**
+*      @brief Function to print the profile slots, the active one is marked with '*'
+**/
+void profile_list(void)
+{
+    uint8_t i, c;
+
+    for (i = 0; i < PROFILE_COUNT; i++)
+    {
+        format_string(putcUart0, "Profile ");
+        format_uint(putcUart0, i);
+        format_string(putcUart0, ": ");
+
+        if (!g_profiles[i].valid)
+        {
+            format_string(putcUart0, "empty\r\n");
+            continue;
+        }
+
+        for (c = 0; c < PROFILE_NAME_LENGTH; c++)
+        {
+            char character = (g_profiles[i].word[PROFILE_NAME + c / 4] >> ((c % 4) * 8)) & 0xFF;
+            if (character == '\0')  break;
+            putcUart0(character);
+        }
+
+        format_string(putcUart0, (config_get(PROFILE_ACTIVE) == i) ? " *\r\n" : "\r\n");
+    }
+    format_string(putcUart0, "\r\n");
+}
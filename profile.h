@@ -0,0 +1,22 @@
+/**
+*      @file profile.h
+*      @author Prithvi Bhat
+*      @brief Named calibration profiles stored in EEPROM
+**/
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+#include "eeprom_memory_map.h"
+
+#define PROFILE_NAME_LENGTH 8           // Characters, stored without terminator
+#define PROFILE_FIELDS      10          // Coordinates, fix values, averages and speed of sound scale
+
+// Function prototypes
+void profile_init(void);
+bool profile_use(uint8_t index);
+bool profile_save(uint8_t index, const char *name);
+void profile_list(void);
+
+#endif
@@ -7,6 +7,7 @@
 #include "uart0.h"
 #include "strings.h"
 #include "inttypes.h"
+#include <string.h>
 
 #define ASCII_BACKSPACE         8
 #define ASCII_DELETE            127
@@ -22,75 +23,182 @@
 #define ASSERT_EOL(c)           ((c == ASCII_CARRIAGE_RETURN) ? 1 : 0)                  // Macro to validate if character is ASCII carriage return
 #define ASSERT_BUFFER_FULL(c)   ((c >= (MAX_STRING_LENGTH - 1)) ? 1 : 0)                // Macro to validate if input string buffer is full
 #define ASSERT_NUMBER(c)        ((c >= 48) && (c <= 57) ? 1 : 0)                        // Macro to validate if character is number
+#define ASSERT_HEX(c)           ((ASSERT_NUMBER(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) ? 1 : 0)
+#define HEX_VALUE(c)            (ASSERT_NUMBER(c) ? (c - '0') : ((c | 0x20) - 'a' + 10))  // Macro to convert a hex digit
 
 
+// Line assembly state for string_input_poll
+static uint8_t g_line_length = 0;                                                       // Characters assembled so far
+static bool g_line_discard = false;                                                     // Set while skipping the rest of an over-long line
+static uint32_t g_line_too_long = 0;                                                    // Lines discarded for exceeding MAX_STRING_LENGTH
+
 // Macro to validate if character is an alphabet
 #define ASSERT_ALPHABET(c)      ((((c >= ASCII_UPPER_ALPHABET_A) && (c <= ASCII_UPPER_ALPHABET_Z)) || ((c >= ASCII_LOWER_ALPHABET_A) && (c <= ASCII_LOWER_ALPHABET_Z))) ? 1 : 0)
 /**
-*      @brief Function to get user input over UART
-*      @param user_data Pointer to user_data structure
+*      @brief Function to assemble user input from the UART receive buffer without blocking
+*               Lines longer than the input buffer are discarded whole and counted
+*      @param user_data Pointer to user_data structure, input_string holds the line being assembled
+*      @return true once a complete line is available in user_data->input_string
 **/
-void string_input_get(string_data_t *user_data)
+bool string_input_poll(string_data_t *user_data)
 {
-    uint8_t character;
-    uint16_t character_count;
+    char character;
 
-    for (character_count = 0; character_count < MAX_STRING_LENGTH; character_count++)
+    while (readUart0(&character))                                                       // Drain what the ISR has buffered
     {
-        character = getcUart0();                                                        // Read characters from user terminal
-        if (ASSERT_CLEAR(character) && character_count > 0)                             // Validate
+        if (ASSERT_EOL(character))
         {
-            character_count--;                                                          // Decrement character count
+            bool complete = !g_line_discard;
+
+            user_data->input_string[g_line_length] = '\0';
+            RESET(g_line_length);
+            g_line_discard = false;
+
+            if (complete)   return true;
+            continue;
         }
 
-        if (ASSERT_EOL(character) || ASSERT_BUFFER_FULL(character_count))               // Validate
+        if (g_line_discard)                                                             // Skip until end of line
         {
-            user_data->input_string[character_count] = '\0';                            // Indicate string has been complete and return
-            return;
+            continue;
         }
 
-        if (ASSERT_PRINTABLE(character))                                                // Validate
+        if (ASSERT_CLEAR(character))
         {
-            user_data->input_string[character_count] = character;                       // Append character to user input buffer
+            if (g_line_length > 0)  g_line_length--;                                    // Decrement character count
+        }
+        else if (ASSERT_PRINTABLE(character))
+        {
+            if (ASSERT_BUFFER_FULL(g_line_length))
+            {
+                g_line_too_long++;
+                g_line_discard = true;
+            }
+            else
+            {
+                user_data->input_string[g_line_length++] = character;                   // Append character to user input buffer
+            }
         }
     }
+    return false;
 }
 
 /**
-*      @brief Function to parse the contents of the input string
+*      @brief Function to read the number of input lines discarded for being too long
+*      @return uint32_t count since reset
+**/
+uint32_t string_input_too_long_count(void)
+{
+    return g_line_too_long;
+}
+
+/**
+*      @brief Function to convert the fraction digits of a decimal token to fixed point
+*      @param string pointer to the first digit after the decimal point, advanced past all digits
+*      @return int32_t fraction in units of 1 / FIELD_DECIMAL_SCALE
+**/
+static int32_t string_parse_fraction(char **string)
+{
+    int32_t fraction = 0, scale = FIELD_DECIMAL_SCALE;
+    char *s = *string;
+
+    while (ASSERT_NUMBER(*s))
+    {
+        if (scale > 1)                                                                  // Digits beyond the scale are truncated
+        {
+            scale /= 10;
+            fraction += (*s - '0') * scale;
+        }
+        s++;
+    }
+
+    *string = s;
+    return fraction;
+}
+
+/**
+*      @brief Function to tokenize the contents of the input string in a single pass
+*               * Identifier:   alphabet followed by alphanumerics or '_'           type 'a'
+*               * Integer:      optional sign followed by digits, or 0x and hex      type 'n'
+*               * Decimal:      integer followed by '.' and digits                   type 'd', fixed point
+*               Values are converted while scanning and stored in user_data->value, any other
+*               character is a delimiter and is overwritten with '\0' so fields read as strings
 *      @param user_data Pointer to user_data structure
 **/
 void string_parse(string_data_t *user_data)
 {
-    uint16_t character_count;
+    char *start = user_data->input_string;
+    char *end = start + MAX_STRING_LENGTH - 1;
+    char *s = start;
+    char sign = '\0';                                                                   // Sign split off an identifier
+
     RESET(user_data->count);                                                            // Initialise count to 0
-    uint8_t delimiter_flag = 1;                                                         // To indicate encounter of delimiters (non-alphanumeric chars)
+    *end = '\0';                                                                        // Guarantee termination
 
-    for (character_count = 0; character_count < MAX_STRING_LENGTH; character_count++)
+    while (*s != '\0')
     {
-        if (ASSERT_ALPHABET(user_data->input_string[character_count]))                  // Validate
+        char c = *s;
+        uint8_t field = user_data->count;
+        bool negative = (c == '-' || sign == '-');
+        bool is_number = ASSERT_NUMBER(c) || ((c == '-' || c == '+') && ASSERT_NUMBER(s[1]));
+
+        if (!ASSERT_ALPHABET(c) && !is_number)                                          // Delimiter
         {
-            if (delimiter_flag && user_data->count < 10)                                // Validate
-            {
-                delimiter_flag = 0;                                                     // Reset flag to 0
-                user_data->position[user_data->count] = character_count;
-                user_data->type[user_data->count] = 'a';                                // Set field type to alphabet
-                user_data->count++;                                                     // Increment count
-            }
+            *s++ = '\0';
+            continue;
         }
+        sign = '\0';
+
+        if (field >= MAX_FIELDS)    break;                                              // Remaining input is ignored
 
-        else if (ASSERT_NUMBER(user_data->input_string[character_count]))               // Validate
+        user_data->position[field] = (uint8_t)(s - start);
+        user_data->count++;
+
+        if (ASSERT_ALPHABET(c))                                                         // Identifier
         {
-            delimiter_flag = 0;                                                         // Reset flag to 0
-            user_data->position[user_data->count] = character_count;
-            user_data->type[user_data->count] = 'n';                                    // Set field type to numeric
-            user_data->count++;                                                         // increment count
+            user_data->type[field] = 'a';
+            user_data->value[field] = 0;
+            while (ASSERT_ALPHABET(*s) || ASSERT_NUMBER(*s) || *s == '_')   s++;
+
+            if ((*s == '-' || *s == '+') && ASSERT_NUMBER(s[1]))                        // Number straight after, terminate
+            {                                                                           // the identifier and keep the sign
+                sign = *s;
+                *s++ = '\0';
+            }
         }
+        else if (c == '0' && (s[1] == 'x' || s[1] == 'X') && ASSERT_HEX(s[2]))         // Hexadecimal integer
+        {
+            uint32_t value = 0;
+            for (s += 2; ASSERT_HEX(*s); s++)   value = (value << 4) | HEX_VALUE(*s);
 
-        else
+            user_data->type[field] = 'n';
+            user_data->value[field] = (int32_t)value;
+        }
+        else                                                                            // Signed integer or decimal
         {
-            delimiter_flag = 1;                                                         // Revert flag to 1
-            user_data->input_string[character_count] = '\0';                            // Indicate end of string
+            uint32_t value = 0;
+            if (!ASSERT_NUMBER(c))  s++;                                                // Skip sign
+
+            while (ASSERT_NUMBER(*s))
+            {
+                if (value <= (INT32_MAX - 9) / 10)  value = value * 10 + (*s - '0');    // Saturate on overflow
+                else                                value = INT32_MAX;
+                s++;
+            }
+
+            if (*s == '.' && ASSERT_NUMBER(s[1]))
+            {
+                s++;
+                if (value > INT32_MAX / FIELD_DECIMAL_SCALE)    value = INT32_MAX / FIELD_DECIMAL_SCALE;
+                value = value * FIELD_DECIMAL_SCALE + string_parse_fraction(&s);
+                user_data->type[field] = 'd';
+            }
+            else
+            {
+                user_data->type[field] = 'n';
+            }
+
+            user_data->value[field] = negative ? -(int32_t)value : (int32_t)value;
         }
     }
 }
@@ -99,23 +207,44 @@ void string_parse(string_data_t *user_data)
 *      @brief Function to retrieve string
 *      @param user_data Pointer to user data structure
 *      @param fieldNumber position to retrieve from
-*      @return char* pointer to the string at position
+*      @return char* pointer to the string at position, NULL if there is no such field
 **/
 char *getFieldString(string_data_t *user_data, uint8_t fieldNumber)
 {
-    if (user_data->count > fieldNumber)     return &user_data->input_string[user_data->position[fieldNumber]];
-    else                                    return '\0';
+    if (fieldNumber < user_data->count)     return &user_data->input_string[user_data->position[fieldNumber]];
+    else                                    return NULL;
 }
 
 /**
-*      @brief Function to retrieve integer
+*      @brief Function to retrieve integer, decimal fields are truncated towards zero
 *      @param user_data Pointer to user data structure
 *      @param fieldNumber position to retrieve from
-*      @return int32_t value of integer at position
+*      @return int32_t value of integer at position, 0 if there is no numeric field
 **/
 int32_t getFieldInteger(string_data_t *user_data, uint8_t fieldNumber)
 {
-    return atoi(&user_data->input_string[user_data->position[fieldNumber]]);
+    if (fieldNumber >= user_data->count)            return 0;
+    if (user_data->type[fieldNumber] == 'd')        return user_data->value[fieldNumber] / FIELD_DECIMAL_SCALE;
+    return user_data->value[fieldNumber];
+}
+
+/**
+*      @brief Function to retrieve a numeric field as fixed point
+*      @param user_data Pointer to user data structure
+*      @param fieldNumber position to retrieve from
+*      @return int32_t value in units of 1 / FIELD_DECIMAL_SCALE, 0 if there is no numeric field
+**/
+int32_t getFieldDecimal(string_data_t *user_data, uint8_t fieldNumber)
+{
+    int32_t value;
+
+    if (fieldNumber >= user_data->count)            return 0;
+    if (user_data->type[fieldNumber] != 'n')        return user_data->value[fieldNumber];
+
+    value = user_data->value[fieldNumber];                                              // Saturate before scaling
+    if (value > INT32_MAX / FIELD_DECIMAL_SCALE)    return INT32_MAX;
+    if (value < -(INT32_MAX / FIELD_DECIMAL_SCALE)) return -INT32_MAX;
+    return value * FIELD_DECIMAL_SCALE;
 }
 
 /**
@@ -128,10 +257,9 @@ int32_t getFieldInteger(string_data_t *user_data, uint8_t fieldNumber)
 **/
 bool isCommand(string_data_t *user_data, const char *command, uint8_t arg_count)
 {
-    bool cmp = strcmp(getFieldString(user_data, 0), command);
+    if (user_data->count == 0 || user_data->count < arg_count)  return false;
 
-    if (user_data->count >= arg_count && cmp == 0)   return true;
-    else                                             return false;
+    return strcmp(getFieldString(user_data, 0), command) == 0;
 }
 
 /**
@@ -11,21 +11,25 @@
 
 #define MAX_STRING_LENGTH   80          // Maximum number of characters in input string
 #define MAX_FIELDS          10          // Maximum number of acceptable arguments
+#define FIELD_DECIMAL_SCALE 1000        // Decimal fields are stored as fixed point in thousandths
 
 typedef struct
 {
     char input_string[MAX_STRING_LENGTH];
-    char type[MAX_FIELDS];
+    char type[MAX_FIELDS];              // 'a' identifier, 'n' integer, 'd' decimal
     uint8_t position[MAX_FIELDS];
+    int32_t value[MAX_FIELDS];          // Converted value of numeric fields
     uint8_t count;
 } string_data_t;
 
 // Function prototypes
 char *itoa(char *string, int32_t number);
-void string_input_get(string_data_t *user_data);
+bool string_input_poll(string_data_t *user_data);
+uint32_t string_input_too_long_count(void);
 void string_parse(string_data_t *user_data);
 char *getFieldString(string_data_t *user_data, uint8_t fieldNumber);
 int32_t getFieldInteger(string_data_t *user_data, uint8_t fieldNumber);
+int32_t getFieldDecimal(string_data_t *user_data, uint8_t fieldNumber);
 bool isCommand(string_data_t *user_data, const char *command, uint8_t arg_count);
 
 #endif
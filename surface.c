@@ -0,0 +1,352 @@
+/**
+*      @file surface.c
+*      @author Prithvi Bhat
+*      @brief Projective mapping of fixes onto the writing surface
+*               * A homography H, h33 fixed at 1, takes a fix in the sensor frame, fix offsets included, to
+*                 surface or screen units: u = (h11 x + h12 y + h13) / w, v = (h21 x + h22 y + h23) / w,
+*                 w = h31 x + h32 y + 1. It is the last stage of the pipeline, so rotation, skew, scale and
+*                 perspective of the mounting are taken out on the device
+*               * The coefficients are stored in the configuration as single precision bit patterns from
+*                 SURF_H on, the identity by default, and cached in RAM by surface_load(). An affine H costs
+*                 four multiply-adds per fix, a projective one a reciprocal more
+*               * Fitting: the pen is held on four or more reference points, each fix is paired with the
+*                 point's surface coordinates and H is the least squares solution of the linearised
+*                 equations. Both point sets are normalised first, centroid at the origin and mean distance
+*                 sqrt(2), which keeps the normal equations well conditioned whatever the units
+**/
+
+#include <string.h>
+#include <math.h>
+#include "surface.h"
+#include "config.h"
+#include "format.h"
+#include "uart0.h"
+
+#define UNKNOWNS            8                   // Coefficients solved for
+#define PIVOT_LIMIT         1e-9                // Smaller pivots mean the taps do not span the plane
+
+// Global Variables
+static float g_h[SURFACE_TERMS];                // Row major h11 to h32
+static bool g_identity = true;
+static bool g_affine = true;
+static float g_tap[SURFACE_TAPS][4];            // Fix x, y and surface u, v of each reference point
+static uint8_t g_taps = 0;
+static double g_normal[UNKNOWNS][UNKNOWNS + 1]; // Normal equations of the fit, right hand side last
+
+// Coefficients of the identity mapping
+static const float g_identity_h[SURFACE_TERMS] = { 1, 0, 0, 0, 1, 0, 0, 0 };
+
+static float word_to_float(uint32_t word)
+{
+    float value;
+
+    memcpy(&value, &word, sizeof(value));
+    return value;
+}
+
+static uint32_t float_to_word(float value)
+{
+    uint32_t word;
+
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+/**
+*      @brief Function to cache the stored mapping, call after the configuration changes
+*               A coefficient that is not a finite number falls back to the identity
+**/
+void surface_load(void)
+{
+    uint8_t i;
+
+    g_identity = true;
+    for (i = 0; i < SURFACE_TERMS; i++)
+    {
+        g_h[i] = word_to_float(config_get(SURF_H + i));
+        if (g_h[i] != g_h[i] || fabsf(g_h[i]) > 1e30f)                             // NaN or infinite
+        {
+            memcpy(g_h, g_identity_h, sizeof(g_h));
+            g_identity = true;
+            break;
+        }
+        if (g_h[i] != g_identity_h[i])  g_identity = false;
+    }
+    g_affine = (g_h[6] == 0 && g_h[7] == 0);
+}
+
+/**
+*      @brief Function to map a fix onto the surface
+*      @param x, y fix in mm, replaced by the surface coordinates
+**/
+void surface_apply(float *x, float *y)
+{
+    float u, v, w;
+
+    if (g_identity)     return;
+
+    u = g_h[0] * *x + g_h[1] * *y + g_h[2];
+    v = g_h[3] * *x + g_h[4] * *y + g_h[5];
+    if (!g_affine)
+    {
+        w = g_h[6] * *x + g_h[7] * *y + 1;
+        if (fabsf(w) < 1e-6f)   return;                                             // On the horizon line, leave the fix
+        w = 1 / w;
+        u *= w;
+        v *= w;
+    }
+    *x = u;
+    *y = v;
+}
+
+/**
+*      @brief Function to add a reference point for the next fit
+*      @param x, y fix of the pen held on the point, in mm
+*      @param u, v surface coordinates of the point
+*      @return bool false if SURFACE_TAPS points are already waiting
+**/
+bool surface_tap(float x, float y, int32_t u, int32_t v)
+{
+    if (g_taps >= SURFACE_TAPS)     return false;
+
+    g_tap[g_taps][0] = x;
+    g_tap[g_taps][1] = y;
+    g_tap[g_taps][2] = (float)u;
+    g_tap[g_taps][3] = (float)v;
+    g_taps++;
+    return true;
+}
+
+/**
+*      @brief Function to work out the similarity transform that normalises one point set
+*      @param column 0 for the fixes, 2 for the surface points
+*      @param scale, cx, cy set so that a point p maps to scale * (p - c)
+*      @return bool false if all points coincide
+**/
+static bool normalise(uint8_t column, double *scale, double *cx, double *cy)
+{
+    double distance = 0;
+    uint8_t i;
+
+    *cx = *cy = 0;
+    for (i = 0; i < g_taps; i++)
+    {
+        *cx += g_tap[i][column];
+        *cy += g_tap[i][column + 1];
+    }
+    *cx /= g_taps;
+    *cy /= g_taps;
+
+    for (i = 0; i < g_taps; i++)
+    {
+        double dx = g_tap[i][column] - *cx, dy = g_tap[i][column + 1] - *cy;
+        distance += sqrt(dx * dx + dy * dy);
+    }
+    if (distance == 0)  return false;
+
+    *scale = sqrt(2.0) * g_taps / distance;
+    return true;
+}
+
+/**
+*      @brief Function to add one linearised equation, coefficients a and right hand side b, to the normal equations
+**/
+static void accumulate(const double *a, double b)
+{
+    uint8_t i, j;
+
+    for (i = 0; i < UNKNOWNS; i++)
+    {
+        for (j = 0; j < UNKNOWNS; j++)  g_normal[i][j] += a[i] * a[j];
+        g_normal[i][UNKNOWNS] += a[i] * b;
+    }
+}
+
+/**
+*      @brief Function to solve the normal equations by Gaussian elimination with partial pivoting
+*      @param h set to the solution
+*      @return bool false if the system is singular
+**/
+static bool solve_normal(double *h)
+{
+    uint8_t i, j, k, pivot;
+
+    for (i = 0; i < UNKNOWNS; i++)
+    {
+        pivot = i;
+        for (j = i + 1; j < UNKNOWNS; j++)
+        {
+            if (fabs(g_normal[j][i]) > fabs(g_normal[pivot][i]))    pivot = j;
+        }
+        if (fabs(g_normal[pivot][i]) < PIVOT_LIMIT)     return false;
+
+        for (k = i; k <= UNKNOWNS; k++)                                             // Swap the pivot row up
+        {
+            double swap = g_normal[i][k];
+            g_normal[i][k] = g_normal[pivot][k];
+            g_normal[pivot][k] = swap;
+        }
+
+        for (j = i + 1; j < UNKNOWNS; j++)
+        {
+            double factor = g_normal[j][i] / g_normal[i][i];
+            for (k = i; k <= UNKNOWNS; k++)     g_normal[j][k] -= factor * g_normal[i][k];
+        }
+    }
+
+    for (i = UNKNOWNS; i-- > 0;)                                                    // Back substitution
+    {
+        double sum = g_normal[i][UNKNOWNS];
+        for (k = i + 1; k < UNKNOWNS; k++)  sum -= g_normal[i][k] * h[k];
+        h[i] = sum / g_normal[i][i];
+    }
+    return true;
+}
+
+/**
+*      @brief Function to store a mapping and bring it into use
+**/
+static void surface_store(const float *h)
+{
+    uint8_t i;
+
+    for (i = 0; i < SURFACE_TERMS; i++)     config_set(SURF_H + i, float_to_word(h[i]));
+    config_flush();
+    surface_load();
+}
+
+/**
+*      @brief Function to identify the mapping in use, a profile records it to find out later whether the
+*               mapping still belongs to its sensor geometry
+*      @return uint32_t CRC-32 of the coefficient words
+**/
+uint32_t surface_tag(void)
+{
+    uint32_t words[SURFACE_TERMS];
+    uint8_t i;
+
+    for (i = 0; i < SURFACE_TERMS; i++)     words[i] = config_get(SURF_H + i);
+    return config_crc32(words, SURFACE_TERMS);
+}
+
+/**
+*      @brief Function to put the stored mapping back in use after surface_suspend()
+**/
+void surface_restore(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < SURFACE_TERMS; i++)     config_revert(SURF_H + i);
+    surface_load();
+}
+
+/**
+*      @brief Function to map with the identity in RAM only, the stored mapping is kept
+**/
+void surface_suspend(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < SURFACE_TERMS; i++)     config_hold(SURF_H + i, float_to_word(g_identity_h[i]));
+    surface_load();
+}
+
+/**
+*      @brief Function to fit the mapping to the reference points added, store it and start a new set
+*      @return bool false if there are fewer than SURFACE_MIN_TAPS points or they do not span the plane,
+*               the stored mapping and the points are kept then
+**/
+bool surface_fit(void)
+{
+    double s1, x0, y0, s2, u0, v0, n[9], m[9], h[UNKNOWNS + 1];
+    float stored[SURFACE_TERMS];
+    uint8_t i, j;
+
+    if (g_taps < SURFACE_MIN_TAPS)                          return false;
+    if (!normalise(0, &s1, &x0, &y0) || !normalise(2, &s2, &u0, &v0))      return false;
+
+    memset(g_normal, 0, sizeof(g_normal));
+    for (i = 0; i < g_taps; i++)
+    {
+        double x = s1 * (g_tap[i][0] - x0), y = s1 * (g_tap[i][1] - y0);
+        double u = s2 * (g_tap[i][2] - u0), v = s2 * (g_tap[i][3] - v0);
+        double row_u[UNKNOWNS] = { x, y, 1, 0, 0, 0, -x * u, -y * u };
+        double row_v[UNKNOWNS] = { 0, 0, 0, x, y, 1, -x * v, -y * v };
+
+        accumulate(row_u, u);
+        accumulate(row_v, v);
+    }
+    if (!solve_normal(h))   return false;
+    h[UNKNOWNS] = 1;
+
+    // Back to the original units: H = T2^-1 * Hn * T1, T1 normalises the fixes and T2 the surface points
+    for (j = 0; j < 3; j++)                                                         // n = Hn * T1, column by column
+    {
+        n[j] = h[j] * s1;
+        n[3 + j] = h[3 + j] * s1;
+        n[6 + j] = h[6 + j] * s1;
+    }
+    n[2] = h[2] - s1 * (h[0] * x0 + h[1] * y0);
+    n[5] = h[5] - s1 * (h[3] * x0 + h[4] * y0);
+    n[8] = h[8] - s1 * (h[6] * x0 + h[7] * y0);
+
+    for (j = 0; j < 3; j++)                                                         // m = T2^-1 * n
+    {
+        m[j] = n[j] / s2 + u0 * n[6 + j];
+        m[3 + j] = n[3 + j] / s2 + v0 * n[6 + j];
+        m[6 + j] = n[6 + j];
+    }
+    if (fabs(m[8]) < PIVOT_LIMIT)   return false;
+
+    for (i = 0; i < SURFACE_TERMS; i++)     stored[i] = (float)(m[i] / m[8]);
+    surface_store(stored);
+    g_taps = 0;
+    return true;
+}
+
+/**
+*      @brief Function to go back to the identity mapping and drop the reference points
+**/
+void surface_clear(void)
+{
+    g_taps = 0;
+    surface_store(g_identity_h);
+}
+
+/**
+*      @brief Function to print a coefficient with the given number of decimals
+**/
+static void print_term(float value, uint8_t decimals)
+{
+    static const float scale[] = { 1, 10, 100, 1000, 10000 };
+    float scaled = value * scale[decimals];
+
+    if (scaled > INT32_MAX)     scaled = INT32_MAX;
+    if (scaled < -INT32_MAX)    scaled = -INT32_MAX;
+    format_string(putcUart0, " ");
+    format_fixed(putcUart0, (int32_t)(scaled + ((scaled < 0) ? -0.5f : 0.5f)), decimals);
+}
+
+/**
+*      @brief Function to print the mapping and the reference points waiting for a fit
+**/
+void surface_print(void)
+{
+    uint8_t i;
+
+    format_string(putcUart0, g_identity ? "Surface mapping off" : (g_affine ? "Surface mapping affine" : "Surface mapping projective"));
+    format_string(putcUart0, ", ");
+    format_uint(putcUart0, g_taps);
+    format_string(putcUart0, " reference points waiting\r\n");
+
+    for (i = 0; i < 2; i++)                                                         // Linear terms and offset per row
+    {
+        print_term(g_h[3 * i], 4);
+        print_term(g_h[3 * i + 1], 4);
+        print_term(g_h[3 * i + 2], 2);
+        format_string(putcUart0, "\r\n");
+    }
+    print_term(g_h[6] * 1e6f, 3);                                                   // Perspective terms in millionths
+    print_term(g_h[7] * 1e6f, 3);
+    format_string(putcUart0, " x1e-6 1\r\n\r\n");
+}
@@ -0,0 +1,27 @@
+/**
+*      @file surface.h
+*      @author Prithvi Bhat
+*      @brief Projective mapping of fixes onto the writing surface
+**/
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define SURFACE_TERMS   8                       // h11 to h32 in the configuration, h33 is 1
+#define SURFACE_TAPS    16                      // Reference points kept for one fit
+#define SURFACE_MIN_TAPS 4                      // Points needed to fix a homography
+
+// Function prototypes
+void surface_load(void);
+void surface_apply(float *x, float *y);
+bool surface_tap(float x, float y, int32_t u, int32_t v);
+bool surface_fit(void);
+void surface_clear(void);
+uint32_t surface_tag(void);
+void surface_restore(void);
+void surface_suspend(void);
+void surface_print(void);
+
+#endif
@@ -9,6 +9,8 @@
 #include <inttypes.h>
 #include "gpio.h"
 #include "nvic.h"
+#include "tone.h"
+#include "walk.h"
 
 #define US_A_IN                 PORTC, 4
 #define US_B_IN                 PORTC, 5
@@ -17,12 +19,18 @@
 #define TIMER_START_VALUE       0
 #define TIMER_MAX_VALUE         40000000
 #define TIMER_VALUE_READ_MASK   0x0000FFFF
+#define TICK_RELOAD             (40000 - 1)         // SysTick period for 1 ms at 40 MHz
+
+// Global Variables
+static volatile uint32_t g_tick_ms = 0;
 
 /**
  *      @brief Initialize timer registers
  **/
 void timer_init()
 {
+    bool both_edges = walk_capture_widths();        // Pulse widths for the comparator walk correction
+
     SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R0;    // Enable and provide clock to the timer
     _delay_cycles(3);                               // Delay for sync
 
@@ -37,7 +45,8 @@ void timer_init()
     WTIMER0_TAMR_R      |= TIMER_TAMR_TACMR;        // Configure as edge timer
     WTIMER0_TAMR_R      |= TIMER_TAMR_TAMR_CAP;     // Configure for capture mode
     WTIMER0_TAMR_R      |= TIMER_TAMR_TACDIR;       // Direction = Up-counter
-    WTIMER0_CTL_R       |= TIMER_CTL_TAEVENT_NEG;   // Configure to capture from negative edge
+    WTIMER0_CTL_R       &= ~TIMER_CTL_TAEVENT_M;    // Configure to capture from negative edge, or both edges
+    WTIMER0_CTL_R       |= both_edges ? TIMER_CTL_TAEVENT_BOTH : TIMER_CTL_TAEVENT_NEG;
     WTIMER0_IMR_R       |= TIMER_IMR_CAEIM;         // Configure to trigger interrupts trigger
     WTIMER0_TAV_R       = 0;
 
@@ -55,7 +64,8 @@ void timer_init()
     WTIMER0_TBMR_R      |= TIMER_TBMR_TBCMR;        // Configure as edge timer
     WTIMER0_TBMR_R      |= TIMER_TBMR_TBMR_CAP;     // Configure for capture mode
     WTIMER0_TBMR_R      |= TIMER_TBMR_TBCDIR;       // Direction = Up-counter
-    WTIMER0_CTL_R       |= TIMER_CTL_TBEVENT_NEG;   // Configure to capture from negative edge
+    WTIMER0_CTL_R       &= ~TIMER_CTL_TBEVENT_M;    // Configure to capture from negative edge, or both edges
+    WTIMER0_CTL_R       |= both_edges ? TIMER_CTL_TBEVENT_BOTH : TIMER_CTL_TBEVENT_NEG;
     WTIMER0_IMR_R       |= TIMER_IMR_CBEIM;         // Configure to trigger interrupts trigger
     WTIMER0_TBV_R       = 0;
 
@@ -76,7 +86,8 @@ void timer_init()
     WTIMER1_TAMR_R      |= TIMER_TAMR_TACMR;        // Configure as edge timer
     WTIMER1_TAMR_R      |= TIMER_TAMR_TAMR_CAP;     // Configure for capture mode
     WTIMER1_TAMR_R      |= TIMER_TAMR_TACDIR;       // Direction = Up-counter
-    WTIMER1_CTL_R       |= TIMER_CTL_TAEVENT_NEG;   // Configure to capture from negative edge
+    WTIMER1_CTL_R       &= ~TIMER_CTL_TAEVENT_M;    // Configure to capture from negative edge, or both edges
+    WTIMER1_CTL_R       |= both_edges ? TIMER_CTL_TAEVENT_BOTH : TIMER_CTL_TAEVENT_NEG;
     WTIMER1_IMR_R       |= TIMER_IMR_CAEIM;         // Configure to trigger interrupts trigger
     WTIMER1_TAV_R       = 0;
 
@@ -157,6 +168,35 @@ uint32_t timer_stop(timer_t timer)
     return (timer_val);
 }
 
+/**
+*      @brief Function to start the 1 ms SysTick time base used to pace background tasks
+**/
+void timer_tick_init(void)
+{
+    NVIC_ST_CTRL_R      = 0;                                // Disable before configuring
+    NVIC_ST_RELOAD_R    = TICK_RELOAD;
+    NVIC_ST_CURRENT_R   = 0;
+    NVIC_ST_CTRL_R      = NVIC_ST_CTRL_CLK_SRC | NVIC_ST_CTRL_INTEN | NVIC_ST_CTRL_ENABLE;
+}
+
+/**
+*      @brief SysTick ISR, counts milliseconds and steps the buzzer tone sequencer
+**/
+void tick_interrupt_handler(void)
+{
+    g_tick_ms++;
+    tone_tick();
+}
+
+/**
+*      @brief Function to read the millisecond time base
+*      @return uint32_t milliseconds since timer_tick_init(), wraps after 49 days
+**/
+uint32_t timer_ms(void)
+{
+    return g_tick_ms;
+}
+
 /**
 *      @brief Function to initialise PWM for buzzer M1-PWM3 (Generator 1 B)
 **/
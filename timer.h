@@ -22,6 +22,8 @@ typedef enum
 void timer_init(void);
 void timer_start(void);
 uint32_t timer_stop(timer_t timer);
+void timer_tick_init(void);
+uint32_t timer_ms(void);
 void pwm_init(void);
 
 #endif
@@ -60,6 +60,9 @@ extern void sA_interrupt_handler(void);
 extern void sB_interrupt_handler(void);
 extern void sC_interrupt_handler(void);
 extern void timeout_interrupt_handler(void);
+extern void uart0Isr(void);
+extern void i2c0Isr(void);
+extern void tick_interrupt_handler(void);
 
 //*****************************************************************************
 //
@@ -87,16 +90,16 @@ void (*const g_pfnVectors[])(void) =
         IntDefaultHandler,         // Debug monitor handler
         0,                         // Reserved
         IntDefaultHandler,         // The PendSV handler
-        IntDefaultHandler,         // The SysTick handler
+        tick_interrupt_handler,    // The SysTick handler
         ir_interrupt_handler,      // GPIO Port A
         IntDefaultHandler,         // GPIO Port B
         IntDefaultHandler,         // GPIO Port C
         ir_interrupt_handler,      // GPIO Port D
         IntDefaultHandler,         // GPIO Port E
-        IntDefaultHandler,         // UART0 Rx and Tx
+        uart0Isr,                  // UART0 Rx and Tx
         IntDefaultHandler,         // UART1 Rx and Tx
         IntDefaultHandler,         // SSI0 Rx and Tx
-        IntDefaultHandler,         // I2C0 Master and Slave
+        i2c0Isr,                   // I2C0 Master and Slave
         IntDefaultHandler,         // PWM Fault
         IntDefaultHandler,         // PWM Generator 0
         IntDefaultHandler,         // PWM Generator 1
@@ -0,0 +1,173 @@
+/**
+*      @file tone.c
+*      @author Prithvi Bhat
+*      @brief Non blocking buzzer tone sequencer paced by the 1 ms SysTick
+*               * Callers, ISRs included, only mark a pattern as requested and return
+*               * tone_tick() runs from the SysTick ISR, steps the pattern being played and starts the
+*                 highest priority request once it ends, ties going to the lower pattern number
+*               * A request for a higher priority pattern cuts the current one short, a request for the
+*                 pattern already playing or already waiting is merged into it
+*               * Pattern timings come from the configuration when a pattern starts, so "beep" changes
+*                 apply from the next tone
+**/
+
+#include "tone.h"
+#include "config.h"
+#include "tm4c123gh6pm.h"
+
+#define US_PER_MS   1000
+
+// Global Variables
+static volatile bool g_requested[TONE_PATTERNS];
+static volatile uint8_t g_current = TONE_NONE;
+static tone_pattern_t g_pattern;
+static uint32_t g_remaining_ms = 0;
+static uint8_t g_repeats_left = 0;
+static bool g_on = false;
+
+// Priority of each pattern, the error tone interrupts the capture tones
+static const uint8_t g_priority[TONE_PATTERNS] =
+{
+    [BEEP_IR_INT]   = 1,
+    [BEEP_US_A_INT] = 1,
+    [BEEP_US_B_INT] = 1,
+    [BEEP_US_C_INT] = 1,
+    [BEEP_ERROR]    = 2,
+    [BEEP_START]    = 0,
+};
+
+/**
+*      @brief Function to drive the buzzer PWM
+*      @param load PWM period, 0 silences the buzzer
+**/
+static void tone_output(uint32_t load)
+{
+    PWM1_0_LOAD_R = load;
+    PWM1_0_CMPB_R = load / 2;
+}
+
+/**
+*      @brief Function to read a pattern from the configuration
+**/
+static void tone_load(uint8_t pattern, tone_pattern_t *tone)
+{
+    uint32_t repeat;
+    uint8_t base;
+
+    switch (pattern)
+    {
+        case BEEP_IR_INT:   base = LOAD_IR;     break;
+        case BEEP_US_A_INT: base = LOAD_A;      break;
+        case BEEP_US_B_INT: base = LOAD_B;      break;
+        case BEEP_US_C_INT: base = LOAD_C;      break;
+        case BEEP_ERROR:    base = LOAD_ERR;    break;
+
+        default:                                // Start up pause, not configurable
+        {
+            tone->load = 0;
+            tone->on_ms = 100;
+            tone->off_ms = 0;
+            tone->repeat = 1;
+            return;
+        }
+    }
+
+    // LOAD, PER1, PER2 and CONT of a pattern are consecutive configuration words, see eeprom_memory_map.h
+    tone->load = config_get(base);
+    tone->on_ms = (config_get(base + 1) + US_PER_MS - 1) / US_PER_MS;
+    tone->off_ms = (config_get(base + 2) + US_PER_MS - 1) / US_PER_MS;
+    repeat = config_get(base + 3);
+    tone->repeat = (repeat == 0) ? 1 : (repeat > 255) ? 255 : repeat;
+}
+
+/**
+*      @brief Function to pick the request to play next
+*      @return uint8_t pattern number or TONE_NONE
+**/
+static uint8_t tone_next(void)
+{
+    uint8_t i, next = TONE_NONE;
+
+    for (i = 0; i < TONE_PATTERNS; i++)
+    {
+        if (g_requested[i] && (next == TONE_NONE || g_priority[i] > g_priority[next]))  next = i;
+    }
+    return next;
+}
+
+/**
+*      @brief Function to start playing a pattern
+**/
+static void tone_start(uint8_t pattern)
+{
+    g_requested[pattern] = false;
+    tone_load(pattern, &g_pattern);
+
+    g_current = pattern;
+    g_repeats_left = g_pattern.repeat;
+    g_on = true;
+    g_remaining_ms = g_pattern.on_ms;
+    tone_output(g_pattern.load);
+}
+
+/**
+*      @brief Function to ask for a pattern to be played, returns at once
+*      @param pattern beep type
+**/
+void tone_request(beep_t pattern)
+{
+    if (pattern >= TONE_PATTERNS || pattern == g_current)   return;     // Merge with the tone being played
+    g_requested[pattern] = true;
+}
+
+/**
+*      @brief Function to advance the sequencer by 1 ms, called from the SysTick ISR
+**/
+void tone_tick(void)
+{
+    uint8_t next = tone_next();
+
+    if (g_current != TONE_NONE && next != TONE_NONE && g_priority[next] > g_priority[g_current])
+    {
+        g_current = TONE_NONE;                                          // Pre-empted
+    }
+    else if (g_current != TONE_NONE && g_remaining_ms != 0 && --g_remaining_ms != 0)
+    {
+        return;
+    }
+
+    while (g_current != TONE_NONE && g_remaining_ms == 0)               // Step past finished phases
+    {
+        if (g_on)
+        {
+            g_on = false;
+            g_remaining_ms = g_pattern.off_ms;
+            tone_output(0);
+        }
+        else if (--g_repeats_left != 0)
+        {
+            g_on = true;
+            g_remaining_ms = g_pattern.on_ms;
+            tone_output(g_pattern.load);
+        }
+        else
+        {
+            g_current = TONE_NONE;                                      // Buzzer already off
+        }
+    }
+
+    if (g_current == TONE_NONE)
+    {
+        next = tone_next();
+        if (next != TONE_NONE)  tone_start(next);
+    }
+}
+
+/**
+*      @brief Function to report the pattern being played
+*      @return uint8_t pattern number or TONE_NONE
+**/
+uint8_t tone_playing(void)
+{
+    return g_current;
+}
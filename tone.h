@@ -0,0 +1,32 @@
+/**
+*      @file tone.h
+*      @author Prithvi Bhat
+*      @brief Non blocking buzzer tone sequencer paced by the 1 ms SysTick
+**/
+#ifndef TONE_H
+#define TONE_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+#include "commands.h"
+
+#define TONE_PATTERNS   (BEEP_START + 1)        // One pattern per beep_t
+#define TONE_NONE       0xFF
+
+/**
+*      @brief One tone pattern: the tone is on for on_ms, off for off_ms, and this repeats repeat times
+**/
+typedef struct
+{
+    uint32_t load;                              // PWM period register value, sets the pitch, 0 is silence
+    uint32_t on_ms;
+    uint32_t off_ms;
+    uint8_t repeat;
+} tone_pattern_t;
+
+// Function prototypes
+void tone_request(beep_t pattern);
+void tone_tick(void);
+uint8_t tone_playing(void);
+
+#endif
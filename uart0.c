@@ -22,15 +22,27 @@
 #include <stdbool.h>
 #include "tm4c123gh6pm.h"
 #include "uart0.h"
+#include "nvic.h"
 
 // PortA masks
 #define UART_TX_MASK 2
 #define UART_RX_MASK 1
 
+// Receive ring buffer, size must be a power of two
+#define RX_BUFFER_SIZE 256
+#define RX_BUFFER_MASK (RX_BUFFER_SIZE - 1)
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+static volatile char rxBuffer[RX_BUFFER_SIZE];
+static volatile uint16_t rxWriteIndex = 0;          // Written by the ISR only
+static volatile uint16_t rxReadIndex = 0;           // Written by the main loop only
+static volatile bool rxInterruptEnabled = false;
+static volatile uint32_t rxOverrunCount = 0;        // Hardware FIFO overruns
+static volatile uint32_t rxDropCount = 0;           // Characters lost because the ring buffer was full
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -97,6 +109,13 @@ void putsUart0(char *str)
 // Blocking function that returns with serial data once the buffer is not empty
 char getcUart0()
 {
+    char c;
+    if (rxInterruptEnabled)
+    {
+        while (!readUart0(&c))
+            ;                 // wait if ring buffer empty
+        return c;
+    }
     while (UART0_FR_R & UART_FR_RXFE)
         ;                     // wait if uart0 rx fifo empty
     return UART0_DR_R & 0xFF; // get character from fifo
@@ -105,5 +124,62 @@ char getcUart0()
 // Returns the status of the receive buffer
 bool kbhitUart0()
 {
+    if (rxInterruptEnabled)
+        return rxReadIndex != rxWriteIndex;
     return !(UART0_FR_R & UART_FR_RXFE);
 }
+
+// Service UART0 receive from its interrupt
+// The RX interrupt fires at half FIFO and the receive time-out catches the tail of a burst
+void enableUart0RxInterrupt()
+{
+    UART0_IFLS_R = (UART0_IFLS_R & ~UART_IFLS_RX_M) | UART_IFLS_RX4_8;
+    UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC | UART_ICR_OEIC;
+    UART0_IM_R |= UART_IM_RXIM | UART_IM_RTIM | UART_IM_OEIM;
+    rxInterruptEnabled = true;
+    enableNvicInterrupt(INT_UART0);
+}
+
+// Drains the hardware FIFO into the ring buffer
+void uart0Isr()
+{
+    if (UART0_RIS_R & UART_RIS_OERIS)
+    {
+        rxOverrunCount++;
+        UART0_ECR_R = 0;                                // clear receive error flags
+    }
+    UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC | UART_ICR_OEIC;
+
+    while (!(UART0_FR_R & UART_FR_RXFE))
+    {
+        char c = UART0_DR_R & 0xFF;
+        uint16_t next = (rxWriteIndex + 1) & RX_BUFFER_MASK;
+        if (next == rxReadIndex)
+            rxDropCount++;                              // ring buffer full, character lost
+        else
+        {
+            rxBuffer[rxWriteIndex] = c;
+            rxWriteIndex = next;
+        }
+    }
+}
+
+// Non-blocking function that returns true and the next character if one has been received
+bool readUart0(char *c)
+{
+    if (rxReadIndex == rxWriteIndex)
+        return false;
+    *c = rxBuffer[rxReadIndex];
+    rxReadIndex = (rxReadIndex + 1) & RX_BUFFER_MASK;
+    return true;
+}
+
+uint32_t getUart0OverrunCount()
+{
+    return rxOverrunCount;
+}
+
+uint32_t getUart0DropCount()
+{
+    return rxDropCount;
+}
@@ -34,5 +34,10 @@ void putcUart0(char c);
 void putsUart0(char *str);
 char getcUart0();
 bool kbhitUart0();
+void enableUart0RxInterrupt();
+void uart0Isr();
+bool readUart0(char *c);
+uint32_t getUart0OverrunCount();
+uint32_t getUart0DropCount();
 
 #endif
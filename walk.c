@@ -0,0 +1,180 @@
+/**
+*      @file walk.c
+*      @author Prithvi Bhat
+*      @brief Comparator walk correction from the width of the received ultrasound pulse
+*               * A weak pulse crosses the comparator threshold later than a strong one, so far sensors read
+*                 late. The width of the comparator pulse grows with the amplitude and tells them apart
+*               * With WALK_MODE set the sensor timers capture both edges, and each arrival is corrected by
+*                 an offset looked up from its pulse width: WALK_BINS entries per sensor, WALK_BIN ticks
+*                 apart, interpolated linearly between the middles of the steps
+*               * Calibration: with the pen held at a known position the arrival expected from the geometry
+*                 is compared with every capture, and the average difference is collected per width step.
+*                 Several positions, near and far, fill the table, steps that saw no pulse copy their
+*                 nearest neighbour
+**/
+
+#include "walk.h"
+#include "config.h"
+#include "format.h"
+#include "uart0.h"
+
+#define INTERPOLATION_SHIFT 8                   // Table positions in 1/256 step
+
+// Global Variables
+static int32_t g_cal_sum[WALK_CHANNELS][WALK_BINS];     // Arrival minus expected arrival, ticks
+static uint16_t g_cal_count[WALK_CHANNELS][WALK_BINS];
+static uint32_t g_cal_expected[WALK_CHANNELS];
+static volatile bool g_calibrating = false;
+
+// First configuration word of each sensor's table
+static const uint8_t g_table[WALK_CHANNELS] = { WALK_A, WALK_B, WALK_C };
+
+/**
+*      @brief Function to tell the capture ISRs whether to wait for the trailing edge of a pulse
+*      @return bool true while correcting or calibrating
+**/
+bool walk_capture_widths(void)
+{
+    return g_calibrating || config_get(WALK_MODE) != 0;
+}
+
+/**
+*      @brief Function to look up the arrival correction of a pulse
+*      @param channel sensor, 0 for A
+*      @param width pulse width in timer ticks, 0 if unknown
+*      @return int32_t ticks to subtract from the arrival, 0 while correction is off
+**/
+int32_t walk_offset(uint8_t channel, uint32_t width)
+{
+    uint32_t step = config_get(WALK_BIN), position, fraction, i;
+    uint8_t base;
+    int32_t low, high;
+
+    if (config_get(WALK_MODE) == 0 || width == 0 || step == 0 || channel >= WALK_CHANNELS)  return 0;
+
+    base = g_table[channel];
+    position = (width << INTERPOLATION_SHIFT) / step;                                   // From the start of step 0
+    if (position <= (1 << (INTERPOLATION_SHIFT - 1)))   return (int32_t)config_get(base);  // Below the first middle
+
+    position -= 1 << (INTERPOLATION_SHIFT - 1);                                         // From the first middle
+    i = position >> INTERPOLATION_SHIFT;
+    if (i >= WALK_BINS - 1)     return (int32_t)config_get(base + WALK_BINS - 1);       // Beyond the last middle
+
+    fraction = position & ((1 << INTERPOLATION_SHIFT) - 1);
+    low = (int32_t)config_get(base + i);
+    high = (int32_t)config_get(base + i + 1);
+    return low + ((high - low) * (int32_t)fraction) / (1 << INTERPOLATION_SHIFT);
+}
+
+/**
+*      @brief Function to start calibrating, or to move on to another pen position
+*               Data from earlier positions is kept until walk_calibrate_save()
+*      @param expected arrival in timer ticks at each sensor for the pen position being held
+**/
+void walk_calibrate_begin(const uint32_t *expected)
+{
+    uint8_t i, j;
+
+    if (!g_calibrating)
+    {
+        for (i = 0; i < WALK_CHANNELS; i++)
+        {
+            for (j = 0; j < WALK_BINS; j++)
+            {
+                g_cal_sum[i][j] = 0;
+                g_cal_count[i][j] = 0;
+            }
+        }
+    }
+
+    for (i = 0; i < WALK_CHANNELS; i++)     g_cal_expected[i] = expected[i];
+    g_calibrating = true;
+}
+
+/**
+*      @brief Function to collect one uncorrected capture while calibrating, called per complete stroke
+*      @param channel sensor, 0 for A
+*      @param arrival timer capture of the leading edge
+*      @param width pulse width in timer ticks, 0 if the trailing edge was missed
+**/
+void walk_calibrate_add(uint8_t channel, uint32_t arrival, uint32_t width)
+{
+    uint32_t step = config_get(WALK_BIN), bin;
+
+    if (!g_calibrating || width == 0 || step == 0 || channel >= WALK_CHANNELS)  return;
+
+    bin = width / step;
+    if (bin >= WALK_BINS)   bin = WALK_BINS - 1;
+    if (g_cal_count[channel][bin] == UINT16_MAX)    return;
+
+    g_cal_sum[channel][bin] += (int32_t)(arrival - g_cal_expected[channel]);
+    g_cal_count[channel][bin]++;
+}
+
+/**
+*      @brief Function to finish calibrating and store the tables
+*      @return bool false if a sensor saw no pulse, nothing is stored then
+**/
+bool walk_calibrate_save(void)
+{
+    uint8_t i, j, k;
+
+    g_calibrating = false;
+
+    for (i = 0; i < WALK_CHANNELS; i++)
+    {
+        for (j = 0; j < WALK_BINS && g_cal_count[i][j] == 0; j++);
+        if (j == WALK_BINS)     return false;
+    }
+
+    for (i = 0; i < WALK_CHANNELS; i++)
+    {
+        for (j = 0; j < WALK_BINS; j++)
+        {
+            uint8_t source = j;
+
+            for (k = 0; k < WALK_BINS; k++)                                             // Nearest step with data
+            {
+                if (j >= k && g_cal_count[i][j - k] != 0)               { source = j - k; break; }
+                if (j + k < WALK_BINS && g_cal_count[i][j + k] != 0)    { source = j + k; break; }
+            }
+            config_set(g_table[i] + j, (uint32_t)(g_cal_sum[i][source] / (int32_t)g_cal_count[i][source]));
+        }
+    }
+
+    config_flush();
+    return true;
+}
+
+/**
+*      @brief Function to print the correction tables and the calibration progress
+**/
+void walk_print(void)
+{
+    uint8_t i, j;
+
+    format_string(putcUart0, (config_get(WALK_MODE) != 0) ? "Walk correction on, " : "Walk correction off, ");
+    format_uint(putcUart0, config_get(WALK_BIN));
+    format_string(putcUart0, " ticks per width step\r\n");
+
+    for (i = 0; i < WALK_CHANNELS; i++)
+    {
+        format_string(putcUart0, "Sensor ");
+        putcUart0('A' + i);
+        format_string(putcUart0, ":");
+        for (j = 0; j < WALK_BINS; j++)
+        {
+            format_string(putcUart0, " ");
+            format_int(putcUart0, (int32_t)config_get(g_table[i] + j));
+        }
+        if (g_calibrating)
+        {
+            uint32_t strokes = 0;
+            for (j = 0; j < WALK_BINS; j++)     strokes += g_cal_count[i][j];
+            format_string(putcUart0, "   calibration strokes ");
+            format_uint(putcUart0, strokes);
+        }
+        format_string(putcUart0, "\r\n");
+    }
+    format_string(putcUart0, "\r\n");
+}
@@ -0,0 +1,23 @@
+/**
+*      @file walk.h
+*      @author Prithvi Bhat
+*      @brief Comparator walk correction from the width of the received ultrasound pulse
+**/
+#ifndef WALK_H
+#define WALK_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define WALK_CHANNELS   3                       // Ultrasound sensors A, B and C
+#define WALK_BINS       8                       // Table entries per sensor, see eeprom_memory_map.h
+
+// Function prototypes
+bool walk_capture_widths(void);
+int32_t walk_offset(uint8_t channel, uint32_t width);
+void walk_calibrate_begin(const uint32_t *expected);
+void walk_calibrate_add(uint8_t channel, uint32_t arrival, uint32_t width);
+bool walk_calibrate_save(void);
+void walk_print(void);
+
+#endif
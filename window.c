@@ -0,0 +1,71 @@
+/**
+*      @file window.c
+*      @author Prithvi Bhat
+*      @brief Sliding window of timer captures with a running sum, one per ultrasound sensor
+*               * Each stroke adds a capture and retires the oldest one from the sum, so a fresh average
+*                 of the last depth strokes is ready after every stroke instead of every depth strokes
+*               * The last WINDOW_SIZE captures are kept whatever the depth, so a deeper average is
+*                 available at once when the depth is raised
+**/
+
+#include "window.h"
+
+/**
+*      @brief Function to empty a window
+*      @param depth number of captures to average, 1 to WINDOW_SIZE
+**/
+void window_reset(capture_window_t *window, uint8_t depth)
+{
+    uint8_t i;
+
+    for (i = 0; i < WINDOW_SIZE; i++)   window->sample[i] = 0;
+    window->sum = 0;
+    window->head = window->stored = window->filled = 0;
+    window->depth = (depth == 0) ? 1 : (depth > WINDOW_SIZE) ? WINDOW_SIZE : depth;
+}
+
+/**
+*      @brief Function to change the number of captures averaged, the sum is rebuilt from the kept captures
+*      @param depth number of captures to average, 1 to WINDOW_SIZE
+**/
+void window_set_depth(capture_window_t *window, uint8_t depth)
+{
+    uint8_t i;
+
+    if (depth == 0)             depth = 1;
+    if (depth > WINDOW_SIZE)    depth = WINDOW_SIZE;
+    if (depth == window->depth) return;
+
+    window->depth = depth;
+    window->filled = (window->stored < depth) ? window->stored : depth;
+    window->sum = 0;
+    for (i = 0; i < window->filled; i++)    window->sum += window_sample(window, i);
+}
+
+/**
+*      @brief Function to add a capture, retiring the oldest one in the sum once the window is full
+*      @param value timer capture
+**/
+void window_push(capture_window_t *window, uint32_t value)
+{
+    if (window->filled == window->depth)
+    {
+        window->sum -= window_sample(window, window->filled - 1);               // Oldest capture in the sum
+    }
+    else    window->filled++;
+
+    window->sample[window->head] = value;
+    window->sum += value;
+    window->head = (window->head + 1) % WINDOW_SIZE;
+    if (window->stored < WINDOW_SIZE)   window->stored++;
+}
+
+/**
+*      @brief Function to read a kept capture
+*      @param age 0 for the newest capture, filled - 1 for the oldest one in the sum
+*      @return uint32_t timer capture
+**/
+uint32_t window_sample(const capture_window_t *window, uint8_t age)
+{
+    return window->sample[(window->head + WINDOW_SIZE - 1 - age) % WINDOW_SIZE];
+}
@@ -0,0 +1,33 @@
+/**
+*      @file window.h
+*      @author Prithvi Bhat
+*      @brief Sliding window of timer captures with a running sum, one per ultrasound sensor
+**/
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "inttypes.h"
+#include <stdbool.h>
+
+#define WINDOW_SIZE     10                      // Captures kept per sensor, the deepest average possible
+
+/**
+*      @brief Captures of one sensor, the newest depth of them are averaged
+**/
+typedef struct
+{
+    uint32_t sample[WINDOW_SIZE];               // Circular, oldest overwritten first
+    uint32_t sum;                               // Sum of the newest filled samples
+    uint8_t head;                               // Slot the next capture goes into
+    uint8_t stored;                             // Captures held, up to WINDOW_SIZE
+    uint8_t filled;                             // Captures in the sum, up to depth
+    uint8_t depth;                              // Captures averaged once enough have arrived
+} capture_window_t;
+
+// Function prototypes
+void window_reset(capture_window_t *window, uint8_t depth);
+void window_set_depth(capture_window_t *window, uint8_t depth);
+void window_push(capture_window_t *window, uint32_t value);
+uint32_t window_sample(const capture_window_t *window, uint8_t age);
+
+#endif